@@ -0,0 +1,115 @@
+#include "AssetIOSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+AssetIOStream::AssetIOStream(FileView file, AssetIOStats& stats)
+    : file(std::move(file)), position(0), stats(stats) {}
+
+size_t AssetIOStream::Read(void* buffer, size_t size, size_t count) {
+    if (size == 0 || count == 0)
+        return 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // Only whole elements are returned, as with fread
+    size_t available = (file.size() - position) / size;
+    size_t elements = std::min(count, available);
+    size_t bytes = elements * size;
+    std::memcpy(buffer, file.data() + position, bytes);
+    position += bytes;
+
+    stats.bytesRead += bytes;
+    stats.ioSeconds += secondsSince(start);
+    return elements;
+}
+
+size_t AssetIOStream::Write(const void*, size_t, size_t) {
+    return 0; // Assets are read-only
+}
+
+aiReturn AssetIOStream::Seek(size_t offset, aiOrigin origin) {
+    size_t target;
+    switch (origin) {
+    case aiOrigin_SET: target = offset; break;
+    case aiOrigin_CUR: target = position + offset; break;
+    case aiOrigin_END: target = file.size() - offset; break;
+    default: return aiReturn_FAILURE;
+    }
+    if (target > file.size())
+        return aiReturn_FAILURE;
+    position = target;
+    return aiReturn_SUCCESS;
+}
+
+size_t AssetIOStream::Tell() const {
+    return position;
+}
+
+size_t AssetIOStream::FileSize() const {
+    return file.size();
+}
+
+void AssetIOStream::Flush() {}
+
+AssetIOSystem::AssetIOSystem()
+    : ioStats{ 0, 0, 0.0 } {}
+
+bool AssetIOSystem::Exists(const char* path) const {
+    return Vfs::exists(path);
+}
+
+char AssetIOSystem::getOsSeparator() const {
+    return '/';
+}
+
+Assimp::IOStream* AssetIOSystem::Open(const char* path, const char* mode) {
+    if (std::strchr(mode, 'w') || std::strchr(mode, 'a') || std::strchr(mode, '+'))
+        return nullptr;
+
+    auto start = std::chrono::steady_clock::now();
+    FileView file = Vfs::open(path);
+    ioStats.ioSeconds += secondsSince(start);
+    if (!file.valid())
+        return nullptr;
+
+    ioStats.filesOpened++;
+    return new AssetIOStream(std::move(file), ioStats);
+}
+
+void AssetIOSystem::Close(Assimp::IOStream* stream) {
+    delete stream;
+}
+
+const AssetIOStats& AssetIOSystem::stats() const {
+    return ioStats;
+}
+
+namespace AssetIO {
+
+const aiScene* readScene(Assimp::Importer& importer, const std::string& path, unsigned int flags) {
+    // The importer takes ownership of the IO system
+    AssetIOSystem* io = new AssetIOSystem();
+    importer.SetIOHandler(io);
+
+    auto start = std::chrono::steady_clock::now();
+    const aiScene* scene = importer.ReadFile(path, flags);
+    double total = secondsSince(start);
+
+    const AssetIOStats& stats = io->stats();
+    std::cout << std::fixed << std::setprecision(2)
+        << "Import " << path << ": " << stats.bytesRead / 1024.0 << " KB from " << stats.filesOpened << " file(s), "
+        << "I/O " << stats.ioSeconds * 1000.0 << " ms, parse " << (total - stats.ioSeconds) * 1000.0 << " ms"
+        << (Vfs::hasPack() ? " (pack)" : " (loose)") << std::endl;
+    std::cout.unsetf(std::ios::floatfield);
+    return scene;
+}
+
+}
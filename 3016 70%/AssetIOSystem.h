@@ -0,0 +1,58 @@
+#pragma once
+#ifndef ASSET_IO_SYSTEM_H
+#define ASSET_IO_SYSTEM_H
+
+#include <string>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+#include <assimp/Importer.hpp>
+#include "VirtualFileSystem.h"
+
+struct AssetIOStats {
+    size_t filesOpened;
+    size_t bytesRead;
+    double ioSeconds; // Time spent opening files and copying bytes out to Assimp
+};
+
+// Read-only stream over a VFS view. Reads copy straight out of the pack
+// mapping (or the loose-file buffer) without further syscalls.
+class AssetIOStream : public Assimp::IOStream {
+public:
+    AssetIOStream(FileView file, AssetIOStats& stats);
+
+    size_t Read(void* buffer, size_t size, size_t count) override;
+    size_t Write(const void* buffer, size_t size, size_t count) override;
+    aiReturn Seek(size_t offset, aiOrigin origin) override;
+    size_t Tell() const override;
+    size_t FileSize() const override;
+    void Flush() override;
+
+private:
+    FileView file;
+    size_t position;
+    AssetIOStats& stats;
+};
+
+// Serves every file Assimp asks for (including referenced files) from the VFS
+class AssetIOSystem : public Assimp::IOSystem {
+public:
+    AssetIOSystem();
+
+    bool Exists(const char* path) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+    void Close(Assimp::IOStream* stream) override;
+
+    const AssetIOStats& stats() const;
+
+private:
+    AssetIOStats ioStats;
+};
+
+namespace AssetIO {
+    // Imports through an AssetIOSystem and prints I/O versus parse time.
+    // The importer owns the scene as with Importer::ReadFile.
+    const aiScene* readScene(Assimp::Importer& importer, const std::string& path, unsigned int flags);
+}
+
+#endif // ASSET_IO_SYSTEM_H
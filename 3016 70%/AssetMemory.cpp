@@ -0,0 +1,92 @@
+#include "AssetMemory.h"
+#include <iomanip>
+#include <iostream>
+
+namespace {
+    std::vector<AssetMemoryEntry> assetEntries;
+
+    double toKiB(size_t bytes) {
+        return bytes / 1024.0;
+    }
+}
+
+namespace AssetMemory {
+
+void track(MemorySubsystem subsystem, const std::string& asset, size_t cpuBytes, size_t gpuBytes) {
+    for (auto& entry : assetEntries) {
+        if (entry.subsystem == subsystem && entry.asset == asset) {
+            entry.cpuBytes += cpuBytes;
+            entry.gpuBytes += gpuBytes;
+            return;
+        }
+    }
+    assetEntries.push_back({ asset, subsystem, cpuBytes, gpuBytes });
+}
+
+size_t cpuBytes(MemorySubsystem subsystem) {
+    size_t total = 0;
+    for (const auto& entry : assetEntries) {
+        if (entry.subsystem == subsystem)
+            total += entry.cpuBytes;
+    }
+    return total;
+}
+
+size_t gpuBytes(MemorySubsystem subsystem) {
+    size_t total = 0;
+    for (const auto& entry : assetEntries) {
+        if (entry.subsystem == subsystem)
+            total += entry.gpuBytes;
+    }
+    return total;
+}
+
+const std::vector<AssetMemoryEntry>& entries() {
+    return assetEntries;
+}
+
+size_t textureBytes(int width, int height, int bytesPerPixel, bool mipmapped) {
+    if (bytesPerPixel == 3)
+        bytesPerPixel = 4;
+    size_t total = static_cast<size_t>(width) * height * bytesPerPixel;
+    while (mipmapped && (width > 1 || height > 1)) {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        total += static_cast<size_t>(width) * height * bytesPerPixel;
+    }
+    return total;
+}
+
+void printReport() {
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Asset memory (KiB, CPU / GPU):" << std::endl;
+    for (const auto& entry : assetEntries) {
+        std::cout << "  [" << subsystemName(entry.subsystem) << "] " << entry.asset << ": "
+            << toKiB(entry.cpuBytes) << " / " << toKiB(entry.gpuBytes) << std::endl;
+    }
+
+    size_t totalCpu = 0;
+    size_t totalGpu = 0;
+    for (int i = 0; i < static_cast<int>(MemorySubsystem::Count); i++) {
+        MemorySubsystem subsystem = static_cast<MemorySubsystem>(i);
+        totalCpu += cpuBytes(subsystem);
+        totalGpu += gpuBytes(subsystem);
+        std::cout << "  " << subsystemName(subsystem) << " total: "
+            << toKiB(cpuBytes(subsystem)) << " / " << toKiB(gpuBytes(subsystem)) << std::endl;
+    }
+    std::cout << "  All assets: " << toKiB(totalCpu) << " / " << toKiB(totalGpu) << std::endl;
+    std::cout << std::defaultfloat;
+}
+
+const char* subsystemName(MemorySubsystem subsystem) {
+    switch (subsystem) {
+    case MemorySubsystem::Terrain: return "terrain";
+    case MemorySubsystem::Swords: return "swords";
+    case MemorySubsystem::Keys: return "keys";
+    case MemorySubsystem::Textures: return "textures";
+    case MemorySubsystem::Shadows: return "shadows";
+    default: return "unknown";
+    }
+}
+
+}
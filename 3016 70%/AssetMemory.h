@@ -0,0 +1,43 @@
+#pragma once
+#ifndef ASSET_MEMORY_H
+#define ASSET_MEMORY_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+enum class MemorySubsystem {
+    Terrain,
+    Swords,
+    Keys,
+    Textures,
+    Shadows,
+    Count
+};
+
+struct AssetMemoryEntry {
+    std::string asset;
+    MemorySubsystem subsystem;
+    size_t cpuBytes; // Long-lived CPU copies held after loading
+    size_t gpuBytes; // Buffer and texture storage
+};
+
+namespace AssetMemory {
+    // Adds bytes to an asset's entry, creating it on first use
+    void track(MemorySubsystem subsystem, const std::string& asset, size_t cpuBytes, size_t gpuBytes);
+
+    size_t cpuBytes(MemorySubsystem subsystem);
+    size_t gpuBytes(MemorySubsystem subsystem);
+    const std::vector<AssetMemoryEntry>& entries();
+
+    // Storage of a texture upload, including the mip chain when mipmapped.
+    // Three-byte texels count as four, as drivers store RGB8 padded to RGBA8.
+    size_t textureBytes(int width, int height, int bytesPerPixel, bool mipmapped);
+
+    // Prints per-asset and per-subsystem totals
+    void printReport();
+
+    const char* subsystemName(MemorySubsystem subsystem);
+}
+
+#endif // ASSET_MEMORY_H
@@ -0,0 +1,200 @@
+#include "AssetPack.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    const char* kPackedExtensions[] = { ".fbx", ".png", ".jpg", ".glsl" };
+
+    bool isPackedFile(const std::filesystem::path& path) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        for (const char* packed : kPackedExtensions) {
+            if (extension == packed)
+                return true;
+        }
+        return false;
+    }
+
+    uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+AssetPack::AssetPack()
+    : header(nullptr), table(nullptr) {}
+
+bool AssetPack::open(const std::string& path) {
+    header = nullptr;
+    table = nullptr;
+    if (!file.open(path))
+        return false;
+
+    const unsigned char* base = file.data();
+    size_t size = file.size();
+    const PackHeader* candidate = reinterpret_cast<const PackHeader*>(base);
+
+    bool valid = size >= sizeof(PackHeader)
+        && candidate->magic == kPackMagic
+        && candidate->version == kPackVersion
+        && candidate->tableSize > 0
+        && (candidate->tableSize & (candidate->tableSize - 1)) == 0
+        && candidate->tableOffset % alignof(PackEntry) == 0
+        && candidate->tableOffset + static_cast<uint64_t>(candidate->tableSize) * sizeof(PackEntry) <= size
+        && candidate->namesOffset <= size;
+    if (valid) {
+        const PackEntry* entries = reinterpret_cast<const PackEntry*>(base + candidate->tableOffset);
+        for (uint32_t i = 0; i < candidate->tableSize && valid; i++) {
+            if (entries[i].hash == 0)
+                continue;
+            valid = entries[i].offset + entries[i].size <= size
+                && candidate->namesOffset + entries[i].nameOffset + entries[i].nameLength <= size;
+        }
+    }
+
+    if (!valid) {
+        std::cerr << "Invalid asset pack: " << path << std::endl;
+        file.close();
+        return false;
+    }
+
+    header = candidate;
+    table = reinterpret_cast<const PackEntry*>(base + header->tableOffset);
+    return true;
+}
+
+bool AssetPack::isOpen() const {
+    return header != nullptr;
+}
+
+uint32_t AssetPack::entryCount() const {
+    return header ? header->entryCount : 0;
+}
+
+bool AssetPack::find(const std::string& path, const unsigned char*& data, size_t& size) const {
+    if (!header)
+        return false;
+
+    std::string name = normalizePath(path);
+    uint64_t hash = hashPath(name);
+    uint32_t mask = header->tableSize - 1;
+    const char* names = reinterpret_cast<const char*>(file.data() + header->namesOffset);
+
+    for (uint32_t probe = 0; probe < header->tableSize; probe++) {
+        const PackEntry& entry = table[(hash + probe) & mask];
+        if (entry.hash == 0)
+            return false;
+        if (entry.hash == hash && entry.nameLength == name.size() && std::memcmp(names + entry.nameOffset, name.data(), name.size()) == 0) {
+            data = file.data() + entry.offset;
+            size = static_cast<size_t>(entry.size);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AssetPack::build(const std::vector<std::string>& roots, const std::string& outputPath) {
+    std::vector<std::string> files;
+    for (const auto& root : roots) {
+        if (!std::filesystem::exists(root))
+            continue;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+            if (entry.is_regular_file() && isPackedFile(entry.path()))
+                files.push_back(entry.path().generic_string());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    uint32_t tableSize = 16;
+    while (tableSize < files.size() * 2)
+        tableSize *= 2;
+
+    std::vector<PackEntry> entries(tableSize);
+    std::memset(entries.data(), 0, entries.size() * sizeof(PackEntry));
+    std::string names;
+
+    std::ofstream out(outputPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Failed to create asset pack: " << outputPath << std::endl;
+        return false;
+    }
+
+    PackHeader packHeader = {};
+    out.write(reinterpret_cast<const char*>(&packHeader), sizeof(packHeader)); // Rewritten once the layout is known
+
+    uint64_t offset = sizeof(PackHeader);
+    std::vector<char> padding(kPackAlignment, 0);
+    uint32_t written = 0;
+
+    for (const auto& path : files) {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<char> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.good() && !in.eof()) {
+            std::cerr << "Failed to read asset: " << path << std::endl;
+            continue;
+        }
+
+        std::string name = normalizePath(path);
+        uint64_t hash = hashPath(name);
+        uint32_t slot = static_cast<uint32_t>(hash & (tableSize - 1));
+        while (entries[slot].hash != 0) {
+            if (entries[slot].hash == hash)
+                std::cerr << "Asset pack hash collision: " << name << std::endl;
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        uint64_t aligned = alignUp(offset, kPackAlignment);
+        out.write(padding.data(), static_cast<std::streamsize>(aligned - offset));
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+
+        entries[slot] = { hash, aligned, contents.size(), static_cast<uint32_t>(names.size()), static_cast<uint32_t>(name.size()) };
+        names += name;
+        offset = aligned + contents.size();
+        written++;
+    }
+
+    uint64_t tableOffset = alignUp(offset, kPackAlignment);
+    out.write(padding.data(), static_cast<std::streamsize>(tableOffset - offset));
+    out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(PackEntry)));
+    out.write(names.data(), static_cast<std::streamsize>(names.size()));
+
+    packHeader = { kPackMagic, kPackVersion, written, tableSize, tableOffset, tableOffset + entries.size() * sizeof(PackEntry) };
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&packHeader), sizeof(packHeader));
+
+    if (!out) {
+        std::cerr << "Failed to write asset pack: " << outputPath << std::endl;
+        return false;
+    }
+
+    std::cout << "Built asset pack " << outputPath << ": " << written << " files, "
+        << packHeader.namesOffset + names.size() << " bytes" << std::endl;
+    return true;
+}
+
+std::string AssetPack::normalizePath(const std::string& path) {
+    std::filesystem::path fsPath(path);
+    if (fsPath.is_absolute()) {
+        std::error_code error;
+        std::filesystem::path relative = fsPath.lexically_relative(std::filesystem::current_path(error));
+        if (!error && !relative.empty() && *relative.begin() != "..")
+            fsPath = relative;
+    }
+
+    std::string normalized = fsPath.lexically_normal().generic_string();
+    if (normalized.compare(0, 2, "./") == 0)
+        normalized.erase(0, 2);
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return normalized;
+}
+
+uint64_t AssetPack::hashPath(const std::string& normalizedPath) {
+    // FNV-1a, with 0 reserved for empty table slots
+    uint64_t hash = 1469598103934665603ull;
+    for (unsigned char c : normalizedPath)
+        hash = (hash ^ c) * 1099511628211ull;
+    return hash != 0 ? hash : 1;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// Pack file layout:
+//   PackHeader
+//   file data, every entry starting on a kPackAlignment boundary
+//   hash table of tableSize PackEntry slots (open addressing, empty slots have hash 0)
+//   entry names, used to confirm hash matches
+const uint32_t kPackMagic = 0x4B415041; // "APAK"
+const uint32_t kPackVersion = 1;
+const uint64_t kPackAlignment = 64;
+
+struct PackHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t tableSize; // Power of two
+    uint64_t tableOffset;
+    uint64_t namesOffset;
+};
+
+struct PackEntry {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t size;
+    uint32_t nameOffset;
+    uint32_t nameLength;
+};
+
+class AssetPack {
+public:
+    AssetPack();
+
+    // Maps the pack and validates its header and table
+    bool open(const std::string& path);
+    bool isOpen() const;
+    uint32_t entryCount() const;
+
+    // Points data at the entry inside the mapping; no copy is made
+    bool find(const std::string& path, const unsigned char*& data, size_t& size) const;
+
+    // Writes every asset file found below the given directories into a pack
+    static bool build(const std::vector<std::string>& roots, const std::string& outputPath);
+
+    // Relative, forward-slash, lower-case form used for lookups
+    static std::string normalizePath(const std::string& path);
+    static uint64_t hashPath(const std::string& normalizedPath);
+
+private:
+    MappedFile file;
+    const PackHeader* header;
+    const PackEntry* table;
+};
+
+#endif // ASSET_PACK_H
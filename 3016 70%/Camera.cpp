@@ -14,14 +14,27 @@ glm::mat4 Camera::GetViewMatrix() {
 }
 
 void Camera::ProcessKeyboard(GLFWwindow* window, float deltaTime) {
+    ProcessMovement(SampleKeyboard(window), deltaTime);
+}
+
+CameraInput Camera::SampleKeyboard(GLFWwindow* window) {
+    return {
+        glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS,
+        glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS,
+        glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS,
+        glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS
+    };
+}
+
+void Camera::ProcessMovement(const CameraInput& input, float deltaTime) {
     float velocity = MovementSpeed * deltaTime;
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+    if (input.forward)
         Position += Front * velocity;
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+    if (input.backward)
         Position -= Front * velocity;
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+    if (input.left)
         Position -= Right * velocity;
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+    if (input.right)
         Position += Right * velocity;
 }
 
@@ -40,6 +53,12 @@ void Camera::ProcessMouseMovement(float xoffset, float yoffset) {
     updateCameraVectors();
 }
 
+void Camera::SetOrientation(float yaw, float pitch) {
+    Yaw = yaw;
+    Pitch = glm::clamp(pitch, -89.0f, 89.0f);
+    updateCameraVectors();
+}
+
 void Camera::UpdateCameraPosition(float terrainHeight) {
     Position.y = terrainHeight + CameraHeightOffset;
 }
@@ -7,13 +7,21 @@
 #include <glew.h>
 #include <glfw3.h>
 
+// Movement keys held for a frame, sampled on the thread that owns the window
+struct CameraInput {
+    bool forward, backward, left, right;
+};
+
 class Camera {
 public:
     Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch);
 
     glm::mat4 GetViewMatrix();
     void ProcessKeyboard(GLFWwindow* window, float deltaTime);
+    static CameraInput SampleKeyboard(GLFWwindow* window);
+    void ProcessMovement(const CameraInput& input, float deltaTime);
     void ProcessMouseMovement(float xoffset, float yoffset);
+    void SetOrientation(float yaw, float pitch);
     void UpdateCameraPosition(float terrainHeight);
 
     glm::vec3 Position;
@@ -0,0 +1,241 @@
+#include "CommandList.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+    enum class CommandType : uint32_t {
+        UseProgram,
+        BindTexture,
+        BindVertexArray,
+        SetVec2,
+        SetMat4,
+        DepthFunc,
+        DepthMask,
+        ColorMask,
+        DrawElements,
+        Call,
+    };
+
+    // Every command starts with its type and is padded to the alignment of
+    // the largest member, so replay can read the buffer in place
+    struct alignas(8) UseProgramCommand {
+        CommandType type;
+        ShaderProgram* program;
+    };
+
+    struct alignas(8) BindTextureCommand {
+        CommandType type;
+        GLuint unit;
+        GLenum target;
+        GLuint texture;
+    };
+
+    struct alignas(8) BindVertexArrayCommand {
+        CommandType type;
+        GLuint vertexArray;
+    };
+
+    struct alignas(8) SetVec2Command {
+        CommandType type;
+        ShaderProgram* program;
+        UniformId uniform;
+        glm::vec2 value;
+    };
+
+    struct alignas(8) SetMat4Command {
+        CommandType type;
+        ShaderProgram* program;
+        UniformId uniform;
+        glm::mat4 value;
+    };
+
+    // DepthFunc stores the function, the masks store 0 or 1
+    struct alignas(8) RasterStateCommand {
+        CommandType type;
+        GLenum value;
+    };
+
+    struct alignas(8) DrawElementsCommand {
+        CommandType type;
+        GLenum mode;
+        GLsizei count;
+        unsigned int firstIndex;
+    };
+
+    struct alignas(8) CallCommand {
+        CommandType type;
+        const std::function<void()>* function;
+    };
+
+    // Lists are kept between frames so their buffers stop growing
+    std::vector<CommandList> batchLists;
+}
+
+CommandList::CommandList()
+    : commands(0) {}
+
+void CommandList::clear() {
+    buffer.clear();
+    commands = 0;
+}
+
+template <typename T>
+void CommandList::write(const T& command) {
+    static_assert(sizeof(T) % 8 == 0, "commands keep the buffer 8-byte aligned");
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(T));
+    std::memcpy(buffer.data() + offset, &command, sizeof(T));
+    commands++;
+}
+
+void CommandList::useProgram(ShaderProgram& program) {
+    write(UseProgramCommand{ CommandType::UseProgram, &program });
+}
+
+void CommandList::bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    write(BindTextureCommand{ CommandType::BindTexture, unit, target, texture });
+}
+
+void CommandList::bindVertexArray(GLuint vertexArray) {
+    write(BindVertexArrayCommand{ CommandType::BindVertexArray, vertexArray });
+}
+
+void CommandList::setVec2(ShaderProgram& program, UniformId uniform, const glm::vec2& value) {
+    write(SetVec2Command{ CommandType::SetVec2, &program, uniform, value });
+}
+
+void CommandList::setMat4(ShaderProgram& program, UniformId uniform, const glm::mat4& value) {
+    write(SetMat4Command{ CommandType::SetMat4, &program, uniform, value });
+}
+
+void CommandList::depthFunc(GLenum func) {
+    write(RasterStateCommand{ CommandType::DepthFunc, func });
+}
+
+void CommandList::depthMask(bool write) {
+    this->write(RasterStateCommand{ CommandType::DepthMask, write ? 1u : 0u });
+}
+
+void CommandList::colorMask(bool write) {
+    this->write(RasterStateCommand{ CommandType::ColorMask, write ? 1u : 0u });
+}
+
+void CommandList::drawElements(GLenum mode, GLsizei count, unsigned int firstIndex) {
+    write(DrawElementsCommand{ CommandType::DrawElements, mode, count, firstIndex });
+}
+
+void CommandList::call(const std::function<void()>& function) {
+    write(CallCommand{ CommandType::Call, &function });
+}
+
+void CommandList::execute() const {
+    const unsigned char* cursor = buffer.data();
+    const unsigned char* end = cursor + buffer.size();
+    while (cursor < end) {
+        CommandType type;
+        std::memcpy(&type, cursor, sizeof(type));
+        switch (type) {
+        case CommandType::UseProgram: {
+            auto command = reinterpret_cast<const UseProgramCommand*>(cursor);
+            command->program->use();
+            cursor += sizeof(UseProgramCommand);
+            break;
+        }
+        case CommandType::BindTexture: {
+            auto command = reinterpret_cast<const BindTextureCommand*>(cursor);
+            GLState::bindTexture(command->unit, command->target, command->texture);
+            cursor += sizeof(BindTextureCommand);
+            break;
+        }
+        case CommandType::BindVertexArray: {
+            auto command = reinterpret_cast<const BindVertexArrayCommand*>(cursor);
+            GLState::bindVertexArray(command->vertexArray);
+            cursor += sizeof(BindVertexArrayCommand);
+            break;
+        }
+        case CommandType::SetVec2: {
+            auto command = reinterpret_cast<const SetVec2Command*>(cursor);
+            command->program->setVec2(command->uniform, command->value);
+            cursor += sizeof(SetVec2Command);
+            break;
+        }
+        case CommandType::SetMat4: {
+            auto command = reinterpret_cast<const SetMat4Command*>(cursor);
+            command->program->setMat4(command->uniform, command->value);
+            cursor += sizeof(SetMat4Command);
+            break;
+        }
+        case CommandType::DepthFunc:
+        case CommandType::DepthMask:
+        case CommandType::ColorMask: {
+            auto command = reinterpret_cast<const RasterStateCommand*>(cursor);
+            if (type == CommandType::DepthFunc)
+                GLState::depthFunc(command->value);
+            else if (type == CommandType::DepthMask)
+                GLState::depthMask(command->value != 0);
+            else
+                GLState::colorMask(command->value != 0);
+            cursor += sizeof(RasterStateCommand);
+            break;
+        }
+        case CommandType::DrawElements: {
+            auto command = reinterpret_cast<const DrawElementsCommand*>(cursor);
+            glDrawElements(command->mode, command->count, GL_UNSIGNED_INT, (void*)(command->firstIndex * sizeof(unsigned int)));
+            RenderStats::countDraw(command->count);
+            cursor += sizeof(DrawElementsCommand);
+            break;
+        }
+        case CommandType::Call: {
+            auto command = reinterpret_cast<const CallCommand*>(cursor);
+            (*command->function)();
+            cursor += sizeof(CallCommand);
+            break;
+        }
+        }
+    }
+}
+
+size_t CommandList::commandCount() const {
+    return commands;
+}
+
+size_t CommandList::byteSize() const {
+    return buffer.size();
+}
+
+namespace CommandLists {
+
+void recordAndExecute(size_t count, size_t minBatch, const std::function<void(CommandList& list, size_t begin, size_t end)>& record) {
+    if (count == 0)
+        return;
+
+    // About one batch per thread, so each list is recorded by one worker
+    size_t batchSize = std::max(minBatch, (count + JobSystem::threadCount() - 1) / JobSystem::threadCount());
+    size_t batchCount = (count + batchSize - 1) / batchSize;
+    if (batchLists.size() < batchCount)
+        batchLists.resize(batchCount);
+
+    auto start = std::chrono::steady_clock::now();
+    JobSystem::parallelFor(batchCount, 1, [&](size_t first, size_t last) {
+        for (size_t batch = first; batch < last; batch++) {
+            CommandList& list = batchLists[batch];
+            list.clear();
+            record(list, batch * batchSize, std::min((batch + 1) * batchSize, count));
+        }
+    });
+    auto recorded = std::chrono::steady_clock::now();
+
+    FrameStats& stats = RenderStats::frame();
+    for (size_t batch = 0; batch < batchCount; batch++) {
+        batchLists[batch].execute();
+        stats.commandsReplayed += static_cast<unsigned int>(batchLists[batch].commandCount());
+    }
+    stats.commandLists += static_cast<unsigned int>(batchCount);
+    stats.commandRecordMs += std::chrono::duration<float, std::milli>(recorded - start).count();
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "ShaderProgram.h"
+
+// Linear buffer of recorded render commands. Recording touches no GL state
+// and no shared data, so any thread can fill its own list; execute replays
+// the commands in order through GLState and ShaderProgram on the GL thread.
+class CommandList {
+public:
+    CommandList();
+
+    void clear();
+
+    void useProgram(ShaderProgram& program);
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    void bindVertexArray(GLuint vertexArray);
+    void setVec2(ShaderProgram& program, UniformId uniform, const glm::vec2& value);
+    void setMat4(ShaderProgram& program, UniformId uniform, const glm::mat4& value);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void colorMask(bool write);
+    void drawElements(GLenum mode, GLsizei count, unsigned int firstIndex);
+
+    // Runs a callback at this point of the replay. The function must outlive
+    // the replay and may issue GL calls.
+    void call(const std::function<void()>& function);
+
+    void execute() const;
+
+    size_t commandCount() const;
+    size_t byteSize() const;
+
+private:
+    template <typename T>
+    void write(const T& command);
+
+    std::vector<unsigned char> buffer;
+    size_t commands;
+};
+
+namespace CommandLists {
+    // Splits [0, count) into batches of at least minBatch items and records
+    // each batch into its own list on the job system, then replays the lists
+    // in batch order on the calling thread. The result matches recording the
+    // whole range into one list.
+    void recordAndExecute(size_t count, size_t minBatch, const std::function<void(CommandList& list, size_t begin, size_t end)>& record);
+}
+
+#endif // COMMAND_LIST_H
@@ -0,0 +1,183 @@
+#include "DynamicResolution.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    // The controller aims this far below the budget and only acts once the
+    // smoothed GPU time leaves the band between the two, so timer noise
+    // around the target does not make the scale oscillate
+    const float kTargetFraction = 0.85f;
+    const float kLowerFraction = 0.7f;
+
+    // Largest change of the scale per decision
+    const float kMaxStep = 0.1f;
+
+    // Weight of a new GPU time in the running average
+    const float kSmoothing = 0.25f;
+
+    // GpuTimer results trail by up to three frames; after a change the
+    // controller waits until they come from frames at the new scale
+    const int kSettleFrames = 4;
+}
+
+ResolutionScaler::ResolutionScaler()
+    : framebuffer(0), colorTexture(0), depthBuffer(0), emptyVertexArray(0),
+      targetSize(0), outputSize(0), renderSize(0), outputFramebuffer(0),
+      active(false), cpuBound(false), currentScale(1.0f), smoothedGpuMs(0.0f), settleFrames(0) {}
+
+bool ResolutionScaler::resizeTarget(int width, int height) {
+    if (!framebuffer) {
+        glGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &colorTexture);
+        glGenRenderbuffers(1, &depthBuffer);
+        glGenVertexArrays(1, &emptyVertexArray);
+    }
+
+    // Allocated at the output size; lower scales render into its lower-left corner
+    GLState::bindTexture(0, GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    GLState::bindFramebuffer(framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Dynamic resolution framebuffer is incomplete" << std::endl;
+        targetSize = glm::ivec2(0);
+        return false;
+    }
+    targetSize = glm::ivec2(width, height);
+    return true;
+}
+
+void ResolutionScaler::beginScene(int outputWidth, int outputHeight) {
+    const DynamicResolutionSettings& config = DynamicResolution::settings();
+    outputSize = glm::ivec2(outputWidth, outputHeight);
+    renderSize = outputSize;
+    active = config.enabled && outputWidth > 0 && outputHeight > 0;
+    if (active && targetSize != outputSize)
+        active = resizeTarget(outputWidth, outputHeight);
+    RenderStats::frame().resolutionScale = scale();
+    if (!active) {
+        GLState::bindDefaultFramebuffer();
+        GLState::viewport(0, 0, outputWidth, outputHeight);
+        return;
+    }
+
+    renderSize = glm::max(glm::ivec2(glm::vec2(outputSize) * currentScale + 0.5f), glm::ivec2(1));
+
+    // Every pass that returns to the default framebuffer now lands in the target
+    outputFramebuffer = GLState::defaultFramebuffer();
+    GLState::setDefaultFramebuffer(framebuffer);
+    GLState::bindFramebuffer(framebuffer);
+    GLState::viewport(0, 0, renderSize.x, renderSize.y);
+    sceneTimer.begin();
+}
+
+void ResolutionScaler::endScene(ShaderProgram& upscaleShader) {
+    if (!active)
+        return;
+    sceneTimer.end();
+    RenderStats::frame().gpuSceneMs = sceneTimer.lastMs();
+
+    GLState::setDefaultFramebuffer(outputFramebuffer);
+    GLState::bindDefaultFramebuffer();
+    GLState::viewport(0, 0, outputSize.x, outputSize.y);
+
+    // One fullscreen triangle covers every output pixel, so the output needs no clear
+    glm::vec2 texelSize = 1.0f / glm::vec2(targetSize);
+    upscaleShader.use();
+    upscaleShader.setVec2("uvScale", glm::vec2(renderSize) * texelSize);
+    upscaleShader.setVec2("texelSize", texelSize);
+    upscaleShader.setVec2("outputSize", glm::vec2(outputSize));
+    upscaleShader.setFloat("sharpness", DynamicResolution::settings().sharpen ? 0.5f : 0.0f);
+    GLState::setEnabled(GL_DEPTH_TEST, false);
+    GLState::setEnabled(GL_BLEND, false);
+    GLState::bindTexture(0, GL_TEXTURE_2D, colorTexture);
+    GLState::bindVertexArray(emptyVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    RenderStats::countDraw(3);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+}
+
+void ResolutionScaler::update(float cpuMs) {
+    const DynamicResolutionSettings& config = DynamicResolution::settings();
+    float gpuMs = sceneTimer.lastMs();
+    if (!active || gpuMs <= 0.0f)
+        return;
+    if (settleFrames > 0) {
+        settleFrames--;
+        return;
+    }
+    smoothedGpuMs = smoothedGpuMs > 0.0f ? glm::mix(smoothedGpuMs, gpuMs, kSmoothing) : gpuMs;
+
+    float target = config.budgetMs * kTargetFraction;
+    if (smoothedGpuMs <= config.budgetMs && smoothedGpuMs >= config.budgetMs * kLowerFraction)
+        return;
+
+    // GPU time is taken to follow the pixel count, which goes with the square of the scale
+    float next = currentScale * std::sqrt(target / smoothedGpuMs);
+    next = glm::clamp(next, currentScale - kMaxStep, currentScale + kMaxStep);
+    next = glm::clamp(next, config.minScale, config.maxScale);
+    next = std::round(next * 100.0f) / 100.0f;
+    if (next == currentScale)
+        return;
+
+    // Fewer pixels cannot shorten a frame the CPU is holding up
+    if (next < currentScale && cpuMs > config.budgetMs) {
+        if (!cpuBound)
+            std::cout << "Dynamic resolution: GPU " << smoothedGpuMs << " ms, CPU " << cpuMs << " ms over the "
+                << config.budgetMs << " ms budget, CPU-bound; holding scale " << currentScale << std::endl;
+        cpuBound = true;
+        return;
+    }
+    cpuBound = false;
+
+    glm::ivec2 nextSize = glm::max(glm::ivec2(glm::vec2(outputSize) * next + 0.5f), glm::ivec2(1));
+    std::cout << "Dynamic resolution: GPU " << smoothedGpuMs << " ms, CPU " << cpuMs << " ms, budget "
+        << config.budgetMs << " ms -> scale " << currentScale << " to " << next
+        << " (" << nextSize.x << "x" << nextSize.y << ")" << std::endl;
+    currentScale = next;
+    smoothedGpuMs = 0.0f;
+    settleFrames = kSettleFrames;
+}
+
+glm::ivec2 ResolutionScaler::sceneSize() const {
+    return renderSize;
+}
+
+float ResolutionScaler::scale() const {
+    return active ? currentScale : 1.0f;
+}
+
+void ResolutionScaler::release() {
+    sceneTimer.release();
+    if (!framebuffer)
+        return;
+    GLState::bindDefaultFramebuffer();
+    GLState::forgetTexture(colorTexture);
+    GLState::forgetVertexArray(emptyVertexArray);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    glDeleteVertexArrays(1, &emptyVertexArray);
+    framebuffer = colorTexture = depthBuffer = emptyVertexArray = 0;
+    targetSize = glm::ivec2(0);
+}
+
+namespace DynamicResolution {
+
+DynamicResolutionSettings& settings() {
+    static DynamicResolutionSettings resolutionSettings = { true, true, 1000.0f / 60.0f, 0.5f, 1.0f };
+    return resolutionSettings;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glm.hpp>
+#include <glew.h>
+#include "GpuTimer.h"
+#include "ShaderProgram.h"
+
+struct DynamicResolutionSettings {
+    bool enabled;
+    bool sharpen;   // Contrast-limited sharpening while upscaling instead of plain bilinear
+    float budgetMs; // Frame time the controller aims to stay under
+    float minScale;
+    float maxScale;
+};
+
+// Renders the 3D scene into an offscreen target at a fraction of the
+// output size and upscales it into the output, where the overlay is then
+// drawn at full resolution. The fraction is steered by the measured GPU
+// time of the scene against the frame budget; a CPU-bound frame keeps its
+// scale, since fewer pixels would not make it faster.
+class ResolutionScaler {
+public:
+    ResolutionScaler();
+
+    // Points the default framebuffer at the scene target and sets the
+    // viewport to the scaled size. The target follows the output size.
+    void beginScene(int outputWidth, int outputHeight);
+
+    // Restores the output framebuffer and upscales the scene into it
+    void endScene(ShaderProgram& upscaleShader);
+
+    // Feeds the controller the frame's CPU time; GPU time comes from the
+    // scene's own timer, a few frames late
+    void update(float cpuMs);
+
+    // Size the scene is rendered at this frame
+    glm::ivec2 sceneSize() const;
+    float scale() const;
+
+    void release();
+
+private:
+    bool resizeTarget(int width, int height);
+
+    GLuint framebuffer;
+    GLuint colorTexture;
+    GLuint depthBuffer;
+    GLuint emptyVertexArray;
+    glm::ivec2 targetSize;
+    glm::ivec2 outputSize;
+    glm::ivec2 renderSize;
+    GLuint outputFramebuffer;
+    bool active;   // This frame renders through the target
+    bool cpuBound; // Last decision was held back by the CPU time; logged once
+    float currentScale;
+    float smoothedGpuMs;
+    int settleFrames; // Frames to wait before the timer reflects the last change
+    GpuTimer sceneTimer;
+};
+
+namespace DynamicResolution {
+    DynamicResolutionSettings& settings();
+}
+
+#endif // DYNAMIC_RESOLUTION_H
@@ -0,0 +1,316 @@
+#include "FrameCapture.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include "Headless.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    bool parseCount(const char* text, int& value) {
+        char* end = nullptr;
+        long parsed = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || parsed <= 0)
+            return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    double millisecondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+FrameCapture::FrameCapture(const CaptureOptions& options)
+    : options(options), width(0), height(0), stopping(false), nextSequence(0), writtenSequence(0),
+      captured(0), droppedReading(0), droppedEncoding(0), failedWrites(0),
+      renderThreadMs(0.0), renderThreadMaxMs(0.0), captureCalls(0), encodeMs(0.0) {}
+
+FrameCapture::~FrameCapture() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto& encoder : encoders)
+        encoder.join();
+}
+
+bool FrameCapture::enabled() const {
+    return options.every > 0;
+}
+
+bool FrameCapture::create() {
+    if (!enabled())
+        return true;
+    if (!options.rawPath.empty()) {
+        rawFile.open(options.rawPath, std::ios::binary);
+        if (!rawFile) {
+            std::cerr << "Failed to open the raw capture file: " << options.rawPath << std::endl;
+            return false;
+        }
+    }
+    for (int i = 0; i < options.threads; i++)
+        encoders.emplace_back(&FrameCapture::encoderLoop, this);
+    started = std::chrono::steady_clock::now();
+    return true;
+}
+
+bool FrameCapture::createRing(int newWidth, int newHeight) {
+    width = newWidth;
+    height = newHeight;
+    GLsizeiptr size = static_cast<GLsizeiptr>(width) * height * 4;
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    slots.assign(options.buffers, Slot{ 0, nullptr, nullptr, SlotState::Free, 0, 0 });
+    for (auto& slot : slots) {
+        glCreateBuffers(1, &slot.buffer);
+        glNamedBufferStorage(slot.buffer, size, nullptr, flags);
+        slot.mapped = static_cast<const unsigned char*>(glMapNamedBufferRange(slot.buffer, 0, size, flags));
+        if (!slot.mapped) {
+            std::cerr << "Failed to map a capture pixel buffer" << std::endl;
+            releaseRing();
+            return false;
+        }
+    }
+    return true;
+}
+
+void FrameCapture::releaseRing() {
+    for (auto& slot : slots) {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        if (slot.buffer) {
+            if (slot.mapped)
+                glUnmapNamedBuffer(slot.buffer);
+            GLState::forgetBuffer(slot.buffer);
+            glDeleteBuffers(1, &slot.buffer);
+        }
+    }
+    slots.clear();
+    width = height = 0;
+}
+
+// Moves readbacks whose fence has signalled to the encoders. With wait set,
+// blocks until every outstanding readback has arrived.
+void FrameCapture::collect(bool wait) {
+    bool queued = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < slots.size(); i++) {
+            Slot& slot = slots[i];
+            if (slot.state != SlotState::Reading)
+                continue;
+            GLenum result = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, 0);
+            while (wait && result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(slot.fence, 0, 1000000); // 1 ms
+            if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+                continue;
+            glDeleteSync(slot.fence);
+            slot.fence = nullptr;
+            slot.state = SlotState::Encoding;
+            jobs.push_back({ static_cast<int>(i), slot.sequence });
+            queued = true;
+        }
+    }
+    if (queued)
+        jobReady.notify_all();
+}
+
+void FrameCapture::capture(int frame, int frameWidth, int frameHeight) {
+    if (!enabled())
+        return;
+    auto start = std::chrono::steady_clock::now();
+    collect(false);
+
+    // Raw frames are concatenated, so the stream keeps the size it started with
+    bool resized = frameWidth != width || frameHeight != height;
+    if (resized && !slots.empty() && rawFile.is_open()) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            std::cerr << "Raw capture keeps its first size of " << width << "x" << height << "; resized frames are skipped" << std::endl;
+        }
+        return;
+    }
+    if (resized) {
+        if (!slots.empty()) {
+            collect(true);
+            std::unique_lock<std::mutex> lock(mutex);
+            slotFreed.wait(lock, [&] {
+                return std::all_of(slots.begin(), slots.end(), [](const Slot& slot) { return slot.state == SlotState::Free; });
+            });
+        }
+        releaseRing();
+        if (!createRing(frameWidth, frameHeight))
+            return;
+    }
+
+    if (frame % options.every == 0) {
+        Slot* free = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            bool encoding = false;
+            for (auto& slot : slots) {
+                if (slot.state == SlotState::Free && !free)
+                    free = &slot;
+                encoding = encoding || slot.state == SlotState::Encoding;
+            }
+            if (free) {
+                free->state = SlotState::Reading;
+                free->frame = frame;
+                free->sequence = nextSequence++;
+            }
+            else if (encoding) {
+                droppedEncoding++;
+            }
+            else {
+                droppedReading++;
+            }
+        }
+
+        // The copy runs on the GPU; the fence tells when the mapping holds it
+        if (free) {
+            GLState::bindDefaultFramebuffer();
+            GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, free->buffer);
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            free->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            captured++;
+        }
+    }
+
+    double elapsed = millisecondsSince(start);
+    renderThreadMs += elapsed;
+    renderThreadMaxMs = std::max(renderThreadMaxMs, elapsed);
+    captureCalls++;
+    RenderStats::frame().captureMs += static_cast<float>(elapsed);
+}
+
+void FrameCapture::encoderLoop() {
+    std::vector<unsigned char> rgba;
+    for (;;) {
+        EncodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobReady.wait(lock, [&] { return stopping || !jobs.empty(); });
+            if (jobs.empty())
+                return;
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        encode(slots[job.slot], job.sequence, rgba);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            encodeMs += millisecondsSince(start);
+            slots[job.slot].state = SlotState::Free;
+        }
+        slotFreed.notify_all();
+    }
+}
+
+void FrameCapture::encode(const Slot& slot, uint64_t sequence, std::vector<unsigned char>& rgba) {
+    // GL rows start at the bottom, captures at the top. The window is opaque, so the capture is too.
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    rgba.resize(rowBytes * height);
+    for (int y = 0; y < height; y++)
+        std::memcpy(&rgba[y * rowBytes], slot.mapped + (height - 1 - y) * rowBytes, rowBytes);
+    for (size_t i = 3; i < rgba.size(); i += 4)
+        rgba[i] = 255;
+
+    bool written;
+    if (rawFile.is_open()) {
+        // Encoders finish out of order; raw frames still go to the file in capture order
+        static std::mutex rawMutex;
+        std::unique_lock<std::mutex> lock(rawMutex);
+        rawTurn.wait(lock, [&] { return writtenSequence == sequence; });
+        rawFile.write(reinterpret_cast<const char*>(rgba.data()), rgba.size());
+        written = static_cast<bool>(rawFile);
+        writtenSequence++;
+        lock.unlock();
+        rawTurn.notify_all();
+    }
+    else {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%04d.png", slot.frame);
+        std::string path = options.directory.empty() ? name : options.directory + "/" + name;
+        written = Headless::writePng(path, width, height, rgba.data());
+    }
+    if (!written) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failedWrites++;
+    }
+}
+
+void FrameCapture::finish() {
+    if (!enabled())
+        return;
+    collect(true);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (auto& encoder : encoders)
+        encoder.join();
+    encoders.clear();
+    if (rawFile.is_open())
+        rawFile.close();
+
+    double seconds = millisecondsSince(started) / 1000.0;
+    unsigned int encoded = captured - failedWrites;
+    std::cout << "Frame capture: " << encoded << " of " << captured << " readbacks written to "
+        << (options.rawPath.empty() ? (options.directory.empty() ? "." : options.directory) : options.rawPath)
+        << ", dropped " << droppedReading << " waiting on the GPU and " << droppedEncoding << " waiting on the encoders; "
+        << "render thread " << (captureCalls ? renderThreadMs / captureCalls : 0.0) << " ms/frame (max " << renderThreadMaxMs << " ms), "
+        << "encoding " << (captured ? encodeMs / captured : 0.0) << " ms/image on " << options.threads << " threads, "
+        << (seconds > 0.0 ? encoded / seconds : 0.0) << " images/s" << std::endl;
+    if (!options.rawPath.empty() && width > 0)
+        std::cout << "Raw frames are RGBA8, top row first; for example: ffmpeg -f rawvideo -pixel_format rgba -video_size "
+            << width << "x" << height << " -i " << options.rawPath << " capture.mp4" << std::endl;
+}
+
+void FrameCapture::release() {
+    releaseRing();
+}
+
+namespace Capture {
+
+bool parseArguments(int argc, char** argv, CaptureOptions& options) {
+    options = { 0, "", "", 3, 2 };
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--capture" && hasValue) {
+            options.directory = argv[++i];
+        }
+        else if (argument == "--capture-raw" && hasValue) {
+            options.rawPath = argv[++i];
+        }
+        else if (argument == "--capture-every" && hasValue) {
+            if (!parseCount(argv[++i], options.every))
+                return false;
+        }
+        else if (argument == "--capture-buffers" && hasValue) {
+            if (!parseCount(argv[++i], options.buffers))
+                return false;
+        }
+        else if (argument == "--capture-threads" && hasValue) {
+            if (!parseCount(argv[++i], options.threads))
+                return false;
+        }
+        else {
+            continue;
+        }
+        // Naming a destination alone captures every frame
+        if (options.every == 0 && (!options.directory.empty() || !options.rawPath.empty()))
+            options.every = 1;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <glew.h>
+
+struct CaptureOptions {
+    int every;             // Every n-th frame is captured; 0 captures nothing
+    std::string directory; // PNG captures are named frame_0000.png and so on
+    std::string rawPath;   // When set, frames are appended here as raw RGBA8 instead of PNGs
+    int buffers;           // Pixel buffers in the readback ring
+    int threads;           // Encoder threads
+};
+
+// Reads finished frames back without stalling the GPU. Each due frame is
+// copied into a free buffer of a persistently mapped PBO ring and fenced;
+// frames later, once the fence has signalled, a background encoder reads
+// the pixels straight from the mapping and hands the buffer back. A due
+// frame that finds no free buffer is dropped rather than waited for.
+class FrameCapture {
+public:
+    FrameCapture(const CaptureOptions& options);
+    ~FrameCapture();
+
+    bool enabled() const;
+
+    // Creates the ring and starts the encoders
+    bool create();
+
+    // Call on the GL thread once the frame is complete in the default
+    // framebuffer. Hands finished readbacks to the encoders and starts this
+    // frame's readback when it is due. A new size drains the ring first.
+    void capture(int frame, int width, int height);
+
+    // Waits for every outstanding readback and encode, stops the encoders
+    // and prints the capture report
+    void finish();
+
+    void release();
+
+private:
+    enum class SlotState { Free, Reading, Encoding };
+
+    struct Slot {
+        GLuint buffer;
+        const unsigned char* mapped;
+        GLsync fence;
+        SlotState state; // Guarded by mutex
+        int frame;
+        uint64_t sequence; // Order of raw frames in the output file, taken when the readback is issued
+    };
+
+    struct EncodeJob {
+        int slot;
+        uint64_t sequence;
+    };
+
+    bool createRing(int width, int height);
+    void releaseRing();
+    void collect(bool wait);
+    void encoderLoop();
+    void encode(const Slot& slot, uint64_t sequence, std::vector<unsigned char>& rgba);
+
+    CaptureOptions options;
+    int width, height;
+    std::vector<Slot> slots;
+    std::deque<EncodeJob> jobs;
+    std::vector<std::thread> encoders;
+    std::mutex mutex;
+    std::condition_variable jobReady;
+    std::condition_variable slotFreed;
+    std::condition_variable rawTurn;
+    bool stopping;
+    uint64_t nextSequence;    // Next raw frame whose readback is issued
+    uint64_t writtenSequence; // Next raw frame due in the file
+    std::ofstream rawFile;
+
+    // Report
+    unsigned int captured;
+    unsigned int droppedReading;  // No free buffer; readbacks still on the GPU
+    unsigned int droppedEncoding; // No free buffer; the encoders were behind
+    unsigned int failedWrites;
+    double renderThreadMs, renderThreadMaxMs;
+    unsigned int captureCalls;
+    double encodeMs; // Summed over the encoder threads, guarded by mutex
+    std::chrono::steady_clock::time_point started;
+};
+
+namespace Capture {
+    // Reads --capture DIR, --capture-every N, --capture-raw FILE,
+    // --capture-buffers N and --capture-threads N. Returns false when an
+    // option is malformed; the options stay disabled when none is given.
+    bool parseArguments(int argc, char** argv, CaptureOptions& options);
+}
+
+#endif // FRAME_CAPTURE_H
@@ -0,0 +1,36 @@
+#include "FrameUniforms.h"
+#include "GLStateCache.h"
+#include "RingBuffer.h"
+#include <cstring>
+
+namespace {
+    FrameUniformData frameData = {};
+}
+
+namespace FrameUniforms {
+
+void setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos) {
+    frameData.view = view;
+    frameData.projection = projection;
+    frameData.viewProjection = projection * view;
+    frameData.viewPos = glm::vec4(viewPos, 1.0f);
+}
+
+void setLight(const glm::vec3& position, const glm::vec3& color) {
+    frameData.lightPos = glm::vec4(position, 1.0f);
+    frameData.lightColor = glm::vec4(color, 1.0f);
+}
+
+const FrameUniformData& data() {
+    return frameData;
+}
+
+void upload() {
+    RingAllocation block = FrameRing::get().allocate(sizeof(FrameUniformData), FrameRing::uniformAlignment());
+    if (!block.data)
+        return;
+    std::memcpy(block.data, &frameData, sizeof(FrameUniformData));
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, kFrameUniformBinding, block.buffer, block.offset, block.size);
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glm.hpp>
+#include <glew.h>
+
+// Uniform buffer binding point of the FrameData block in every shader
+const GLuint kFrameUniformBinding = 0;
+
+// std140 mirror of the FrameData block. vec3 values are padded to vec4.
+struct FrameUniformData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 viewPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+};
+
+static_assert(sizeof(FrameUniformData) == 3 * 64 + 3 * 16, "FrameUniformData must match the std140 FrameData block");
+
+// Camera and lighting shared by all programs through one uniform block,
+// written once per frame instead of per program
+namespace FrameUniforms {
+    void setCamera(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos);
+    void setLight(const glm::vec3& position, const glm::vec3& color);
+    const FrameUniformData& data();
+
+    // Copies the block into the frame ring and binds that range
+    void upload();
+}
+
+#endif // FRAME_UNIFORMS_H
@@ -0,0 +1,162 @@
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define FRUSTUM_CULLER_SSE 1
+#endif
+
+namespace {
+    // Box is outside when it lies entirely behind one plane: the centre's
+    // distance plus the extent projected on the normal is still negative
+    bool outside(const Frustum& frustum, float cx, float cy, float cz, float ex, float ey, float ez) {
+        for (const auto& plane : frustum.planes) {
+            float distance = plane.x * cx + plane.y * cy + plane.z * cz + plane.w;
+            float radius = std::fabs(plane.x) * ex + std::fabs(plane.y) * ey + std::fabs(plane.z) * ez;
+            if (distance + radius < 0.0f)
+                return true;
+        }
+        return false;
+    }
+
+    void cullRange(const Frustum& frustum, const AabbSoA& boxes, size_t begin, size_t end, uint8_t* result) {
+        size_t i = begin;
+#ifdef FRUSTUM_CULLER_SSE
+        __m128 nx[6], ny[6], nz[6], ax[6], ay[6], az[6], nw[6];
+        for (int p = 0; p < 6; p++) {
+            const glm::vec4& plane = frustum.planes[p];
+            nx[p] = _mm_set1_ps(plane.x);
+            ny[p] = _mm_set1_ps(plane.y);
+            nz[p] = _mm_set1_ps(plane.z);
+            nw[p] = _mm_set1_ps(plane.w);
+            ax[p] = _mm_set1_ps(std::fabs(plane.x));
+            ay[p] = _mm_set1_ps(std::fabs(plane.y));
+            az[p] = _mm_set1_ps(std::fabs(plane.z));
+        }
+
+        for (; i + 4 <= end; i += 4) {
+            __m128 cx = _mm_loadu_ps(&boxes.centerX[i]);
+            __m128 cy = _mm_loadu_ps(&boxes.centerY[i]);
+            __m128 cz = _mm_loadu_ps(&boxes.centerZ[i]);
+            __m128 ex = _mm_loadu_ps(&boxes.extentX[i]);
+            __m128 ey = _mm_loadu_ps(&boxes.extentY[i]);
+            __m128 ez = _mm_loadu_ps(&boxes.extentZ[i]);
+
+            __m128 out = _mm_setzero_ps();
+            for (int p = 0; p < 6; p++) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)), _mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)), _mm_mul_ps(az[p], ez));
+                out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+            }
+
+            int mask = _mm_movemask_ps(out);
+            result[i] = !(mask & 1);
+            result[i + 1] = !(mask & 2);
+            result[i + 2] = !(mask & 4);
+            result[i + 3] = !(mask & 8);
+        }
+#endif
+        for (; i < end; i++) {
+            result[i] = !outside(frustum, boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i],
+                boxes.extentX[i], boxes.extentY[i], boxes.extentZ[i]);
+        }
+    }
+}
+
+void AabbSoA::add(const Aabb& box) {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    extentX.push_back(extent.x);
+    extentY.push_back(extent.y);
+    extentZ.push_back(extent.z);
+}
+
+void AabbSoA::clear() {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    extentX.clear();
+    extentY.clear();
+    extentZ.clear();
+}
+
+size_t AabbSoA::size() const {
+    return centerX.size();
+}
+
+namespace FrustumCuller {
+
+Frustum extract(const glm::mat4& m) {
+    // glm is column-major: m[column][row], so row r is (m[0][r], m[1][r], m[2][r], m[3][r])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // Left
+    frustum.planes[1] = row3 - row0; // Right
+    frustum.planes[2] = row3 + row1; // Bottom
+    frustum.planes[3] = row3 - row1; // Top
+    frustum.planes[4] = row3 + row2; // Near
+    frustum.planes[5] = row3 - row2; // Far
+    for (auto& plane : frustum.planes)
+        plane /= glm::length(glm::vec3(plane));
+    return frustum;
+}
+
+Aabb transform(const Aabb& box, const glm::mat4& model) {
+    glm::vec3 translation(model[3]);
+    Aabb result = { translation, translation };
+    for (int column = 0; column < 3; column++) {
+        for (int row = 0; row < 3; row++) {
+            float a = model[column][row] * box.min[column];
+            float b = model[column][row] * box.max[column];
+            result.min[row] += std::fmin(a, b);
+            result.max[row] += std::fmax(a, b);
+        }
+    }
+    return result;
+}
+
+Aabb merge(const Aabb& a, const Aabb& b) {
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+}
+
+bool intersects(const Frustum& frustum, const Aabb& box) {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    return !outside(frustum, center.x, center.y, center.z, extent.x, extent.y, extent.z);
+}
+
+void cull(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible) {
+    visible.clear();
+    size_t count = boxes.size();
+    if (count == 0)
+        return;
+
+    static thread_local std::vector<uint8_t> result;
+    result.resize(count);
+    uint8_t* flags = result.data();
+
+    JobSystem::parallelForGroups(count, [&](size_t begin, size_t end) {
+        cullRange(frustum, boxes, begin, end, flags);
+    });
+
+    for (size_t i = 0; i < count; i++) {
+        if (flags[i])
+            visible.push_back(static_cast<uint32_t>(i));
+    }
+
+    FrameStats& stats = RenderStats::frame();
+    stats.frustumTested += static_cast<unsigned int>(count);
+    stats.frustumCulled += static_cast<unsigned int>(count - visible.size());
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef FRUSTUM_CULLER_H
+#define FRUSTUM_CULLER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+
+struct Aabb {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Inward-facing planes (xyz normal, w distance), normalized
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Boxes stored as centre/half-extent columns so four boxes load into one
+// SIMD register per component
+class AabbSoA {
+public:
+    void add(const Aabb& box);
+    void clear();
+    size_t size() const;
+
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> extentX, extentY, extentZ;
+};
+
+namespace FrustumCuller {
+    // Gribb/Hartmann plane extraction from projection * view
+    Frustum extract(const glm::mat4& viewProjection);
+
+    // World box of a transformed local box (Arvo's method)
+    Aabb transform(const Aabb& box, const glm::mat4& model);
+    Aabb merge(const Aabb& a, const Aabb& b);
+
+    // Single box test for callers with only a handful of boxes
+    bool intersects(const Frustum& frustum, const Aabb& box);
+
+    // Writes the indices of boxes intersecting the frustum to visible and
+    // adds the tested and culled counts to the frame stats. Large sets are
+    // split across the job system.
+    void cull(const Frustum& frustum, const AabbSoA& boxes, std::vector<uint32_t>& visible);
+}
+
+#endif // FRUSTUM_CULLER_H
@@ -0,0 +1,280 @@
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <array>
+
+namespace {
+    const GLuint kUnknown = 0xFFFFFFFFu;
+    const int kTextureUnits = 16;
+    const int kIndexedBindings = 16;
+
+    // Targets tracked per texture unit; anything else is always forwarded
+    const std::array<GLenum, 4> kTextureTargets = { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_3D };
+    const std::array<GLenum, 6> kBufferTargets = { GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER,
+        GL_DRAW_INDIRECT_BUFFER, GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER };
+    const std::array<GLenum, 3> kIndexedTargets = { GL_UNIFORM_BUFFER, GL_SHADER_STORAGE_BUFFER, GL_ATOMIC_COUNTER_BUFFER };
+    const std::array<GLenum, 5> kCapabilities = { GL_DEPTH_TEST, GL_BLEND, GL_CULL_FACE, GL_SCISSOR_TEST, GL_POLYGON_OFFSET_FILL };
+
+    struct State {
+        GLuint program;
+        GLuint vertexArray;
+        GLuint activeUnit;
+        GLuint textures[kTextureUnits][kTextureTargets.size()];
+        GLuint buffers[kBufferTargets.size()];
+        GLuint indexedBuffers[kIndexedTargets.size()][kIndexedBindings];
+        GLuint framebuffer;
+        GLint viewport[4];
+        int capabilities[kCapabilities.size()]; // -1 unknown, 0 disabled, 1 enabled
+        GLenum depthFunc;
+        int depthMask;
+        int colorMask; // -1 unknown, 0 all channels off, 1 all on
+        GLenum blendSource, blendDestination;
+    };
+
+    State state;
+    bool initialized = false;
+    GLuint defaultTarget = 0;
+
+    template <size_t N>
+    int slotOf(const std::array<GLenum, N>& targets, GLenum target) {
+        auto it = std::find(targets.begin(), targets.end(), target);
+        return it == targets.end() ? -1 : static_cast<int>(it - targets.begin());
+    }
+
+    void reset() {
+        state.program = kUnknown;
+        state.vertexArray = kUnknown;
+        state.activeUnit = kUnknown;
+        for (auto& unit : state.textures)
+            std::fill(std::begin(unit), std::end(unit), kUnknown);
+        std::fill(std::begin(state.buffers), std::end(state.buffers), kUnknown);
+        for (auto& target : state.indexedBuffers)
+            std::fill(std::begin(target), std::end(target), kUnknown);
+        state.framebuffer = kUnknown;
+        std::fill(std::begin(state.viewport), std::end(state.viewport), -1);
+        std::fill(std::begin(state.capabilities), std::end(state.capabilities), -1);
+        state.depthFunc = kUnknown;
+        state.depthMask = -1;
+        state.colorMask = -1;
+        state.blendSource = kUnknown;
+        state.blendDestination = kUnknown;
+        initialized = true;
+    }
+
+    State& current() {
+        if (!initialized)
+            reset();
+        return state;
+    }
+
+    // Returns true when the call has to be issued
+    bool changed(bool differs) {
+        if (differs)
+            RenderStats::frame().stateCallsIssued++;
+        else
+            RenderStats::frame().stateCallsSkipped++;
+        return differs;
+    }
+}
+
+namespace GLState {
+
+void useProgram(GLuint program) {
+    State& s = current();
+    if (changed(s.program != program)) {
+        glUseProgram(program);
+        s.program = program;
+    }
+}
+
+void bindVertexArray(GLuint vertexArray) {
+    State& s = current();
+    if (changed(s.vertexArray != vertexArray)) {
+        glBindVertexArray(vertexArray);
+        s.vertexArray = vertexArray;
+    }
+}
+
+void bindBuffer(GLenum target, GLuint buffer) {
+    State& s = current();
+    int slot = slotOf(kBufferTargets, target);
+    if (slot < 0) {
+        changed(true);
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (changed(s.buffers[slot] != buffer)) {
+        glBindBuffer(target, buffer);
+        s.buffers[slot] = buffer;
+    }
+}
+
+void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    State& s = current();
+    int slot = slotOf(kIndexedTargets, target);
+    if (slot < 0 || index >= static_cast<GLuint>(kIndexedBindings)) {
+        changed(true);
+        glBindBufferBase(target, index, buffer);
+        return;
+    }
+    if (changed(s.indexedBuffers[slot][index] != buffer)) {
+        glBindBufferBase(target, index, buffer);
+        s.indexedBuffers[slot][index] = buffer;
+
+        // Binding a range also replaces the generic binding point
+        int generic = slotOf(kBufferTargets, target);
+        if (generic >= 0)
+            s.buffers[generic] = buffer;
+    }
+}
+
+void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    // Ranges of a streaming buffer move every frame, so they are always issued
+    State& s = current();
+    changed(true);
+    glBindBufferRange(target, index, buffer, offset, size);
+
+    int slot = slotOf(kIndexedTargets, target);
+    if (slot >= 0 && index < static_cast<GLuint>(kIndexedBindings))
+        s.indexedBuffers[slot][index] = kUnknown; // A later whole-buffer bind must be issued
+    int generic = slotOf(kBufferTargets, target);
+    if (generic >= 0)
+        s.buffers[generic] = buffer;
+}
+
+void bindTexture(GLuint unit, GLenum target, GLuint texture) {
+    State& s = current();
+    int slot = slotOf(kTextureTargets, target);
+    bool tracked = slot >= 0 && unit < static_cast<GLuint>(kTextureUnits);
+    if (s.activeUnit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        s.activeUnit = unit;
+    }
+    if (!changed(!tracked || s.textures[unit][slot] != texture))
+        return;
+
+    glBindTexture(target, texture);
+    if (tracked)
+        s.textures[unit][slot] = texture;
+}
+
+void bindFramebuffer(GLuint framebuffer) {
+    State& s = current();
+    if (changed(s.framebuffer != framebuffer)) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        s.framebuffer = framebuffer;
+    }
+}
+
+void setDefaultFramebuffer(GLuint framebuffer) {
+    defaultTarget = framebuffer;
+}
+
+void bindDefaultFramebuffer() {
+    bindFramebuffer(defaultTarget);
+}
+
+GLuint defaultFramebuffer() {
+    return defaultTarget;
+}
+
+void viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    State& s = current();
+    if (changed(s.viewport[0] != x || s.viewport[1] != y || s.viewport[2] != width || s.viewport[3] != height)) {
+        glViewport(x, y, width, height);
+        s.viewport[0] = x;
+        s.viewport[1] = y;
+        s.viewport[2] = width;
+        s.viewport[3] = height;
+    }
+}
+
+void setEnabled(GLenum capability, bool enabled) {
+    State& s = current();
+    int slot = slotOf(kCapabilities, capability);
+    if (!changed(slot < 0 || s.capabilities[slot] != (enabled ? 1 : 0)))
+        return;
+
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+    if (slot >= 0)
+        s.capabilities[slot] = enabled ? 1 : 0;
+}
+
+void depthFunc(GLenum func) {
+    State& s = current();
+    if (changed(s.depthFunc != func)) {
+        glDepthFunc(func);
+        s.depthFunc = func;
+    }
+}
+
+void depthMask(bool write) {
+    State& s = current();
+    if (changed(s.depthMask != (write ? 1 : 0))) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        s.depthMask = write ? 1 : 0;
+    }
+}
+
+void colorMask(bool write) {
+    State& s = current();
+    if (changed(s.colorMask != (write ? 1 : 0))) {
+        GLboolean value = write ? GL_TRUE : GL_FALSE;
+        glColorMask(value, value, value, value);
+        s.colorMask = write ? 1 : 0;
+    }
+}
+
+void blendFunc(GLenum source, GLenum destination) {
+    State& s = current();
+    if (changed(s.blendSource != source || s.blendDestination != destination)) {
+        glBlendFunc(source, destination);
+        s.blendSource = source;
+        s.blendDestination = destination;
+    }
+}
+
+void invalidate() {
+    reset();
+}
+
+void forgetProgram(GLuint program) {
+    State& s = current();
+    if (s.program == program)
+        s.program = kUnknown;
+}
+
+void forgetVertexArray(GLuint vertexArray) {
+    State& s = current();
+    if (s.vertexArray == vertexArray)
+        s.vertexArray = kUnknown;
+}
+
+void forgetTexture(GLuint texture) {
+    State& s = current();
+    for (auto& unit : s.textures) {
+        for (auto& bound : unit) {
+            if (bound == texture)
+                bound = kUnknown;
+        }
+    }
+}
+
+void forgetBuffer(GLuint buffer) {
+    State& s = current();
+    for (auto& bound : s.buffers) {
+        if (bound == buffer)
+            bound = kUnknown;
+    }
+    for (auto& target : s.indexedBuffers) {
+        for (auto& bound : target) {
+            if (bound == buffer)
+                bound = kUnknown;
+        }
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+#ifndef GL_STATE_CACHE_H
+#define GL_STATE_CACHE_H
+
+#include <glew.h>
+
+// Shadow copy of the GL binding and fixed-function state. Calls that would
+// set what is already current are dropped; the rest are forwarded to GL.
+// Code that changes this state must go through GLState or call invalidate().
+namespace GLState {
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+
+    // GL_ELEMENT_ARRAY_BUFFER is part of the VAO and is always forwarded
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+    // Always leaves the unit active, so glTexImage2D and the like that follow
+    // edit this texture; glActiveTexture itself is only issued on a change
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    void bindFramebuffer(GLuint framebuffer);
+
+    // Framebuffer the frame is presented from: 0 for a window, an FBO when
+    // rendering offscreen. Passes that render elsewhere return to it.
+    void setDefaultFramebuffer(GLuint framebuffer);
+    void bindDefaultFramebuffer();
+    GLuint defaultFramebuffer();
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+    void setEnabled(GLenum capability, bool enabled);
+    void depthFunc(GLenum func);
+    void depthMask(bool write);
+    void colorMask(bool write); // All four channels together
+    void blendFunc(GLenum source, GLenum destination);
+
+    // Forgets everything; the next call of each kind is always issued
+    void invalidate();
+
+    // Clears cached names after glDelete* so a recycled name is not skipped
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vertexArray);
+    void forgetTexture(GLuint texture);
+    void forgetBuffer(GLuint buffer);
+}
+
+#endif // GL_STATE_CACHE_H
@@ -0,0 +1,502 @@
+#include "GpuCulling.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include "RingBuffer.h"
+#include "FrameUniforms.h"
+#include "RenderQueue.h"
+#include "PropLod.h"
+#include "OcclusionBuffer.h"
+#include "terrain.h"
+#include "shaders/LoadShaders.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <gtc/constants.hpp>
+#include <gtc/matrix_transform.hpp>
+
+namespace {
+    // std140 mirror of the CullData block
+    struct CullUniformData {
+        glm::vec4 planes[6];
+        glm::mat4 view;
+        glm::mat4 pyramidViewProjection;
+        glm::vec4 lodScreenSizes;
+        glm::vec4 projectionScale;
+        glm::uvec4 counts;
+        glm::vec4 meshBounds[kMaxCullMeshes];
+        glm::uvec4 meshRanges[kMaxCullMeshes];
+    };
+
+    static_assert(sizeof(CullUniformData) == 6 * 16 + 2 * 64 + 3 * 16 + kMaxCullMeshes * 32, "CullUniformData must match the std140 CullData block");
+    static_assert(sizeof(DrawElementsIndirectCommand) == 20, "DrawElementsIndirectCommand must match the indirect layout");
+
+    const GLuint kCullFlagLod = 1;
+    const GLuint kCullFlagOcclusion = 2;
+
+    glm::ivec2 levelSize(const glm::ivec2& size, int level) {
+        return glm::max(glm::ivec2(size.x >> level, size.y >> level), glm::ivec2(1));
+    }
+
+    // The compute shader's occlusion test, on a pyramid read back to the CPU.
+    // Kept to the shader's operation order so both give the same verdicts.
+    bool occludedOnCpu(const std::vector<std::vector<float>>& levels, const glm::ivec2& size, const glm::mat4& m,
+        const glm::vec3& center, const glm::vec3& extent) {
+        glm::vec3 boxMin = center - extent;
+        glm::vec3 boxMax = center + extent;
+        glm::vec2 minNdc(1e30f), maxNdc(-1e30f);
+        float nearest = 1e30f;
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y, (corner & 4) ? boxMax.z : boxMin.z);
+            glm::vec4 clip = (m[0] * point.x + m[1] * point.y) + (m[2] * point.z + m[3]);
+            if (clip.z < -clip.w)
+                return false;
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            minNdc = glm::min(minNdc, glm::vec2(ndc));
+            maxNdc = glm::max(maxNdc, glm::vec2(ndc));
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        if (minNdc.x < -1.0f || minNdc.y < -1.0f || maxNdc.x > 1.0f || maxNdc.y > 1.0f)
+            return false;
+
+        glm::vec2 minUv = minNdc * 0.5f + 0.5f;
+        glm::vec2 maxUv = maxNdc * 0.5f + 0.5f;
+        int level = 0;
+        glm::ivec2 first, last, texels;
+        for (;;) {
+            texels = levelSize(size, level);
+            first = glm::min(glm::ivec2(minUv * glm::vec2(texels)), texels - 1);
+            last = glm::min(glm::ivec2(maxUv * glm::vec2(texels)), texels - 1);
+            if ((last.x - first.x <= 1 && last.y - first.y <= 1) || level == static_cast<int>(levels.size()) - 1)
+                break;
+            level++;
+        }
+
+        float farthest = 0.0f;
+        for (int y = first.y; y <= last.y; y++) {
+            for (int x = first.x; x <= last.x; x++)
+                farthest = std::max(farthest, levels[level][static_cast<size_t>(y) * texels.x + x]);
+        }
+        return nearest > farthest;
+    }
+}
+
+DepthPyramid::DepthPyramid()
+    : depthTexture(0), pyramidTexture(0), pyramidSize(0), levelCount(0), builtViewProjection(1.0f), built(false) {}
+
+void DepthPyramid::resize(int width, int height) {
+    release();
+    pyramidSize = glm::ivec2(width, height);
+    levelCount = 1;
+    while ((std::max(width, height) >> levelCount) > 0)
+        levelCount++;
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+    glTextureStorage2D(depthTexture, 1, GL_DEPTH_COMPONENT32F, width, height);
+    glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &pyramidTexture);
+    glTextureStorage2D(pyramidTexture, levelCount, GL_R32F, width, height);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+void DepthPyramid::build(ShaderProgram& reduceShader, int width, int height, const glm::mat4& viewProjection) {
+    if (width <= 0 || height <= 0)
+        return;
+    if (pyramidSize != glm::ivec2(width, height))
+        resize(width, height);
+
+    timer.begin();
+    GLState::bindDefaultFramebuffer();
+    glCopyTextureSubImage2D(depthTexture, 0, 0, 0, 0, 0, width, height);
+
+    // Level 0 takes the depth copy texel for texel, every later level halves the one below
+    reduceShader.use();
+    reduceShader.setInt("source", kDepthPyramidTextureUnit);
+    for (int level = 0; level < levelCount; level++) {
+        glm::ivec2 target = levelSize(pyramidSize, level);
+        GLState::bindTexture(kDepthPyramidTextureUnit, GL_TEXTURE_2D, level == 0 ? depthTexture : pyramidTexture);
+        reduceShader.setInt("sourceLevel", level == 0 ? 0 : level - 1);
+        glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((target.x + 7) / 8, (target.y + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    timer.end();
+    RenderStats::frame().gpuCullMs += timer.lastMs();
+
+    builtViewProjection = viewProjection;
+    built = true;
+}
+
+bool DepthPyramid::valid() const {
+    return built;
+}
+
+GLuint DepthPyramid::texture() const {
+    return pyramidTexture;
+}
+
+int DepthPyramid::levels() const {
+    return levelCount;
+}
+
+glm::ivec2 DepthPyramid::size() const {
+    return pyramidSize;
+}
+
+const glm::mat4& DepthPyramid::viewProjection() const {
+    return builtViewProjection;
+}
+
+void DepthPyramid::read(std::vector<std::vector<float>>& levels) const {
+    levels.resize(levelCount);
+    GLState::bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    for (int level = 0; level < levelCount; level++) {
+        glm::ivec2 texels = levelSize(pyramidSize, level);
+        levels[level].resize(static_cast<size_t>(texels.x) * texels.y);
+        glGetTextureImage(pyramidTexture, level, GL_RED, GL_FLOAT, static_cast<GLsizei>(levels[level].size() * sizeof(float)), levels[level].data());
+    }
+}
+
+void DepthPyramid::release() {
+    timer.release();
+    if (depthTexture) {
+        GLState::forgetTexture(depthTexture);
+        glDeleteTextures(1, &depthTexture);
+    }
+    if (pyramidTexture) {
+        GLState::forgetTexture(pyramidTexture);
+        glDeleteTextures(1, &pyramidTexture);
+    }
+    depthTexture = pyramidTexture = 0;
+    pyramidSize = glm::ivec2(0);
+    levelCount = 0;
+    built = false;
+}
+
+GpuCullBatch::GpuCullBatch()
+    : transformBuffer(0), boundsBuffer(0), templateBuffer(0), commandBuffer(0), instanceBuffer(0), resultBuffer(0),
+      commandBytes(0), instances(0) {}
+
+bool GpuCullBatch::create(const std::vector<glm::mat4>& transforms, const AabbSoA& bounds, const std::vector<GpuCullMesh>& meshes) {
+    release();
+    if (transforms.empty() || transforms.size() != bounds.size())
+        return false;
+    if (meshes.empty() || meshes.size() > static_cast<size_t>(kMaxCullMeshes)) {
+        std::cerr << "GPU culling takes 1 to " << kMaxCullMeshes << " meshes per batch, got " << meshes.size() << std::endl;
+        return false;
+    }
+    instances = static_cast<GLuint>(transforms.size());
+
+    // Every command has room for all instances, so appends never collide
+    std::vector<DrawElementsIndirectCommand> commands;
+    for (const auto& mesh : meshes) {
+        meshRanges.push_back({ static_cast<GLuint>(commands.size()), static_cast<GLuint>(mesh.lods.size()) });
+        meshBounds.push_back(mesh.bounds);
+        for (const auto& lod : mesh.lods)
+            commands.push_back({ lod.indexCount, 0, lod.indexOffset, 0, static_cast<GLuint>(commands.size()) * instances });
+    }
+    commandBytes = static_cast<GLsizeiptr>(commands.size() * sizeof(DrawElementsIndirectCommand));
+
+    std::vector<glm::vec4> boxes(bounds.size() * 2);
+    for (size_t i = 0; i < bounds.size(); i++) {
+        boxes[i * 2] = glm::vec4(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i], 0.0f);
+        boxes[i * 2 + 1] = glm::vec4(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i], 0.0f);
+    }
+
+    glCreateBuffers(1, &transformBuffer);
+    glNamedBufferStorage(transformBuffer, transforms.size() * sizeof(glm::mat4), transforms.data(), 0);
+    glCreateBuffers(1, &boundsBuffer);
+    glNamedBufferStorage(boundsBuffer, boxes.size() * sizeof(glm::vec4), boxes.data(), 0);
+    glCreateBuffers(1, &templateBuffer);
+    glNamedBufferStorage(templateBuffer, commandBytes, commands.data(), 0);
+    glCreateBuffers(1, &commandBuffer);
+    glNamedBufferStorage(commandBuffer, commandBytes, commands.data(), 0);
+    glCreateBuffers(1, &instanceBuffer);
+    glNamedBufferStorage(instanceBuffer, static_cast<GLsizeiptr>(commands.size()) * instances * sizeof(GLuint), nullptr, 0);
+    glCreateBuffers(1, &resultBuffer);
+    glNamedBufferStorage(resultBuffer, instances * sizeof(GLuint), nullptr, 0);
+    return true;
+}
+
+bool GpuCullBatch::created() const {
+    return instances > 0;
+}
+
+void GpuCullBatch::cull(ShaderProgram& cullShader, const glm::mat4& view, const glm::mat4& projection, const DepthPyramid& pyramid) {
+    if (!created())
+        return;
+    const GpuCullingSettings& config = GpuCulling::settings();
+    const LodSettings& lod = PropLod::settings();
+    bool occlusion = config.occlusion && pyramid.valid();
+
+    CullUniformData data = {};
+    Frustum frustum = FrustumCuller::extract(projection * view);
+    for (int p = 0; p < 6; p++)
+        data.planes[p] = frustum.planes[p];
+    data.view = view;
+    data.pyramidViewProjection = pyramid.viewProjection();
+    data.lodScreenSizes = glm::vec4(lod.screenSizes[0], lod.screenSizes[1], lod.screenSizes[2], lod.cullScreenSize);
+    data.projectionScale = glm::vec4(projection[1][1], 0.0f, 0.0f, 0.0f);
+    data.counts = glm::uvec4(instances, static_cast<GLuint>(meshRanges.size()),
+        (lod.enabled ? kCullFlagLod : 0) | (occlusion ? kCullFlagOcclusion : 0), static_cast<GLuint>(pyramid.levels()));
+    for (size_t m = 0; m < meshRanges.size(); m++) {
+        data.meshBounds[m] = meshBounds[m];
+        data.meshRanges[m] = glm::uvec4(meshRanges[m].firstCommand, meshRanges[m].lodCount, 0, 0);
+    }
+    RingAllocation block = FrameRing::get().allocate(sizeof(CullUniformData), FrameRing::uniformAlignment());
+    if (!block.data)
+        return;
+    std::memcpy(block.data, &data, sizeof(CullUniformData));
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, kCullUniformBinding, block.buffer, block.offset, block.size);
+
+    // Start from empty commands; the shader appends the visible instances
+    glCopyNamedBufferSubData(templateBuffer, commandBuffer, 0, 0, commandBytes);
+
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullTransformBinding, transformBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullInstanceBinding, instanceBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullBoundsBinding, boundsBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullCommandBinding, commandBuffer);
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullResultBinding, resultBuffer);
+    if (occlusion)
+        GLState::bindTexture(kDepthPyramidTextureUnit, GL_TEXTURE_2D, pyramid.texture());
+    cullShader.setInt("depthPyramid", kDepthPyramidTextureUnit);
+    cullShader.use();
+    glDispatchCompute((instances + 63) / 64, 1, 1);
+
+    // The draws read the commands and the instance indices the cull wrote
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuCullBatch::attach(GLuint vertexArray) const {
+    // Binding points 0-2 carry the interleaved vertex attributes
+    const GLuint bindingIndex = kCullInstanceAttribute;
+    glVertexArrayVertexBuffer(vertexArray, bindingIndex, instanceBuffer, 0, sizeof(GLuint));
+    glVertexArrayBindingDivisor(vertexArray, bindingIndex, 1);
+    glVertexArrayAttribIFormat(vertexArray, kCullInstanceAttribute, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(vertexArray, kCullInstanceAttribute, bindingIndex);
+    glEnableVertexArrayAttrib(vertexArray, kCullInstanceAttribute);
+}
+
+void GpuCullBatch::draw(int mesh) const {
+    const MeshRange& range = meshRanges[mesh];
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kCullTransformBinding, transformBuffer);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(range.firstCommand * sizeof(DrawElementsIndirectCommand)),
+        static_cast<GLsizei>(range.lodCount), 0);
+    RenderStats::countDraw(0); // The instance counts stay on the GPU, so no triangles are counted
+}
+
+void GpuCullBatch::readResults(std::vector<uint32_t>& results, std::vector<DrawElementsIndirectCommand>& commands) const {
+    glFinish();
+    results.resize(instances);
+    commands.resize(commandBytes / sizeof(DrawElementsIndirectCommand));
+    glGetNamedBufferSubData(resultBuffer, 0, instances * sizeof(GLuint), results.data());
+    glGetNamedBufferSubData(commandBuffer, 0, commandBytes, commands.data());
+}
+
+size_t GpuCullBatch::instanceCount() const {
+    return instances;
+}
+
+void GpuCullBatch::release() {
+    GLuint* buffers[] = { &transformBuffer, &boundsBuffer, &templateBuffer, &commandBuffer, &instanceBuffer, &resultBuffer };
+    for (GLuint* buffer : buffers) {
+        if (*buffer) {
+            GLState::forgetBuffer(*buffer);
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+    }
+    meshRanges.clear();
+    meshBounds.clear();
+    commandBytes = 0;
+    instances = 0;
+}
+
+namespace GpuCulling {
+
+GpuCullingSettings& settings() {
+    static GpuCullingSettings cullingSettings = { false, true };
+    return cullingSettings;
+}
+
+bool printReport(const Terrain& terrain, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, int propCount, int viewCount) {
+    const int width = 800, height = 600;
+    ShaderInfo cullShaders[] = { { GL_COMPUTE_SHADER, "shaders/gpu_cull_compute_shader.glsl", 0 }, { GL_NONE, NULL, 0 } };
+    ShaderInfo pyramidShaders[] = { { GL_COMPUTE_SHADER, "shaders/depth_pyramid_compute_shader.glsl", 0 }, { GL_NONE, NULL, 0 } };
+    ShaderInfo depthShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/depth_vertex_shader.glsl", 0 },
+        { GL_FRAGMENT_SHADER, "shaders/depth_fragment_shader.glsl", 0 },
+        { GL_NONE, NULL, 0 }
+    };
+    ShaderProgram cullShader(LoadShaders(cullShaders));
+    ShaderProgram pyramidShader(LoadShaders(pyramidShaders));
+    ShaderProgram depthShader(LoadShaders(depthShaders));
+    if (!cullShader.valid() || !pyramidShader.valid() || !depthShader.valid())
+        return false;
+    FrameRing::get().create(64 * 1024, 3);
+
+    // Terrain depth, drawn as the scene's depth pre-pass would
+    GLuint elementBuffer, positionBuffer;
+    glCreateBuffers(1, &elementBuffer);
+    glNamedBufferStorage(elementBuffer, indices.size() * sizeof(unsigned int), indices.data(), 0);
+    GLuint terrainVertexArray = DepthPrepass::createVertexArray(vertices.data(), vertices.size(), sizeof(Vertex), elementBuffer, positionBuffer);
+    GLuint framebuffer, depthBuffer;
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glGenFramebuffers(1, &framebuffer);
+    GLState::bindFramebuffer(framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    GLuint previousDefault = GLState::defaultFramebuffer();
+    GLState::setDefaultFramebuffer(framebuffer);
+    GLState::viewport(0, 0, width, height);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+    GLState::depthFunc(GL_LESS);
+    GLState::depthMask(true);
+
+    // The occlusion report's props, each with a yaw so the transform path is exercised
+    std::mt19937 random(1234);
+    float gridSize = static_cast<float>(terrain.getGridSize());
+    std::uniform_real_distribution<float> position(0.0f, gridSize);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    Aabb unitBox = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+    std::vector<glm::mat4> transforms;
+    AabbSoA props;
+    for (int i = 0; i < propCount; i++) {
+        float x = position(random), z = position(random);
+        glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(x, terrain.getHeightAt(x, z) + 0.5f, z));
+        transform = glm::rotate(transform, angle(random), glm::vec3(0.0f, 1.0f, 0.0f));
+        transforms.push_back(transform);
+        props.add(FrustumCuller::transform(unitBox, transform));
+    }
+    GpuCullMesh mesh = { { { 0, 300, 0.0f }, { 300, 120, 0.01f }, { 420, 48, 0.03f } }, glm::vec4(0.0f, 0.0f, 0.0f, 0.87f) };
+    GpuCullBatch batch;
+    batch.create(transforms, props, { mesh });
+
+    OcclusionBuffer occlusionBuffer;
+    occlusionBuffer.buildOccluders(terrain);
+    DepthPyramid pyramid;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), static_cast<float>(width) / height, 0.1f, 500.0f);
+    GLuint query;
+    glGenQueries(1, &query);
+
+    double gpuCullMs = 0.0, gpuPyramidMs = 0.0, cpuCullMs = 0.0;
+    size_t inFrustum = 0, gpuOccluded = 0, cpuOccluded = 0, bothOccluded = 0;
+    size_t frustumMismatches = 0, occlusionMismatches = 0, lodMismatches = 0;
+    std::vector<uint32_t> results, visible;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<std::vector<float>> levels;
+    for (int viewIndex = 0; viewIndex < viewCount; viewIndex++) {
+        float x = position(random), z = position(random), yaw = angle(random);
+        glm::vec3 eye(x, terrain.getHeightAt(x, z) + 2.0f, z);
+        glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 viewProjection = projection * view;
+        FrameRing::get().beginFrame();
+
+        GLState::bindDefaultFramebuffer();
+        glClear(GL_DEPTH_BUFFER_BIT);
+        FrameUniforms::setCamera(view, projection, eye);
+        FrameUniforms::upload();
+        depthShader.use();
+        depthShader.setMat4("model", glm::mat4(1.0f));
+        GLState::bindVertexArray(terrainVertexArray);
+        glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        pyramid.build(pyramidShader, width, height, viewProjection);
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        gpuPyramidMs += elapsed / 1.0e6;
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        batch.cull(cullShader, view, projection, pyramid);
+        glEndQuery(GL_TIME_ELAPSED);
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        gpuCullMs += elapsed / 1.0e6;
+        batch.readResults(results, commands);
+        pyramid.read(levels);
+        FrameRing::get().endFrame();
+
+        // The CPU culler on the same view: frustum planes, then the occlusion buffer
+        auto start = std::chrono::steady_clock::now();
+        FrustumCuller::cull(FrustumCuller::extract(viewProjection), props, visible);
+        std::vector<uint32_t> frustumVisible = visible;
+        occlusionBuffer.render(viewProjection);
+        occlusionBuffer.cull(props, visible);
+        cpuCullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        inFrustum += frustumVisible.size();
+
+        std::vector<uint8_t> inside(transforms.size(), 0), cpuVisible(transforms.size(), 0);
+        for (auto index : frustumVisible)
+            inside[index] = 1;
+        for (auto index : visible)
+            cpuVisible[index] = 1;
+        GLuint lodCounts[3] = {};
+        for (size_t i = 0; i < transforms.size(); i++) {
+            CullResult result = static_cast<CullResult>(results[i]);
+            if ((result == CullResult::OutsideFrustum) == static_cast<bool>(inside[i])) {
+                frustumMismatches++;
+                continue;
+            }
+            if (!inside[i])
+                continue;
+
+            glm::vec3 center(props.centerX[i], props.centerY[i], props.centerZ[i]);
+            glm::vec3 extent(props.extentX[i], props.extentY[i], props.extentZ[i]);
+            bool occluded = occludedOnCpu(levels, pyramid.size(), pyramid.viewProjection(), center, extent);
+            if (occluded != (result == CullResult::Occluded))
+                occlusionMismatches++;
+            gpuOccluded += result == CullResult::Occluded;
+            cpuOccluded += !cpuVisible[i];
+            bothOccluded += result == CullResult::Occluded && !cpuVisible[i];
+
+            if (result == CullResult::Visible) {
+                int level = 0;
+                if (PropLod::settings().enabled)
+                    level = PropLod::selectLod(PropLod::projectedScreenSize(mesh.bounds, transforms[i], view, projection), 3).level;
+                if (level >= 0)
+                    lodCounts[level]++;
+            }
+        }
+        for (int level = 0; level < 3; level++)
+            lodMismatches += commands[level].instanceCount != lodCounts[level];
+    }
+
+    std::cout << "GPU culling report: " << propCount << " props, " << viewCount << " views, "
+        << width << "x" << height << " depth pyramid with " << pyramid.levels() << " levels" << std::endl;
+    std::cout << "  GPU pyramid " << gpuPyramidMs / viewCount << " ms/view, cull " << gpuCullMs / viewCount
+        << " ms/view; CPU frustum and occlusion buffer " << cpuCullMs / viewCount << " ms/view" << std::endl;
+    std::cout << "  " << inFrustum / viewCount << " props in frustum per view; " << frustumMismatches << " frustum verdicts differ from FrustumCuller" << std::endl;
+    std::cout << "  Hi-Z occludes " << gpuOccluded / viewCount << " per view, " << occlusionMismatches
+        << " verdicts differ from the pyramid test on the CPU; the occlusion buffer occludes " << cpuOccluded / viewCount
+        << " per view, " << bothOccluded / viewCount << " of them also by Hi-Z" << std::endl;
+    std::cout << "  " << lodMismatches << " LOD instance counts differ from PropLod" << std::endl;
+
+    glDeleteQueries(1, &query);
+    batch.release();
+    pyramid.release();
+    GLState::setDefaultFramebuffer(previousDefault);
+    GLState::bindDefaultFramebuffer();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+    GLState::forgetVertexArray(terrainVertexArray);
+    glDeleteVertexArrays(1, &terrainVertexArray);
+    glDeleteBuffers(1, &positionBuffer);
+    glDeleteBuffers(1, &elementBuffer);
+    cullShader.release();
+    pyramidShader.release();
+    depthShader.release();
+    FrameRing::get().release();
+    return frustumMismatches == 0 && occlusionMismatches == 0 && lodMismatches == 0;
+}
+
+}
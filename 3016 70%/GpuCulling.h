@@ -0,0 +1,159 @@
+#pragma once
+#ifndef GPU_CULLING_H
+#define GPU_CULLING_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "FrustumCuller.h"
+#include "MeshSimplifier.h"
+#include "ShaderProgram.h"
+#include "GpuTimer.h"
+#include "Vertex.h"
+
+class Terrain;
+
+// Binding points of the GPU culling blocks. The storage bindings stay above
+// the clustered lighting ones, since the drawing shaders use both.
+const GLuint kCullUniformBinding = 3;
+const GLuint kCullTransformBinding = 3;
+const GLuint kCullInstanceBinding = 4;
+const GLuint kCullBoundsBinding = 5;
+const GLuint kCullCommandBinding = 6;
+const GLuint kCullResultBinding = 7;
+const GLuint kDepthPyramidTextureUnit = 2;
+const GLuint kCullInstanceAttribute = 3;
+
+// Meshes per batch the CullData block has room for
+const int kMaxCullMeshes = 16;
+
+// Layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Per-instance verdicts in the result buffer
+enum class CullResult : uint32_t {
+    OutsideFrustum,
+    Occluded,
+    Visible, // Frustum and occlusion passed; each mesh may still drop its LODs
+};
+
+struct GpuCullingSettings {
+    bool enabled;
+    bool occlusion; // Test against the previous frame's depth pyramid
+};
+
+// Max-depth mip chain of the scene depth. Built once the scene is drawn and
+// tested against by the next frame's cull, so the occlusion test sees last
+// frame's depth from last frame's camera.
+class DepthPyramid {
+public:
+    DepthPyramid();
+
+    // Copies the depth of the default framebuffer's lower-left width x height
+    // and reduces it level by level in reduceShader. Its GPU time goes to
+    // the frame stats. Culls test boxes with the pyramid's own camera, so
+    // props it hid that the new view reveals appear a frame late.
+    void build(ShaderProgram& reduceShader, int width, int height, const glm::mat4& viewProjection);
+
+    bool valid() const;
+    GLuint texture() const;
+    int levels() const;
+    glm::ivec2 size() const;
+    const glm::mat4& viewProjection() const;
+
+    // Reads every level back, level 0 first (slow; for the report)
+    void read(std::vector<std::vector<float>>& levels) const;
+
+    void release();
+
+private:
+    void resize(int width, int height);
+
+    GLuint depthTexture;   // Copy of the scene depth
+    GLuint pyramidTexture; // R32F, level 0 at the scene size
+    glm::ivec2 pyramidSize;
+    int levelCount;
+    glm::mat4 builtViewProjection;
+    bool built;
+    GpuTimer timer;
+};
+
+// Mesh of a GPU-culled model: one indirect command per LOD level
+struct GpuCullMesh {
+    std::vector<LodLevel> lods;
+    glm::vec4 bounds; // Object-space bounding sphere, for the LOD choice
+};
+
+// Instances of one model culled on the GPU. A compute shader tests every
+// instance's world box against the frustum and the depth pyramid, picks a
+// LOD per mesh as PropLod does (without the crossfade) and appends the
+// instance to that LOD's indirect command. Each mesh is then drawn with one
+// glMultiDrawElementsIndirect over its LOD commands. The visible instance
+// indices reach the vertex shader as an instanced attribute, which starts
+// at each command's base instance.
+class GpuCullBatch {
+public:
+    GpuCullBatch();
+
+    // Uploads the transforms and world boxes and lays out the commands
+    bool create(const std::vector<glm::mat4>& transforms, const AabbSoA& bounds, const std::vector<GpuCullMesh>& meshes);
+    bool created() const;
+
+    // Resets the commands and dispatches the cull. An invalid pyramid, or
+    // occlusion switched off, leaves the frustum and LOD tests.
+    void cull(ShaderProgram& cullShader, const glm::mat4& view, const glm::mat4& projection, const DepthPyramid& pyramid);
+
+    // Feeds the visible instance indices to the attribute at
+    // kCullInstanceAttribute of a mesh's vertex array
+    void attach(GLuint vertexArray) const;
+
+    // Binds the transforms and draws every LOD of a mesh; its attached
+    // vertex array must be bound
+    void draw(int mesh) const;
+
+    // Waits for the GPU and reads the verdicts and commands back (slow; for the report)
+    void readResults(std::vector<uint32_t>& results, std::vector<DrawElementsIndirectCommand>& commands) const;
+
+    size_t instanceCount() const;
+
+    void release();
+
+private:
+    struct MeshRange {
+        GLuint firstCommand;
+        GLuint lodCount;
+    };
+
+    GLuint transformBuffer;
+    GLuint boundsBuffer;
+    GLuint templateBuffer; // Commands with no instances, copied over the live ones each cull
+    GLuint commandBuffer;
+    GLuint instanceBuffer; // Visible instance indices; command i owns [baseInstance, baseInstance + instances)
+    GLuint resultBuffer;
+    GLsizeiptr commandBytes;
+    GLuint instances;
+    std::vector<MeshRange> meshRanges;
+    std::vector<glm::vec4> meshBounds;
+};
+
+namespace GpuCulling {
+    GpuCullingSettings& settings();
+
+    // Needs a current GL context. Scatters propCount boxes over the terrain,
+    // renders its depth for viewCount random ground-level views and checks
+    // the compute culling against the CPU: frustum verdicts against
+    // FrustumCuller, LOD choices against PropLod, and occlusion verdicts
+    // against the same pyramid test run on the read-back pyramid. The CPU
+    // occlusion buffer's verdicts are listed alongside for comparison.
+    bool printReport(const Terrain& terrain, const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        int propCount = 10000, int viewCount = 20);
+}
+
+#endif // GPU_CULLING_H
@@ -0,0 +1,53 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+    : queries{}, pending{}, slot(0), created(false), active(false), resultMs(0.0f) {}
+
+void GpuTimer::collect(int index) {
+    GLint available = 0;
+    glGetQueryObjectiv(queries[index][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    GLuint64 start = 0, finish = 0;
+    glGetQueryObjectui64v(queries[index][0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(queries[index][1], GL_QUERY_RESULT, &finish);
+    resultMs = static_cast<float>(finish - start) / 1.0e6f;
+    pending[index] = false;
+}
+
+void GpuTimer::begin() {
+    if (!created) {
+        glGenQueries(kFramesInFlight * 2, &queries[0][0]);
+        created = true;
+    }
+
+    // A slot whose result has not come back yet is skipped this frame
+    // rather than overwritten or waited on
+    if (pending[slot])
+        collect(slot);
+    active = !pending[slot];
+    if (active)
+        glQueryCounter(queries[slot][0], GL_TIMESTAMP);
+}
+
+void GpuTimer::end() {
+    if (active) {
+        glQueryCounter(queries[slot][1], GL_TIMESTAMP);
+        pending[slot] = true;
+    }
+    active = false;
+    slot = (slot + 1) % kFramesInFlight;
+}
+
+float GpuTimer::lastMs() const {
+    return resultMs;
+}
+
+void GpuTimer::release() {
+    if (created)
+        glDeleteQueries(kFramesInFlight * 2, &queries[0][0]);
+    created = false;
+    for (auto& slotPending : pending)
+        slotPending = false;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glew.h>
+
+// Measures the GPU time between begin and end with a pair of timestamp
+// queries per frame in flight. Results are read once they are available,
+// a few frames late, so the CPU never waits on the GPU.
+class GpuTimer {
+public:
+    GpuTimer();
+
+    // Both must be called on the GL thread, once per frame each
+    void begin();
+    void end();
+
+    // Most recent finished measurement, 0 until the first one arrives
+    float lastMs() const;
+
+    void release();
+
+private:
+    static const int kFramesInFlight = 3;
+
+    void collect(int slot);
+
+    GLuint queries[kFramesInFlight][2];
+    bool pending[kFramesInFlight];
+    int slot;
+    bool created;
+    bool active;
+    float resultMs;
+};
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,302 @@
+#include "Headless.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <gtc/constants.hpp>
+
+// Only Mesa's EGL offers a surfaceless display; other platforms keep the window
+#if defined(__linux__)
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#define HEADLESS_EGL 1
+#endif
+
+namespace {
+#ifdef HEADLESS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+
+    // Frames left out of the summary while shaders compile and caches fill
+    const int kWarmupFrames = 2;
+
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+        // Built once; a function-local static is safe when encoders run concurrently
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++)
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void putBigEndian(std::vector<unsigned char>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            out.push_back(static_cast<unsigned char>(value >> shift));
+    }
+
+    void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> chunk;
+        putBigEndian(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        putBigEndian(chunk, crc32(&chunk[4], chunk.size() - 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+
+    bool parseInt(const char* text, int& value) {
+        char* end = nullptr;
+        long parsed = std::strtol(text, &end, 10);
+        if (end == text || *end != '\0' || parsed <= 0)
+            return false;
+        value = static_cast<int>(parsed);
+        return true;
+    }
+
+    double percentile(std::vector<double> values, double fraction) {
+        if (values.empty())
+            return 0.0;
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+    }
+}
+
+HeadlessTarget::HeadlessTarget(const HeadlessOptions& options)
+    : options(options), framebuffer(0), colorBuffer(0), depthBuffer(0) {}
+
+bool HeadlessTarget::create() {
+    glGenRenderbuffers(1, &colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, options.width, options.height);
+
+    glGenFramebuffers(1, &framebuffer);
+    GLState::bindFramebuffer(framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Headless framebuffer is incomplete" << std::endl;
+        release();
+        return false;
+    }
+
+    GLState::setDefaultFramebuffer(framebuffer);
+    GLState::viewport(0, 0, options.width, options.height);
+    return true;
+}
+
+void HeadlessTarget::release() {
+    GLState::setDefaultFramebuffer(0);
+    GLState::bindFramebuffer(0);
+    if (framebuffer)
+        glDeleteFramebuffers(1, &framebuffer);
+    if (colorBuffer)
+        glDeleteRenderbuffers(1, &colorBuffer);
+    if (depthBuffer)
+        glDeleteRenderbuffers(1, &depthBuffer);
+    framebuffer = colorBuffer = depthBuffer = 0;
+}
+
+void HeadlessTarget::beginFrame() {
+    frameStart = std::chrono::steady_clock::now();
+    GLState::bindDefaultFramebuffer();
+}
+
+void HeadlessTarget::endFrame(int frame) {
+    auto submitted = std::chrono::steady_clock::now();
+    glFinish();
+    auto finished = std::chrono::steady_clock::now();
+
+    const FrameStats& stats = RenderStats::frame();
+    timings.push_back({ frame,
+        std::chrono::duration<double, std::milli>(submitted - frameStart).count(),
+        std::chrono::duration<double, std::milli>(finished - frameStart).count(),
+        stats.drawCalls, stats.triangles });
+}
+
+void HeadlessTarget::finish() const {
+    std::ofstream file;
+    if (!options.timingsPath.empty()) {
+        file.open(options.timingsPath);
+        if (!file)
+            std::cerr << "Failed to write timings: " << options.timingsPath << std::endl;
+    }
+    std::ostream& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cout;
+    out << "frame,cpu_ms,frame_ms,draw_calls,triangles" << std::endl;
+    for (const auto& timing : timings)
+        out << timing.frame << "," << timing.cpuMs << "," << timing.frameMs << "," << timing.drawCalls << "," << timing.triangles << std::endl;
+
+    std::vector<double> cpu, total;
+    for (const auto& timing : timings) {
+        if (timing.frame < kWarmupFrames)
+            continue;
+        cpu.push_back(timing.cpuMs);
+        total.push_back(timing.frameMs);
+    }
+    std::cout << "Headless run: " << timings.size() << " frames at " << options.width << "x" << options.height
+        << ", after " << kWarmupFrames << " warm-up frames: frame median " << percentile(total, 0.5)
+        << " ms, p95 " << percentile(total, 0.95) << " ms; CPU median " << percentile(cpu, 0.5)
+        << " ms, p95 " << percentile(cpu, 0.95) << " ms" << std::endl;
+}
+
+namespace Headless {
+
+bool parseArguments(int argc, char** argv, HeadlessOptions& options) {
+    options = { false, 800, 600, 120, "", 1.0f / 60.0f };
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--headless")
+            options.enabled = true;
+    }
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (argument == "--headless") {
+            continue;
+        }
+        else if (argument == "--frames" && hasValue) {
+            if (!parseInt(argv[++i], options.frames))
+                return false;
+        }
+        else if (argument.rfind("--capture", 0) == 0) {
+            i += hasValue ? 1 : 0;
+        }
+        else if (argument == "--gpu-culling" || argument == "--vertex-pulling") {
+            continue; // Read by main
+        }
+        else if (argument == "--timings" && hasValue) {
+            options.timingsPath = argv[++i];
+        }
+        else if (argument == "--size" && hasValue) {
+            if (std::sscanf(argv[++i], "%dx%d", &options.width, &options.height) != 2 || options.width <= 0 || options.height <= 0)
+                return false;
+        }
+        else if (options.enabled) {
+            std::cerr << "Unknown headless option: " << argument << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool createContext() {
+#ifdef HEADLESS_EGL
+    display = eglGetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    EGLint major, minor;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::cerr << "Failed to initialize a surfaceless EGL display" << std::endl;
+        return false;
+    }
+    eglBindAPI(EGL_OPENGL_API);
+
+    EGLint configAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint configCount = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+
+    EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 6,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, configCount ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        std::cerr << "Failed to create an OpenGL 4.6 core context (with llvmpipe, set MESA_GL_VERSION_OVERRIDE=4.6)" << std::endl;
+        destroyContext();
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "Headless rendering needs EGL and is only available on Linux" << std::endl;
+    return false;
+#endif
+}
+
+void destroyContext() {
+#ifdef HEADLESS_EGL
+    if (display == EGL_NO_DISPLAY)
+        return;
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    eglTerminate(display);
+    display = EGL_NO_DISPLAY;
+    context = EGL_NO_CONTEXT;
+#endif
+}
+
+void cameraPath(int frame, int frames, float gridSize, glm::vec2& position, float& yaw, float& pitch) {
+    float angle = glm::two_pi<float>() * frame / std::max(frames, 1);
+    float radius = gridSize * 0.3f;
+    glm::vec2 center(gridSize * 0.5f);
+    position = center + radius * glm::vec2(std::cos(angle), std::sin(angle));
+
+    // Tangent to the loop, turned a little towards the centre
+    yaw = glm::degrees(angle) + 90.0f + 20.0f;
+    pitch = -10.0f;
+}
+
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+    const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header;
+    putBigEndian(header, static_cast<uint32_t>(width));
+    putBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8-bit RGBA, no interlace
+    writeChunk(file, "IHDR", header);
+
+    // Every row starts with filter type 0
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y * rowBytes, rgba + (y + 1) * rowBytes);
+    }
+
+    // zlib stream of stored deflate blocks
+    std::vector<unsigned char> data = { 0x78, 0x01 };
+    const size_t kMaxBlock = 65535;
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += kMaxBlock) {
+        size_t size = std::min(kMaxBlock, raw.size() - offset);
+        bool last = offset + size >= raw.size();
+        data.push_back(last ? 1 : 0);
+        data.push_back(static_cast<unsigned char>(size));
+        data.push_back(static_cast<unsigned char>(size >> 8));
+        data.push_back(static_cast<unsigned char>(~size));
+        data.push_back(static_cast<unsigned char>(~size >> 8));
+        data.insert(data.end(), raw.begin() + offset, raw.begin() + offset + size);
+        if (last)
+            break;
+    }
+    uint32_t a = 1, b = 0;
+    for (auto byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    putBigEndian(data, b << 16 | a);
+    writeChunk(file, "IDAT", data);
+    writeChunk(file, "IEND", {});
+    return static_cast<bool>(file);
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+
+struct HeadlessOptions {
+    bool enabled; // --headless was given
+    int width, height;
+    int frames;
+    std::string timingsPath; // Per-frame CSV; empty prints it to stdout
+    float frameTime;         // Simulated seconds per frame, so runs are repeatable
+};
+
+struct HeadlessFrameTiming {
+    int frame;
+    double cpuMs;   // Start of the frame to the end of submission
+    double frameMs; // Start of the frame to the GPU finishing it
+    unsigned int drawCalls;
+    unsigned long long triangles;
+};
+
+// Offscreen render target of a headless run: the frame renders into an FBO
+// instead of a window, and each frame's timings are collected when it ends
+class HeadlessTarget {
+public:
+    HeadlessTarget(const HeadlessOptions& options);
+
+    // Creates the FBO and makes it the default framebuffer
+    bool create();
+    void release();
+
+    void beginFrame();
+
+    // Waits for the GPU and records the frame's timings
+    void endFrame(int frame);
+
+    // Writes the timings CSV and prints a summary
+    void finish() const;
+
+private:
+    HeadlessOptions options;
+    GLuint framebuffer;
+    GLuint colorBuffer, depthBuffer;
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<HeadlessFrameTiming> timings;
+};
+
+namespace Headless {
+    // Reads --headless and its options, wherever they appear:
+    //   --frames N  --size WxH  --timings FILE
+    // The --capture options are left to Capture::parseArguments and
+    // --gpu-culling and --vertex-pulling to main.
+    // Returns false when an option is malformed; enabled tells whether
+    // --headless was given.
+    bool parseArguments(int argc, char** argv, HeadlessOptions& options);
+
+    // OpenGL 4.6 core context on an EGL surfaceless display, which Mesa
+    // provides with llvmpipe on machines without a display or GPU
+    bool createContext();
+    void destroyContext();
+
+    // Scripted camera: one loop around the terrain centre over the run,
+    // looking slightly inwards and down. Yaw and pitch are in degrees.
+    void cameraPath(int frame, int frames, float gridSize, glm::vec2& position, float& yaw, float& pitch);
+
+    // 8-bit RGBA, rows top to bottom, stored uncompressed
+    bool writePng(const std::string& path, int width, int height, const unsigned char* rgba);
+}
+
+#endif // HEADLESS_H
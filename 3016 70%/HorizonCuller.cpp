@@ -0,0 +1,402 @@
+#include "HorizonCuller.h"
+#include "terrain.h"
+#include "JobSystem.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HORIZON_CULLER_SSE 1
+#endif
+
+namespace {
+    // Monotonic stand-in for atan2 over [0, 4) without trigonometry. It never
+    // changes faster than the true angle, and at most twice as slowly.
+    float pseudoAngle(float x, float z) {
+        float p = x / (std::fabs(x) + std::fabs(z));
+        return z < 0.0f ? 3.0f + p : 1.0f - p;
+    }
+
+    glm::vec2 pseudoAngleDirection(float angle) {
+        float p = angle < 2.0f ? 1.0f - angle : angle - 3.0f;
+        float z = angle < 2.0f ? 1.0f - std::fabs(p) : std::fabs(p) - 1.0f;
+        return glm::normalize(glm::vec2(p, z));
+    }
+}
+
+HorizonCuller::HorizonCuller(const Terrain& terrain, int azimuthBins)
+    : terrain(terrain), azimuthBins(std::bit_ceil(static_cast<unsigned int>(std::max(azimuthBins, 4)))), eye(0.0f), hasHorizon(false), updateMs(0.0f) {
+    // Far enough to cross the whole heightfield from any corner
+    int gridSize = terrain.getGridSize();
+    rings = static_cast<int>(std::ceil(gridSize * 1.4143f)) + 1;
+    horizon.assign(static_cast<size_t>(rings) * this->azimuthBins * 2, -FLT_MAX);
+    squareHeights.assign(static_cast<size_t>(gridSize) * gridSize, -FLT_MAX);
+    hiddenHeights = squareHeights;
+
+    // Level 0 keeps the lowest corner of every grid square, each level above
+    // the lowest of four squares below; the last square of an odd row or
+    // column has no neighbour
+    const std::vector<float>& heights = terrain.getHeights();
+    std::vector<float> squares(static_cast<size_t>(gridSize) * gridSize);
+    for (int z = 0; z < gridSize; z++) {
+        for (int x = 0; x < gridSize; x++) {
+            const float* corner = &heights[z * (gridSize + 1) + x];
+            squares[z * gridSize + x] = std::min(std::min(corner[0], corner[1]), std::min(corner[gridSize + 1], corner[gridSize + 2]));
+        }
+    }
+    lowestHeights.push_back(std::move(squares));
+    for (int size = gridSize; size > 1; size = (size + 1) / 2) {
+        const std::vector<float>& below = lowestHeights.back();
+        int next = (size + 1) / 2;
+        std::vector<float> level(static_cast<size_t>(next) * next);
+        for (int z = 0; z < next; z++) {
+            for (int x = 0; x < next; x++) {
+                int x0 = x * 2, x1 = std::min(x * 2 + 1, size - 1);
+                int z0 = z * 2, z1 = std::min(z * 2 + 1, size - 1);
+                level[z * next + x] = std::min(std::min(below[z0 * size + x0], below[z0 * size + x1]),
+                                               std::min(below[z1 * size + x0], below[z1 * size + x1]));
+            }
+        }
+        lowestHeights.push_back(std::move(level));
+    }
+
+    float binWidth = 4.0f / this->azimuthBins;
+    for (int bin = 0; bin < this->azimuthBins; bin++)
+        directions.push_back(pseudoAngleDirection((bin + 0.5f) * binWidth));
+}
+
+void HorizonCuller::update(const glm::vec3& eye) {
+    if (hasHorizon && eye == this->eye) {
+        updateMs = 0.0f;
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    hasHorizon = true;
+    this->eye = eye;
+
+    int gridSize = terrain.getGridSize();
+    float binWidth = 4.0f / azimuthBins;
+
+    // Past the farthest corner no ray meets the terrain again
+    float reachX = std::max(eye.x, gridSize - eye.x), reachZ = std::max(eye.z, gridSize - eye.z);
+    int lastTerrainRing = std::min(static_cast<int>(std::sqrt(reachX * reachX + reachZ * reachZ)) + 1, rings - 1);
+
+    // Ring by ring, so each ring's row is written in order and the one
+    // before it carries the steepest slope so far
+    float* previous = &horizon[0];
+    std::fill(previous, previous + azimuthBins, -FLT_MAX);
+    for (int ring = 1; ring < rings; ring++) {
+        float distance = static_cast<float>(ring);
+        float* row = &horizon[static_cast<size_t>(ring) * azimuthBins * 2];
+        if (ring > lastTerrainRing) {
+            std::copy(previous, previous + azimuthBins, row);
+            previous = row;
+            continue;
+        }
+
+        // Every ray in the bin crosses this distance inside the square. The
+        // first level whose squares are at least as wide covers it with two
+        // by two of them.
+        float halfSize = distance * binWidth;
+        int level = std::min(static_cast<int>(std::bit_width(static_cast<unsigned int>(std::ceil(halfSize * 2.0f)) - 1)), static_cast<int>(lowestHeights.size()) - 1);
+        const std::vector<float>& squares = lowestHeights[level];
+        int size = (gridSize + (1 << level) - 1) >> level;
+        float scale = 1.0f / static_cast<float>(1 << level);
+        for (int bin = 0; bin < azimuthBins; bin++) {
+            float steepest = previous[bin];
+            float x = eye.x + directions[bin].x * distance;
+            float z = eye.z + directions[bin].y * distance;
+            float left = x - halfSize, right = x + halfSize, back = z - halfSize, front = z + halfSize;
+            if (left >= 0.0f && back >= 0.0f && right <= gridSize && front <= gridSize) {
+                // Truncation is floor here; the far edge of the grid
+                // belongs to the last square
+                int x0 = static_cast<int>(left * scale), x1 = std::min(static_cast<int>(right * scale), size - 1);
+                int z0 = static_cast<int>(back * scale), z1 = std::min(static_cast<int>(front * scale), size - 1);
+                float lowest = std::min(std::min(squares[z0 * size + x0], squares[z0 * size + x1]),
+                                        std::min(squares[z1 * size + x0], squares[z1 * size + x1]));
+                steepest = std::max(steepest, (lowest - eye.y) / distance);
+            }
+            row[bin] = steepest;
+        }
+        previous = row;
+    }
+
+    // Each coarser level keeps the lowest horizon of two neighbouring bins
+    for (int ring = 0; ring < rings; ring++) {
+        float* row = &horizon[static_cast<size_t>(ring) * azimuthBins * 2];
+        for (int size = azimuthBins, offset = 0; size > 1; offset += size, size /= 2) {
+            for (int bin = 0; bin < size / 2; bin++)
+                row[offset + size + bin] = std::min(row[offset + bin * 2], row[offset + bin * 2 + 1]);
+        }
+    }
+
+    updateSquares();
+    updateMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool HorizonCuller::isVisible(float centerX, float centerZ, float radius, float top) const {
+    float dx = centerX - eye.x, dz = centerZ - eye.z;
+    float distance = std::sqrt(dx * dx + dz * dz);
+    float nearest = distance - radius;
+    if (nearest < 1.0f)
+        return true; // Nothing on the horizon can be in front of it
+
+    // Steepest sight line from the eye to any point of the box
+    float rise = top - eye.y;
+    float slope = rise / (rise > 0.0f ? nearest : distance + radius);
+
+    int first, last;
+    binRange(dx, dz, distance, radius, first, last);
+    return slope >= lowestHorizon(std::min(static_cast<int>(nearest), rings - 1), first, last);
+}
+
+void HorizonCuller::binRange(float dx, float dz, float distance, float radius, int& first, int& last) const {
+    // tan(asin(r / d)) bounds the true half angle, and the pseudo angle
+    // never turns faster than the true one
+    float halfAngle = radius / std::sqrt(std::max(distance * distance - radius * radius, 1.0f));
+
+    // Offset by one turn so truncation rounds down
+    float binsPerUnit = azimuthBins * 0.25f;
+    float center = pseudoAngle(dx, dz) * binsPerUnit + azimuthBins;
+    float spread = halfAngle * binsPerUnit;
+    first = static_cast<int>(center - spread);
+    last = static_cast<int>(center + spread);
+}
+
+float HorizonCuller::lowestHorizon(int ring, int first, int last) const {
+    int span = last - first;
+    if (span + 1 >= azimuthBins)
+        return -FLT_MAX;
+
+    // The first level whose bins are wider than the span covers the range
+    // with two bins. Their lowest horizon can only make the test more lenient.
+    int level = std::bit_width(static_cast<unsigned int>(span));
+    const float* row = &horizon[static_cast<size_t>(ring) * azimuthBins * 2 + azimuthBins * 2 - (azimuthBins * 2 >> level)];
+    int wrap = (azimuthBins >> level) - 1;
+    return std::min(row[(first >> level) & wrap], row[(last >> level) & wrap]);
+}
+
+float HorizonCuller::hiddenHeight(int first, int last, float nearest, float farthest) const {
+    if (nearest < 1.0f)
+        return -FLT_MAX;
+    float lowest = lowestHorizon(std::min(static_cast<int>(nearest), rings - 1), first, last);
+    if (lowest == -FLT_MAX)
+        return -FLT_MAX;
+    return eye.y + lowest * (lowest >= 0.0f ? nearest : farthest);
+}
+
+void HorizonCuller::updateSquares() {
+    // A point in a square lies in the square's circle, so its sight line
+    // meets at least the lowest horizon behind that circle. Below the
+    // matching height it is hidden: a rising sight line runs at least to
+    // the circle before reaching the point, a falling one at most past it.
+    int gridSize = terrain.getGridSize();
+    const float radius = 0.7072f; // Half the diagonal, rounded up
+#ifdef HORIZON_CULLER_SSE
+    __m128 eyeX = _mm_set1_ps(eye.x), steps = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    __m128 one = _mm_set1_ps(1.0f), three = _mm_set1_ps(3.0f), zero = _mm_setzero_ps();
+    __m128 signMask = _mm_set1_ps(-0.0f), tiny = _mm_set1_ps(1e-6f);
+    __m128 radii = _mm_set1_ps(radius), radiusSquared = _mm_set1_ps(radius * radius);
+    __m128 binsPerUnit = _mm_set1_ps(azimuthBins * 0.25f), binOffset = _mm_set1_ps(static_cast<float>(azimuthBins));
+    alignas(16) int32_t first[4], last[4];
+    alignas(16) float nearest[4], farthest[4];
+#endif
+    for (int z = 0; z < gridSize; z++) {
+        float dz = z + 0.5f - eye.z;
+        float* row = &squareHeights[z * gridSize];
+        int x = 0;
+#ifdef HORIZON_CULLER_SSE
+        // The same bins as binRange, four squares at a time
+        __m128 dz4 = _mm_set1_ps(dz), dzAbs = _mm_set1_ps(std::fabs(dz));
+        __m128 behind = dz < 0.0f ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : zero;
+        for (; x + 4 <= gridSize; x += 4) {
+            __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), steps), eyeX);
+            __m128 distanceSquared = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz4, dz4));
+            __m128 distance = _mm_sqrt_ps(distanceSquared);
+            __m128 halfAngle = _mm_div_ps(radii, _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(distanceSquared, radiusSquared), one)));
+            __m128 p = _mm_div_ps(dx, _mm_max_ps(_mm_add_ps(_mm_andnot_ps(signMask, dx), dzAbs), tiny));
+            __m128 angle = _mm_or_ps(_mm_and_ps(behind, _mm_add_ps(three, p)), _mm_andnot_ps(behind, _mm_sub_ps(one, p)));
+            __m128 center = _mm_add_ps(_mm_mul_ps(angle, binsPerUnit), binOffset);
+            __m128 spread = _mm_mul_ps(halfAngle, binsPerUnit);
+            _mm_store_si128(reinterpret_cast<__m128i*>(first), _mm_cvttps_epi32(_mm_sub_ps(center, spread)));
+            _mm_store_si128(reinterpret_cast<__m128i*>(last), _mm_cvttps_epi32(_mm_add_ps(center, spread)));
+            _mm_store_ps(nearest, _mm_sub_ps(distance, radii));
+            _mm_store_ps(farthest, _mm_add_ps(distance, radii));
+            for (int k = 0; k < 4; k++)
+                row[x + k] = hiddenHeight(first[k], last[k], nearest[k], farthest[k]);
+        }
+#endif
+        for (; x < gridSize; x++) {
+            float dx = x + 0.5f - eye.x;
+            float distance = std::sqrt(dx * dx + dz * dz);
+            int first, last;
+            binRange(dx, dz, distance, radius, first, last);
+            row[x] = hiddenHeight(first, last, distance - radius, distance + radius);
+        }
+    }
+
+    // A box centred in a square and no wider than one reaches at most into
+    // its neighbours, so it is held to the lowest of the nine
+    for (int z = 0; z < gridSize; z++) {
+        const float* above = &squareHeights[std::max(z - 1, 0) * gridSize];
+        const float* middle = &squareHeights[z * gridSize];
+        const float* below = &squareHeights[std::min(z + 1, gridSize - 1) * gridSize];
+        for (int x = 0; x < gridSize; x++)
+            hiddenHeights[z * gridSize + x] = std::min({ above[x], middle[x], below[x] });
+    }
+    for (int z = 0; z < gridSize; z++) {
+        float* row = &hiddenHeights[z * gridSize];
+        float left = row[0];
+        for (int x = 0; x < gridSize; x++) {
+            float center = row[x];
+            row[x] = std::min({ left, center, row[std::min(x + 1, gridSize - 1)] });
+            left = center;
+        }
+    }
+}
+
+void HorizonCuller::cullRange(const AabbSoA& boxes, const uint32_t* indices, size_t begin, size_t end, uint8_t* result) const {
+    size_t i = begin;
+#ifdef HORIZON_CULLER_SSE
+    int gridSize = terrain.getGridSize();
+    __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), gridSide = _mm_set1_ps(static_cast<float>(gridSize));
+    alignas(16) int32_t square[4];
+
+    for (; i + 4 <= end; i += 4) {
+        const uint32_t* lane = indices + i;
+        __m128 cx, cz, ex, ez, top;
+        if (lane[1] == lane[0] + 1 && lane[2] == lane[0] + 2 && lane[3] == lane[0] + 3) {
+            // A run of boxes, common after the frustum test: plain loads
+            uint32_t index = lane[0];
+            cx = _mm_loadu_ps(&boxes.centerX[index]);
+            cz = _mm_loadu_ps(&boxes.centerZ[index]);
+            ex = _mm_loadu_ps(&boxes.extentX[index]);
+            ez = _mm_loadu_ps(&boxes.extentZ[index]);
+            top = _mm_add_ps(_mm_loadu_ps(&boxes.centerY[index]), _mm_loadu_ps(&boxes.extentY[index]));
+        }
+        else {
+            cx = _mm_setr_ps(boxes.centerX[lane[0]], boxes.centerX[lane[1]], boxes.centerX[lane[2]], boxes.centerX[lane[3]]);
+            cz = _mm_setr_ps(boxes.centerZ[lane[0]], boxes.centerZ[lane[1]], boxes.centerZ[lane[2]], boxes.centerZ[lane[3]]);
+            ex = _mm_setr_ps(boxes.extentX[lane[0]], boxes.extentX[lane[1]], boxes.extentX[lane[2]], boxes.extentX[lane[3]]);
+            ez = _mm_setr_ps(boxes.extentZ[lane[0]], boxes.extentZ[lane[1]], boxes.extentZ[lane[2]], boxes.extentZ[lane[3]]);
+            top = _mm_setr_ps(boxes.centerY[lane[0]] + boxes.extentY[lane[0]], boxes.centerY[lane[1]] + boxes.extentY[lane[1]],
+                              boxes.centerY[lane[2]] + boxes.extentY[lane[2]], boxes.centerY[lane[3]] + boxes.extentY[lane[3]]);
+        }
+
+        // Boxes centred on the grid and no wider than a square compare their
+        // top with the square's hidden height; the rest read square 0 and
+        // take the full test below
+        __m128 onGrid = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(cx, zero), _mm_cmplt_ps(cx, gridSide)),
+                                   _mm_and_ps(_mm_cmpge_ps(cz, zero), _mm_cmplt_ps(cz, gridSide)));
+        onGrid = _mm_and_ps(onGrid, _mm_and_ps(_mm_cmple_ps(ex, one), _mm_cmple_ps(ez, one)));
+        __m128i squareIndex = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(cz)), gridSide), cx));
+        _mm_store_si128(reinterpret_cast<__m128i*>(square), _mm_and_si128(squareIndex, _mm_castps_si128(onGrid)));
+        __m128 hidden = _mm_setr_ps(hiddenHeights[square[0]], hiddenHeights[square[1]], hiddenHeights[square[2]], hiddenHeights[square[3]]);
+        int visibleMask = ~_mm_movemask_ps(_mm_and_ps(onGrid, _mm_cmplt_ps(top, hidden)));
+        result[i] = visibleMask & 1;
+        result[i + 1] = (visibleMask >> 1) & 1;
+        result[i + 2] = (visibleMask >> 2) & 1;
+        result[i + 3] = (visibleMask >> 3) & 1;
+
+        int offGrid = ~_mm_movemask_ps(onGrid) & 0xf;
+        for (; offGrid != 0; offGrid &= offGrid - 1) {
+            int k = std::countr_zero(static_cast<unsigned int>(offGrid));
+            uint32_t box = lane[k];
+            float radius = std::sqrt(boxes.extentX[box] * boxes.extentX[box] + boxes.extentZ[box] * boxes.extentZ[box]);
+            result[i + k] = isVisible(boxes.centerX[box], boxes.centerZ[box], radius, boxes.centerY[box] + boxes.extentY[box]);
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        uint32_t index = indices[i];
+        float radius = std::sqrt(boxes.extentX[index] * boxes.extentX[index] + boxes.extentZ[index] * boxes.extentZ[index]);
+        result[i] = isVisible(boxes.centerX[index], boxes.centerZ[index], radius, boxes.centerY[index] + boxes.extentY[index]);
+    }
+}
+
+bool HorizonCuller::isVisible(const Aabb& box) const {
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    glm::vec3 extent = (box.max - box.min) * 0.5f;
+    return isVisible(center.x, center.z, std::sqrt(extent.x * extent.x + extent.z * extent.z), box.max.y);
+}
+
+void HorizonCuller::cull(const AabbSoA& boxes, std::vector<uint32_t>& visible) const {
+    size_t count = visible.size();
+    static thread_local std::vector<uint8_t> result;
+    result.resize(count);
+    uint8_t* flags = result.data();
+
+    JobSystem::parallelForGroups(count, [&](size_t begin, size_t end) {
+        cullRange(boxes, visible.data(), begin, end, flags);
+    });
+
+    // Branchless: about a third of the boxes survive, in no predictable order
+    size_t write = 0;
+    for (size_t i = 0; i < count; i++) {
+        visible[write] = visible[i];
+        write += flags[i];
+    }
+
+    FrameStats& stats = RenderStats::frame();
+    stats.horizonTested += static_cast<unsigned int>(count);
+    stats.horizonCulled += static_cast<unsigned int>(count - write);
+    visible.resize(write);
+}
+
+float HorizonCuller::updateMilliseconds() const {
+    return updateMs;
+}
+
+namespace Horizon {
+
+HorizonSettings& settings() {
+    static HorizonSettings horizonSettings = { true };
+    return horizonSettings;
+}
+
+void printReport(const Terrain& terrain, int propCount, int viewCount) {
+    std::mt19937 random(1234);
+    float gridSize = static_cast<float>(terrain.getGridSize());
+    std::uniform_real_distribution<float> position(0.0f, gridSize);
+
+    AabbSoA props;
+    for (int i = 0; i < propCount; i++) {
+        float x = position(random), z = position(random);
+        glm::vec3 base(x, terrain.getHeightAt(x, z), z);
+        props.add({ base - glm::vec3(0.5f, 0.0f, 0.5f), base + glm::vec3(0.5f, 1.0f, 0.5f) });
+    }
+
+    HorizonCuller culler(terrain);
+    double updateMs = 0.0, cullMs = 0.0;
+    size_t culled = 0;
+    std::vector<uint32_t> visible;
+    for (int view = 0; view < viewCount; view++) {
+        float x = position(random), z = position(random);
+        culler.update(glm::vec3(x, terrain.getHeightAt(x, z) + 2.0f, z));
+        updateMs += culler.updateMilliseconds();
+
+        // Every prop is tested, not just those in a frustum
+        visible.resize(props.size());
+        for (size_t i = 0; i < visible.size(); i++)
+            visible[i] = static_cast<uint32_t>(i);
+
+        auto start = std::chrono::steady_clock::now();
+        culler.cull(props, visible);
+        cullMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        culled += props.size() - visible.size();
+    }
+
+    std::cout << "Horizon report: " << propCount << " props, " << viewCount << " views, "
+        << JobSystem::threadCount() << " threads" << std::endl;
+    std::cout << "  update " << updateMs / viewCount << " ms/view, cull " << cullMs / viewCount << " ms/view" << std::endl;
+    std::cout << "  " << culled / viewCount << " culled per view ("
+        << 100.0 * culled / (static_cast<double>(propCount) * viewCount) << "%)" << std::endl;
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef HORIZON_CULLER_H
+#define HORIZON_CULLER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "FrustumCuller.h"
+
+class Terrain;
+
+struct HorizonSettings {
+    bool enabled;
+};
+
+// Terrain horizon seen from the camera: for every azimuth bin and every
+// whole-unit distance, the steepest slope (rise over run) of the terrain up
+// to that distance. A box whose steepest possible sight line stays under the
+// horizon in front of it is hidden behind the terrain. Boxes no wider than
+// a grid square are held to a height per square, found once per view.
+class HorizonCuller {
+public:
+    // azimuthBins is rounded up to a power of two
+    HorizonCuller(const Terrain& terrain, int azimuthBins = 256);
+
+    // Marches outward from the eye along every bin. Each step reads the
+    // lowest heightfield sample across the whole bin width, so the horizon
+    // stays below the terrain for every ray inside the bin. Then finds the
+    // height each grid square hides. Returns at once if the eye is unchanged.
+    void update(const glm::vec3& eye);
+
+    bool isVisible(const Aabb& box) const;
+
+    // Removes the boxes below the horizon from visible (indices into boxes)
+    // and adds the tested and culled counts to the frame stats
+    void cull(const AabbSoA& boxes, std::vector<uint32_t>& visible) const;
+
+    float updateMilliseconds() const;
+
+private:
+    bool isVisible(float centerX, float centerZ, float radius, float top) const;
+    // Bins a circle of the radius at (dx, dz) from the eye may span
+    void binRange(float dx, float dz, float distance, float radius, int& first, int& last) const;
+    // Lowest horizon across the bins at the ring; -FLT_MAX when they wrap all the way round
+    float lowestHorizon(int ring, int first, int last) const;
+    // Height below which everything in a circle spanning the bins and
+    // distances is hidden; -FLT_MAX when nothing is
+    float hiddenHeight(int first, int last, float nearest, float farthest) const;
+    void updateSquares();
+    void cullRange(const AabbSoA& boxes, const uint32_t* indices, size_t begin, size_t end, uint8_t* result) const;
+
+    const Terrain& terrain;
+    int azimuthBins;
+    int rings;
+    glm::vec3 eye;
+    bool hasHorizon;
+    std::vector<float> horizon; // Per ring: the bins, then each coarser level, ring-major
+    std::vector<glm::vec2> directions; // Centre ray of each bin
+    std::vector<float> squareHeights; // Per grid square, row-major: the height a point in it must reach to be seen
+    std::vector<float> hiddenHeights; // The lowest of squareHeights around each square: boxes centred there stay hidden below it
+    std::vector<std::vector<float>> lowestHeights; // Per level, the lowest height over each square of 2^level units, row-major
+    float updateMs;
+};
+
+namespace Horizon {
+    HorizonSettings& settings();
+
+    // Scatters propCount boxes over the terrain and prints update time, cull
+    // time and cull rate over viewCount random ground-level views
+    void printReport(const Terrain& terrain, int propCount = 100000, int viewCount = 100);
+}
+
+#endif // HORIZON_CULLER_H
@@ -0,0 +1,215 @@
+#include "Impostor.h"
+#include "RenderStats.h"
+#include "GLStateCache.h"
+#include "AssetMemory.h"
+#include "RingBuffer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <gtc/matrix_transform.hpp>
+
+namespace {
+    glm::vec2 signNotZero(const glm::vec2& v) {
+        return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    // Up vector of the bake camera, shared by baking and drawing so the
+    // billboard axes line up with the baked image
+    glm::vec3 bakeUp(const glm::vec3& direction) {
+        return std::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+}
+
+namespace Impostor {
+
+ImpostorSettings& settings() {
+    static ImpostorSettings impostorSettings = { true, 60.0f };
+    return impostorSettings;
+}
+
+glm::vec2 octEncode(const glm::vec3& direction) {
+    glm::vec3 d = direction / (std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z));
+    glm::vec2 p(d.x, d.z);
+    if (d.y < 0.0f)
+        p = (1.0f - glm::abs(glm::vec2(p.y, p.x))) * signNotZero(p);
+    return p;
+}
+
+glm::vec3 octDecode(const glm::vec2& p) {
+    glm::vec3 d(p.x, 1.0f - std::abs(p.x) - std::abs(p.y), p.y);
+    if (d.y < 0.0f) {
+        glm::vec2 xz = (1.0f - glm::abs(glm::vec2(d.z, d.x))) * signNotZero(glm::vec2(d.x, d.z));
+        d.x = xz.x;
+        d.z = xz.y;
+    }
+    return glm::normalize(d);
+}
+
+}
+
+ImpostorAtlas::ImpostorAtlas(int framesPerSide, int frameSize)
+    : framesPerSide(framesPerSide), frameSize(frameSize), bounds(0.0f), atlasTexture(0), VAO(0), quadVBO(0) {}
+
+void ImpostorAtlas::bake(const glm::vec4& bounds, const std::function<void(const glm::mat4& view, const glm::mat4& projection)>& drawProp) {
+    this->bounds = bounds;
+    int atlasSize = framesPerSide * frameSize;
+
+    glGenTextures(1, &atlasTexture);
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 4); // Stop before mips bleed across frames
+
+    GLuint depthBuffer, framebuffer;
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+
+    glGenFramebuffers(1, &framebuffer);
+    GLState::bindFramebuffer(framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlasTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Impostor atlas framebuffer is incomplete" << std::endl;
+    }
+    else {
+        GLint viewport[4];
+        GLfloat clearColor[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+        glm::vec3 center(bounds);
+        float radius = bounds.w;
+        glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, radius * 4.0f);
+
+        GLState::setEnabled(GL_SCISSOR_TEST, true);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        for (int y = 0; y < framesPerSide; y++) {
+            for (int x = 0; x < framesPerSide; x++) {
+                glm::vec2 grid = glm::vec2(x, y) / static_cast<float>(framesPerSide - 1) * 2.0f - 1.0f;
+                glm::vec3 direction = Impostor::octDecode(grid);
+                glm::mat4 view = glm::lookAt(center + direction * radius * 2.0f, center, bakeUp(direction));
+
+                GLState::viewport(x * frameSize, y * frameSize, frameSize, frameSize);
+                glScissor(x * frameSize, y * frameSize, frameSize, frameSize);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                drawProp(view, projection);
+            }
+        }
+        GLState::setEnabled(GL_SCISSOR_TEST, false);
+
+        GLState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    }
+
+    GLState::bindDefaultFramebuffer();
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    // Unit quad shared by every instance, drawn as a triangle strip
+    float quadCorners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &quadVBO);
+
+    GLState::bindVertexArray(VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadCorners), quadCorners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Instances stream from the frame ring through vertex buffer binding 1,
+    // which draw() points at each frame's range
+    glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, offsetof(ImpostorInstance, center));
+    glVertexAttribFormat(2, 3, GL_FLOAT, GL_FALSE, offsetof(ImpostorInstance, right));
+    glVertexAttribFormat(3, 3, GL_FLOAT, GL_FALSE, offsetof(ImpostorInstance, up));
+    glVertexAttribFormat(4, 2, GL_FLOAT, GL_FALSE, offsetof(ImpostorInstance, frame));
+    for (GLuint attribute = 1; attribute <= 4; attribute++) {
+        glVertexAttribBinding(attribute, 1);
+        glEnableVertexAttribArray(attribute);
+    }
+    glVertexBindingDivisor(1, 1);
+    GLState::bindVertexArray(0);
+
+    std::cout << "Baked impostor atlas: " << framesPerSide * framesPerSide << " views, " << atlasSize << "x" << atlasSize << std::endl;
+}
+
+bool ImpostorAtlas::isBaked() const {
+    return atlasTexture != 0;
+}
+
+void ImpostorAtlas::addInstance(const glm::mat4& model, const glm::vec3& cameraPos) {
+    glm::mat3 rotationScale(model);
+    glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f));
+    float scale = std::max(glm::length(rotationScale[0]), std::max(glm::length(rotationScale[1]), glm::length(rotationScale[2])));
+    float radius = bounds.w * scale;
+
+    // View direction in object space picks the baked frames
+    glm::vec3 toCamera = cameraPos - center;
+    glm::vec3 direction = glm::normalize(glm::inverse(rotationScale) * toCamera);
+    glm::vec2 frame = (Impostor::octEncode(direction) * 0.5f + 0.5f) * static_cast<float>(framesPerSide - 1);
+
+    // Billboard axes match the bake camera's, carried into world space
+    glm::vec3 objectRight = glm::normalize(glm::cross(-direction, bakeUp(direction)));
+    glm::vec3 objectUp = glm::cross(objectRight, -direction);
+
+    ImpostorInstance instance;
+    instance.center = center;
+    instance.right = glm::normalize(rotationScale * objectRight) * radius;
+    instance.up = glm::normalize(rotationScale * objectUp) * radius;
+    instance.frame = frame;
+    instances.push_back(instance);
+}
+
+size_t ImpostorAtlas::gpuBytes() const {
+    if (!isBaked())
+        return 0;
+    int atlasSize = framesPerSide * frameSize;
+    return AssetMemory::textureBytes(atlasSize, atlasSize, 4, true) + 8 * sizeof(float);
+}
+
+size_t ImpostorAtlas::instanceCount() const {
+    return instances.size();
+}
+
+void ImpostorAtlas::queue(ShaderProgram& shader, RenderQueue& renderQueue) {
+    if (instances.empty() || !isBaked())
+        return;
+    DrawItem item = { RenderPass::Opaque, &shader, atlasTexture, VAO, 0, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+    item.draw = [this, &shader] { draw(shader); };
+    renderQueue.add(item, instances.front().center);
+}
+
+void ImpostorAtlas::draw(ShaderProgram& shader) {
+    if (instances.empty() || !isBaked())
+        return;
+
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+    shader.setInt("atlas", 0);
+    shader.setFloat("framesPerSide", static_cast<float>(framesPerSide));
+
+    GLsizeiptr bytes = static_cast<GLsizeiptr>(instances.size() * sizeof(ImpostorInstance));
+    RingAllocation range = FrameRing::get().allocate(bytes, sizeof(float));
+    if (!range.data) {
+        instances.clear();
+        return;
+    }
+    std::memcpy(range.data, instances.data(), bytes);
+
+    GLState::bindVertexArray(VAO);
+    glBindVertexBuffer(1, range.buffer, range.offset, sizeof(ImpostorInstance));
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.size()));
+
+    RenderStats::countDraw(6, static_cast<GLsizei>(instances.size()));
+    RenderStats::frame().impostors += static_cast<unsigned int>(instances.size());
+    instances.clear();
+}
@@ -0,0 +1,65 @@
+#pragma once
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <functional>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+
+struct ImpostorSettings {
+    bool enabled;
+    float distance; // Instances farther than this from the camera draw as impostors
+};
+
+// Per-instance billboard: world centre, half-size axes facing the camera and
+// the continuous position in the octahedral frame grid
+struct ImpostorInstance {
+    glm::vec3 center;
+    glm::vec3 right;
+    glm::vec3 up;
+    glm::vec2 frame;
+};
+
+// Octahedral impostor: a prop baked from framesPerSide x framesPerSide view
+// directions covering the whole sphere into one atlas texture
+class ImpostorAtlas {
+public:
+    ImpostorAtlas(int framesPerSide = 8, int frameSize = 128);
+
+    // Renders the prop into the atlas through an offscreen FBO. drawProp must
+    // draw the prop in object space with the given view and projection.
+    void bake(const glm::vec4& bounds, const std::function<void(const glm::mat4& view, const glm::mat4& projection)>& drawProp);
+    bool isBaked() const;
+    size_t gpuBytes() const;
+
+    void addInstance(const glm::mat4& model, const glm::vec3& cameraPos);
+    size_t instanceCount() const;
+
+    // Draws all queued instances with one instanced call and clears the queue.
+    // The impostor program must be bound with view and projection set.
+    void draw(ShaderProgram& shader);
+
+    // Adds one render queue item that draws the instances queued by then
+    void queue(ShaderProgram& shader, RenderQueue& renderQueue);
+
+private:
+    int framesPerSide;
+    int frameSize;
+    glm::vec4 bounds;
+    GLuint atlasTexture;
+    GLuint VAO, quadVBO;
+    std::vector<ImpostorInstance> instances;
+};
+
+namespace Impostor {
+    ImpostorSettings& settings();
+
+    // Octahedral mapping between unit directions (Y is the pole) and [-1, 1]^2
+    glm::vec2 octEncode(const glm::vec3& direction);
+    glm::vec3 octDecode(const glm::vec2& p);
+}
+
+#endif // IMPOSTOR_H
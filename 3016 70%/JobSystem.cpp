@@ -0,0 +1,148 @@
+#include "JobSystem.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct Job {
+        const std::function<void(size_t, size_t)>* body;
+        size_t count;
+        size_t batchSize;
+        std::atomic<size_t> nextBatch;
+        std::atomic<size_t> batchesDone;
+        size_t batchCount;
+        int workersInside; // Workers holding a pointer to the job, guarded by mutex
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    std::vector<Job*> jobs; // Loops of every calling thread, guarded by mutex
+    bool stopping = false;
+
+    // SSE width of the grouped loops; below the threshold a single thread
+    // beats waking the workers
+    const size_t kGroupSize = 4;
+    const size_t kGroupParallelThreshold = 8192;
+
+    // First loop that still has unclaimed batches, or null
+    Job* findWork() {
+        for (Job* job : jobs)
+            if (job->nextBatch.load() < job->batchCount)
+                return job;
+        return nullptr;
+    }
+
+    // Claims batches until none are left; returns once the job has no more work
+    void runBatches(Job& job) {
+        for (;;) {
+            size_t batch = job.nextBatch.fetch_add(1);
+            if (batch >= job.batchCount)
+                return;
+            size_t begin = batch * job.batchSize;
+            size_t end = std::min(begin + job.batchSize, job.count);
+            (*job.body)(begin, end);
+            if (job.batchesDone.fetch_add(1) + 1 == job.batchCount) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    void workerLoop() {
+        for (;;) {
+            Job* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || (job = findWork()) != nullptr; });
+                if (stopping)
+                    return;
+                job->workersInside++;
+            }
+            runBatches(*job);
+
+            // The job lives on the caller's stack, which waits for this
+            std::lock_guard<std::mutex> lock(mutex);
+            job->workersInside--;
+            finished.notify_all();
+        }
+    }
+
+    void startWorkers() {
+        if (!workers.empty())
+            return;
+        unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+        // The calling thread is one of the participants
+        for (unsigned int i = 1; i < hardware; i++)
+            workers.emplace_back(workerLoop);
+    }
+}
+
+namespace JobSystem {
+
+unsigned int threadCount() {
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void parallelFor(size_t count, size_t minBatch, const std::function<void(size_t begin, size_t end)>& body) {
+    if (count == 0)
+        return;
+    minBatch = std::max<size_t>(minBatch, 1);
+    if (count <= minBatch || threadCount() == 1) {
+        body(0, count);
+        return;
+    }
+
+    startWorkers();
+
+    // A few batches per thread so uneven batches still balance
+    size_t batchSize = std::max(minBatch, (count + threadCount() * 4 - 1) / (threadCount() * 4));
+    Job job;
+    job.body = &body;
+    job.count = count;
+    job.batchSize = batchSize;
+    job.nextBatch = 0;
+    job.batchesDone = 0;
+    job.batchCount = (count + batchSize - 1) / batchSize;
+    job.workersInside = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(&job);
+    }
+    wake.notify_all();
+
+    runBatches(job);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return job.batchesDone.load() == job.batchCount && job.workersInside == 0; });
+    jobs.erase(std::find(jobs.begin(), jobs.end(), &job));
+}
+
+void parallelForGroups(size_t count, const std::function<void(size_t begin, size_t end)>& body) {
+    if (count < kGroupParallelThreshold) {
+        body(0, count);
+        return;
+    }
+    parallelFor((count + kGroupSize - 1) / kGroupSize, 1024, [&](size_t begin, size_t end) {
+        body(begin * kGroupSize, std::min(end * kGroupSize, count));
+    });
+}
+
+void shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+    stopping = false;
+}
+
+}
@@ -0,0 +1,28 @@
+#pragma once
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <cstddef>
+#include <functional>
+
+// Persistent worker threads for data-parallel loops. Workers sleep between
+// calls, so there is no thread start-up cost per frame. Several threads may
+// run loops at once; the workers help whichever still has batches left.
+namespace JobSystem {
+    // Number of threads taking part in parallelFor, including the caller
+    unsigned int threadCount();
+
+    // Calls body(begin, end) over [0, count) in batches of at least minBatch
+    // items. The caller works too and returns when every batch is done.
+    // Runs inline when the range fits one batch.
+    void parallelFor(size_t count, size_t minBatch, const std::function<void(size_t begin, size_t end)>& body);
+
+    // parallelFor for loops that step through four-wide SIMD groups: every
+    // range but the last starts and ends on a group boundary. Counts too
+    // small to repay waking the workers run inline.
+    void parallelForGroups(size_t count, const std::function<void(size_t begin, size_t end)>& body);
+
+    void shutdown();
+}
+
+#endif // JOB_SYSTEM_H
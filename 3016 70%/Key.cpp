@@ -1,22 +1,34 @@
 #include "Key.h"
+#include "MeshOptimizer.h"
+#include "PropLod.h"
+#include "RenderStats.h"
+#include "GLStateCache.h"
+#include "FrameUniforms.h"
+#include "AssetMemory.h"
+#include "AssetIOSystem.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
+#include <cfloat>
 #include <iostream>
 
-Key::Key(const std::string& modelPath) {
+Key::Key(const std::string& modelPath)
+    : aabb{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) }, depthVAO(0), positionVBO(0) {
     loadModel(modelPath);
 }
 
 void Key::loadModel(const std::string& path) {
+    // The importer only lives for the load; the scene is freed once the mesh is on the GPU
     Assimp::Importer importer;
-    keyScene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-    if (!keyScene || keyScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !keyScene->mRootNode) {
+    const aiScene* scene = AssetIO::readScene(importer, path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace | aiProcess_GenBoundingBoxes);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cerr << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
         return;
     }
-    processNode(keyScene->mRootNode, keyScene);
+    processNode(scene->mRootNode, scene);
+    importer.FreeScene();
+    uploadMesh(path);
 }
 
 void Key::processNode(aiNode* node, const aiScene* scene) {
@@ -30,6 +42,11 @@ void Key::processNode(aiNode* node, const aiScene* scene) {
 }
 
 void Key::processMesh(aiMesh* mesh, const aiScene* scene) {
+    // Meshes are merged into one buffer, so indices are offset past earlier meshes
+    unsigned int baseVertex = static_cast<unsigned int>(vertices.size() / 6);
+    aabb = FrustumCuller::merge(aabb, { glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z),
+                                        glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z) });
+
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
         aiVector3D pos = mesh->mVertices[i];
         aiVector3D normal = mesh->mNormals[i];
@@ -43,23 +60,39 @@ void Key::processMesh(aiMesh* mesh, const aiScene* scene) {
         vertices.push_back(normal.z);
     }
 
+    // Points and lines survive triangulation; only triangles are drawn
     for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
+        if (face.mNumIndices != 3)
+            continue;
         for (unsigned int j = 0; j < face.mNumIndices; j++) {
-            indices.push_back(face.mIndices[j]);
+            indices.push_back(baseVertex + face.mIndices[j]);
         }
     }
+}
+
+void Key::uploadMesh(const std::string& name) {
+    // Weld, reorder for the vertex cache and overdraw, then remap for fetch
+    MeshData data;
+    data.stride = 6;
+    data.vertices.swap(vertices);
+    data.indices.swap(indices);
+    MeshOptimizer::optimize(data, name);
+    bounds = PropLod::computeBoundingSphere(data.vertices, data.stride);
+    lods = MeshSimplifier::buildLodChain(data);
+    vertices.swap(data.vertices);
+    indices.swap(data.indices);
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    GLState::bindVertexArray(VAO);
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
@@ -67,29 +100,85 @@ void Key::processMesh(aiMesh* mesh, const aiScene* scene) {
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
-}
+    GLState::bindVertexArray(0);
 
-void Key::render(const glm::mat4& view, const glm::mat4& projection, GLuint shaderProgram) {
-    glUseProgram(shaderProgram);
+    size_t vertexCount = vertices.size() / data.stride;
+    depthVAO = DepthPrepass::createVertexArray(vertices.data(), vertexCount, data.stride * sizeof(float), EBO, positionVBO);
 
-    GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLuint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    GLuint projLoc = glGetUniformLocation(shaderProgram, "projection");
+    // The buffers hold the only copy from here on
+    AssetMemory::track(MemorySubsystem::Keys, name, lods.capacity() * sizeof(LodLevel),
+        vertices.size() * sizeof(float) + indices.size() * sizeof(unsigned int) + vertexCount * 3 * sizeof(float));
+    std::vector<float>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+}
 
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+void Key::cull(const ViewCull& viewCull, std::vector<uint32_t>& visible) const {
+    Visibility::cull(viewCull, instanceBounds, visible);
+}
 
-    glBindVertexArray(VAO);
+void Key::queue(const glm::mat4& view, const glm::mat4& projection, ShaderProgram& shader, const std::vector<uint32_t>& visible, RenderQueue& renderQueue) {
+    // View and projection come from the frame uniform buffer
+    DrawItem item = { RenderPass::Opaque, &shader, 0, VAO, depthVAO, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+
+    bool lodEnabled = PropLod::settings().enabled;
+    const ImpostorSettings& impostorSettings = Impostor::settings();
+    bool useImpostors = impostorSettings.enabled && impostor.isBaked();
+    glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+
+    for (auto index : visible) {
+        const glm::mat4& transform = keyTransforms[index];
+        if (useImpostors) {
+            glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(bounds), 1.0f));
+            if (glm::length(center - cameraPos) > impostorSettings.distance) {
+                impostor.addInstance(transform, cameraPos);
+                continue;
+            }
+        }
 
-    for (const auto& transform : keyTransforms) {
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(transform));
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        LodChoice choice = { 0, -1, 1.0f };
+        if (lodEnabled) {
+            float screenSize = PropLod::projectedScreenSize(bounds, transform, view, projection);
+            choice = PropLod::selectLod(screenSize, static_cast<int>(lods.size()));
+            if (choice.level < 0) {
+                RenderStats::frame().lodCulled++;
+                continue;
+            }
+        }
+        item.model = transform;
+        PropLod::queueLod(choice, lods, item, glm::vec3(transform * glm::vec4(glm::vec3(bounds), 1.0f)), renderQueue);
     }
-
-    glBindVertexArray(0);
 }
 
 void Key::addKeyTransform(const glm::mat4& transform) {
     keyTransforms.push_back(transform);
+    instanceBounds.add(FrustumCuller::transform(aabb, transform));
+}
+
+void Key::bakeImpostor(ShaderProgram& shader) {
+    if (lods.empty())
+        return;
+
+    shader.use();
+    shader.setMat4("model", glm::mat4(1.0f));
+    shader.setVec2("lodFade", glm::vec2(0.0f));
+
+    impostor.bake(bounds, [&](const glm::mat4& view, const glm::mat4& projection) {
+        FrameUniforms::setCamera(view, projection, glm::vec3(glm::inverse(view)[3]));
+        FrameUniforms::upload();
+        GLState::bindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, lods[0].indexCount, GL_UNSIGNED_INT, 0);
+        GLState::bindVertexArray(0);
+    });
+    AssetMemory::track(MemorySubsystem::Textures, "key impostor atlas", 0, impostor.gpuBytes());
+}
+
+void Key::addShadowCasters(CascadedShadowMap& shadowMap) const {
+    if (lods.empty())
+        return;
+    for (const auto& transform : keyTransforms)
+        shadowMap.addCaster({ depthVAO, lods[0].indexOffset, lods[0].indexCount, transform, FrustumCuller::transform(aabb, transform) });
+}
+
+void Key::queueImpostors(ShaderProgram& impostorShader, RenderQueue& renderQueue) {
+    impostor.queue(impostorShader, renderQueue);
 }
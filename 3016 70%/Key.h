@@ -6,23 +6,44 @@
 #include <string>
 #include <assimp/scene.h>
 #include <glew.h>
+#include "MeshSimplifier.h"
+#include "Impostor.h"
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+#include "Visibility.h"
+#include "ShadowMap.h"
 
 class Key {
 public:
     Key(const std::string& modelPath);
-    void render(const glm::mat4& view, const glm::mat4& projection, GLuint shaderProgram);
+
+    // Fills the indices of the keys that pass the view culling. Issues no GL
+    // calls, so it may run off the render thread.
+    void cull(const ViewCull& viewCull, std::vector<uint32_t>& visible) const;
+    void queue(const glm::mat4& view, const glm::mat4& projection, ShaderProgram& shader, const std::vector<uint32_t>& visible, RenderQueue& renderQueue);
     void addKeyTransform(const glm::mat4& transform);
+    void bakeImpostor(ShaderProgram& shader);
+    void queueImpostors(ShaderProgram& impostorShader, RenderQueue& renderQueue);
+
+    // Registers every key at full detail as a static shadow caster
+    void addShadowCasters(CascadedShadowMap& shadowMap) const;
 
 private:
     void loadModel(const std::string& path);
     void processNode(aiNode* node, const aiScene* scene);
     void processMesh(aiMesh* mesh, const aiScene* scene);
+    void uploadMesh(const std::string& name);
 
     std::vector<glm::mat4> keyTransforms;
-    const aiScene* keyScene;
     std::vector<float> vertices;
     std::vector<unsigned int> indices;
+    std::vector<LodLevel> lods;
+    glm::vec4 bounds; // Object-space bounding sphere
+    Aabb aabb;        // Object-space box from the importer
+    AabbSoA instanceBounds; // World boxes, one per key transform
+    ImpostorAtlas impostor;
     GLuint VAO, VBO, EBO;
+    GLuint depthVAO, positionVBO; // Position-only stream for the depth pre-pass
 };
 
 #endif // KEY_H
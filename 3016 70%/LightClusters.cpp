@@ -0,0 +1,457 @@
+#include "LightClusters.h"
+#include "GLStateCache.h"
+#include "JobSystem.h"
+#include "RenderStats.h"
+#include "RingBuffer.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <gtc/constants.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define LIGHT_CLUSTERS_SSE 1
+#endif
+
+namespace {
+    // Depth where the exponential slices start; anything closer is slice 0
+    const float kClusterNear = 1.0f;
+
+    // Pairs keep the light index in 16 bits
+    const size_t kMaxLights = 65536;
+
+    // A quarter of a frame ring region
+    const size_t kMaxLightIndices = 65536;
+
+    bool sphereTouchesBox(const Aabb& box, float x, float y, float z, float radius) {
+        float dx = std::max(std::max(box.min.x - x, 0.0f), x - box.max.x);
+        float dy = std::max(std::max(box.min.y - y, 0.0f), y - box.max.y);
+        float dz = std::max(std::max(box.min.z - z, 0.0f), z - box.max.z);
+        return dx * dx + dy * dy + dz * dz <= radius * radius;
+    }
+
+    int16_t tileOf(float ndc, int tiles) {
+        float t = (ndc * 0.5f + 0.5f) * tiles;
+        return static_cast<int16_t>(std::min(std::max(t, 0.0f), tiles - 1.0f));
+    }
+
+    const LightClusterRange kEmptyRange = { 0, -1, 0, -1, 1, 0 };
+}
+
+LightClusters::LightClusters(int tilesX, int tilesY, int slices)
+    : tilesX(tilesX), tilesY(tilesY), slices(slices), boundsProjection(0.0f), boundsNear(0.0f), boundsFar(0.0f),
+      sliceScale(0.0f), sliceBias(0.0f), nearPlane(0.1f), farPlane(1.0f), screen(1.0f),
+      slicePairs(slices), sliceIndices(slices), clusterRanges(static_cast<size_t>(tilesX) * tilesY * slices) {}
+
+// Boxes depend only on the projection, so they are rebuilt when it changes
+void LightClusters::updateClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane) {
+    if (projection == boundsProjection && nearPlane == boundsNear && farPlane == boundsFar)
+        return;
+    boundsProjection = projection;
+    boundsNear = nearPlane;
+    boundsFar = farPlane;
+
+    sliceScale = slices / std::log(farPlane / kClusterNear);
+    sliceBias = -std::log(kClusterNear) * sliceScale;
+
+    bounds.resize(clusterCount());
+    for (int s = 0; s < slices; s++) {
+        float sliceNear = s == 0 ? nearPlane : std::exp((s - sliceBias) / sliceScale);
+        float sliceFar = s == slices - 1 ? farPlane : std::exp((s + 1 - sliceBias) / sliceScale);
+        for (int y = 0; y < tilesY; y++) {
+            for (int x = 0; x < tilesX; x++) {
+                Aabb box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+                for (int corner = 0; corner < 8; corner++) {
+                    float ndcX = -1.0f + 2.0f * (x + (corner & 1)) / tilesX;
+                    float ndcY = -1.0f + 2.0f * (y + ((corner >> 1) & 1)) / tilesY;
+                    float depth = (corner & 4) ? sliceFar : sliceNear;
+                    glm::vec3 point(ndcX / projection[0][0] * depth, ndcY / projection[1][1] * depth, -depth);
+                    box.min = glm::min(box.min, point);
+                    box.max = glm::max(box.max, point);
+                }
+                bounds[(static_cast<size_t>(s) * tilesY + y) * tilesX + x] = box;
+            }
+        }
+    }
+}
+
+int LightClusters::sliceOf(float depth) const {
+    int slice = static_cast<int>(std::floor(std::log(depth) * sliceScale + sliceBias));
+    return std::min(std::max(slice, 0), slices - 1);
+}
+
+// View-space centre, then the tiles the sphere's view-space box can project
+// to: x / depth is extreme at the box's near or far face
+void LightClusters::computeRangesScalar(const std::vector<PointLight>& lights, const glm::mat4& view, size_t begin) {
+    float p00 = boundsProjection[0][0], p11 = boundsProjection[1][1];
+    for (size_t i = begin; i < lightClusterRanges.size(); i++) {
+        const PointLight& light = lights[i];
+        float x = view[0][0] * light.position.x + view[1][0] * light.position.y + view[2][0] * light.position.z + view[3][0];
+        float y = view[0][1] * light.position.x + view[1][1] * light.position.y + view[2][1] * light.position.z + view[3][1];
+        float z = view[0][2] * light.position.x + view[1][2] * light.position.y + view[2][2] * light.position.z + view[3][2];
+        viewX[i] = x;
+        viewY[i] = y;
+        viewZ[i] = z;
+
+        float r = light.radius;
+        float zMin = -z - r, zMax = -z + r;
+        float dMin = std::max(zMin, nearPlane), dMax = std::max(zMax, nearPlane);
+        float xHi = std::max((x + r) / dMin, (x + r) / dMax) * p00;
+        float xLo = std::min((x - r) / dMin, (x - r) / dMax) * p00;
+        float yHi = std::max((y + r) / dMin, (y + r) / dMax) * p11;
+        float yLo = std::min((y - r) / dMin, (y - r) / dMax) * p11;
+
+        if (zMax < nearPlane || zMin > farPlane || xHi < -1.0f || xLo > 1.0f || yHi < -1.0f || yLo > 1.0f) {
+            lightClusterRanges[i] = kEmptyRange;
+            continue;
+        }
+        lightClusterRanges[i] = { tileOf(xLo, tilesX), tileOf(xHi, tilesX), tileOf(yLo, tilesY), tileOf(yHi, tilesY),
+            static_cast<int16_t>(sliceOf(dMin)), static_cast<int16_t>(sliceOf(std::min(zMax, farPlane))) };
+    }
+}
+
+// Same arithmetic in the same order as the scalar path, four lights per
+// register, so both produce identical ranges
+void LightClusters::computeRangesSimd(const std::vector<PointLight>& lights, const glm::mat4& view) {
+    size_t count = lightClusterRanges.size();
+    size_t i = 0;
+#ifdef LIGHT_CLUSTERS_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minusOne = _mm_set1_ps(-1.0f);
+    const __m128 nearV = _mm_set1_ps(nearPlane);
+    const __m128 farV = _mm_set1_ps(farPlane);
+    const __m128 p00 = _mm_set1_ps(boundsProjection[0][0]);
+    const __m128 p11 = _mm_set1_ps(boundsProjection[1][1]);
+    const __m128 tilesXV = _mm_set1_ps(static_cast<float>(tilesX));
+    const __m128 tilesYV = _mm_set1_ps(static_cast<float>(tilesY));
+    const __m128 lastTileX = _mm_set1_ps(tilesX - 1.0f);
+    const __m128 lastTileY = _mm_set1_ps(tilesY - 1.0f);
+    __m128 m[4][3];
+    for (int column = 0; column < 4; column++) {
+        for (int row = 0; row < 3; row++)
+            m[column][row] = _mm_set1_ps(view[column][row]);
+    }
+
+    alignas(16) float xs[4], ys[4], zs[4], lowX[4], highX[4], lowY[4], highY[4], nearDepth[4], farDepth[4];
+    for (; i + 4 <= count; i += 4) {
+        const PointLight* l = &lights[i];
+        __m128 px = _mm_set_ps(l[3].position.x, l[2].position.x, l[1].position.x, l[0].position.x);
+        __m128 py = _mm_set_ps(l[3].position.y, l[2].position.y, l[1].position.y, l[0].position.y);
+        __m128 pz = _mm_set_ps(l[3].position.z, l[2].position.z, l[1].position.z, l[0].position.z);
+        __m128 r = _mm_set_ps(l[3].radius, l[2].radius, l[1].radius, l[0].radius);
+
+        __m128 v[3];
+        for (int row = 0; row < 3; row++) {
+            v[row] = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0][row], px), _mm_mul_ps(m[1][row], py)),
+                _mm_mul_ps(m[2][row], pz)), m[3][row]);
+        }
+        _mm_store_ps(xs, v[0]);
+        _mm_store_ps(ys, v[1]);
+        _mm_store_ps(zs, v[2]);
+
+        __m128 depth = _mm_sub_ps(zero, v[2]);
+        __m128 zMin = _mm_sub_ps(depth, r);
+        __m128 zMax = _mm_add_ps(depth, r);
+        __m128 dMin = _mm_max_ps(zMin, nearV);
+        __m128 dMax = _mm_max_ps(zMax, nearV);
+
+        __m128 xPlus = _mm_add_ps(v[0], r), xMinus = _mm_sub_ps(v[0], r);
+        __m128 yPlus = _mm_add_ps(v[1], r), yMinus = _mm_sub_ps(v[1], r);
+        __m128 xHi = _mm_mul_ps(_mm_max_ps(_mm_div_ps(xPlus, dMin), _mm_div_ps(xPlus, dMax)), p00);
+        __m128 xLo = _mm_mul_ps(_mm_min_ps(_mm_div_ps(xMinus, dMin), _mm_div_ps(xMinus, dMax)), p00);
+        __m128 yHi = _mm_mul_ps(_mm_max_ps(_mm_div_ps(yPlus, dMin), _mm_div_ps(yPlus, dMax)), p11);
+        __m128 yLo = _mm_mul_ps(_mm_min_ps(_mm_div_ps(yMinus, dMin), _mm_div_ps(yMinus, dMax)), p11);
+
+        __m128 culled = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(zMax, nearV), _mm_cmpgt_ps(zMin, farV)),
+            _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(xHi, minusOne), _mm_cmpgt_ps(xLo, one)),
+                _mm_or_ps(_mm_cmplt_ps(yHi, minusOne), _mm_cmpgt_ps(yLo, one))));
+        int culledMask = _mm_movemask_ps(culled);
+
+        auto toTile = [&](__m128 ndc, __m128 tiles, __m128 lastTile, float* out) {
+            __m128 t = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ndc, half), half), tiles);
+            _mm_store_ps(out, _mm_min_ps(_mm_max_ps(t, zero), lastTile));
+        };
+        toTile(xLo, tilesXV, lastTileX, lowX);
+        toTile(xHi, tilesXV, lastTileX, highX);
+        toTile(yLo, tilesYV, lastTileY, lowY);
+        toTile(yHi, tilesYV, lastTileY, highY);
+        _mm_store_ps(nearDepth, dMin);
+        _mm_store_ps(farDepth, _mm_min_ps(zMax, farV));
+
+        for (int lane = 0; lane < 4; lane++) {
+            viewX[i + lane] = xs[lane];
+            viewY[i + lane] = ys[lane];
+            viewZ[i + lane] = zs[lane];
+            if (culledMask & (1 << lane)) {
+                lightClusterRanges[i + lane] = kEmptyRange;
+                continue;
+            }
+            // No vector logarithm, so the slices are found per lane
+            lightClusterRanges[i + lane] = { static_cast<int16_t>(lowX[lane]), static_cast<int16_t>(highX[lane]),
+                static_cast<int16_t>(lowY[lane]), static_cast<int16_t>(highY[lane]),
+                static_cast<int16_t>(sliceOf(nearDepth[lane])), static_cast<int16_t>(sliceOf(farDepth[lane])) };
+        }
+    }
+#endif
+    computeRangesScalar(lights, view, i);
+}
+
+// Every slice is written by one job only: its lights are found tile by
+// tile, then grouped per tile with a counting sort that keeps light order
+void LightClusters::binSlice(int slice, const std::vector<PointLight>& lights) {
+    static thread_local std::vector<uint32_t> fill;
+    size_t tiles = static_cast<size_t>(tilesX) * tilesY;
+    std::vector<uint32_t>& pairs = slicePairs[slice];
+    pairs.clear();
+
+    for (size_t i = 0; i < lightClusterRanges.size(); i++) {
+        const LightClusterRange& range = lightClusterRanges[i];
+        if (slice < range.z0 || slice > range.z1)
+            continue;
+        for (int y = range.y0; y <= range.y1; y++) {
+            for (int x = range.x0; x <= range.x1; x++) {
+                size_t tile = static_cast<size_t>(y) * tilesX + x;
+                if (sphereTouchesBox(bounds[slice * tiles + tile], viewX[i], viewY[i], viewZ[i], lights[i].radius))
+                    pairs.push_back(static_cast<uint32_t>(tile << 16 | i));
+            }
+        }
+    }
+
+    glm::uvec2* out = &clusterRanges[slice * tiles];
+    for (size_t tile = 0; tile < tiles; tile++)
+        out[tile] = glm::uvec2(0);
+    for (auto pair : pairs)
+        out[pair >> 16].y++;
+    uint32_t offset = 0;
+    fill.resize(tiles);
+    for (size_t tile = 0; tile < tiles; tile++) {
+        out[tile].x = offset;
+        fill[tile] = offset;
+        offset += out[tile].y;
+    }
+
+    std::vector<uint32_t>& grouped = sliceIndices[slice];
+    grouped.resize(pairs.size());
+    for (auto pair : pairs)
+        grouped[fill[pair >> 16]++] = pair & 0xffff;
+}
+
+void LightClusters::build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+    float nearPlane, float farPlane, int viewportWidth, int viewportHeight, bool useSimd, bool useThreads) {
+    auto start = std::chrono::steady_clock::now();
+    this->nearPlane = nearPlane;
+    this->farPlane = farPlane;
+    updateClusterBounds(projection, nearPlane, farPlane);
+    screen = glm::vec4(viewportWidth, viewportHeight, 1.0f / viewportWidth, 1.0f / viewportHeight);
+
+    size_t count = std::min(lights.size(), kMaxLights);
+    viewX.resize(count);
+    viewY.resize(count);
+    viewZ.resize(count);
+    lightClusterRanges.resize(count);
+    if (useSimd)
+        computeRangesSimd(lights, view);
+    else
+        computeRangesScalar(lights, view, 0);
+
+    if (useThreads) {
+        JobSystem::parallelFor(static_cast<size_t>(slices), 1, [&](size_t begin, size_t end) {
+            for (size_t slice = begin; slice < end; slice++)
+                binSlice(static_cast<int>(slice), lights);
+        });
+    }
+    else {
+        for (int slice = 0; slice < slices; slice++)
+            binSlice(slice, lights);
+    }
+
+    // Slices are concatenated in order; past the cap the remaining clusters lose lights
+    size_t tiles = static_cast<size_t>(tilesX) * tilesY;
+    size_t total = 0;
+    for (const auto& grouped : sliceIndices)
+        total += grouped.size();
+    static bool warned = false;
+    if (total > kMaxLightIndices && !warned) {
+        warned = true;
+        std::cerr << "Light clusters need " << total << " indices, keeping " << kMaxLightIndices << std::endl;
+    }
+    lightIndices.resize(std::min(total, kMaxLightIndices));
+
+    uint32_t base = 0;
+    for (int slice = 0; slice < slices; slice++) {
+        const std::vector<uint32_t>& grouped = sliceIndices[slice];
+        uint32_t kept = static_cast<uint32_t>(std::min(grouped.size(), lightIndices.size() - base));
+        if (kept)
+            std::memcpy(&lightIndices[base], grouped.data(), kept * sizeof(uint32_t));
+        for (size_t tile = 0; tile < tiles; tile++) {
+            glm::uvec2& range = clusterRanges[slice * tiles + tile];
+            range.y = std::min(range.y, kept > range.x ? kept - range.x : 0u);
+            range.x += base;
+        }
+        base += kept;
+    }
+
+    FrameStats& stats = RenderStats::frame();
+    for (const auto& range : lightClusterRanges)
+        stats.clusterLights += range.z0 <= range.z1 ? 1 : 0;
+    stats.clusterLightIndices += static_cast<unsigned int>(lightIndices.size());
+    stats.clusterBinMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LightClusters::upload(const std::vector<PointLight>& lights) {
+    size_t count = Clusters::settings().enabled ? lightClusterRanges.size() : 0;
+    ClusterUniformData data = {
+        glm::uvec4(tilesX, tilesY, slices, static_cast<unsigned int>(count)),
+        glm::vec4(sliceScale, sliceBias, 0.0f, 0.0f),
+        screen
+    };
+
+    RingAllocation block = FrameRing::get().allocate(sizeof(ClusterUniformData), FrameRing::uniformAlignment());
+    if (!block.data)
+        return;
+    std::memcpy(block.data, &data, sizeof(ClusterUniformData));
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, kClusterUniformBinding, block.buffer, block.offset, block.size);
+
+    // Empty storage blocks are still bound with a minimal range
+    auto stream = [](GLuint binding, const void* source, size_t bytes) {
+        RingAllocation storage = FrameRing::get().allocate(std::max<GLsizeiptr>(bytes, 16), FrameRing::storageAlignment());
+        if (!storage.data)
+            return;
+        if (bytes)
+            std::memcpy(storage.data, source, bytes);
+        GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, storage.buffer, storage.offset, storage.size);
+    };
+    stream(kLightStorageBinding, lights.data(), count * sizeof(PointLight));
+    stream(kClusterStorageBinding, clusterRanges.data(), count ? clusterRanges.size() * sizeof(glm::uvec2) : 0);
+    stream(kLightIndexStorageBinding, lightIndices.data(), count ? lightIndices.size() * sizeof(uint32_t) : 0);
+}
+
+const std::vector<glm::uvec2>& LightClusters::ranges() const {
+    return clusterRanges;
+}
+
+const std::vector<uint32_t>& LightClusters::indices() const {
+    return lightIndices;
+}
+
+const std::vector<LightClusterRange>& LightClusters::lightRanges() const {
+    return lightClusterRanges;
+}
+
+const Aabb& LightClusters::clusterBounds(int x, int y, int slice) const {
+    return bounds[(static_cast<size_t>(slice) * tilesY + y) * tilesX + x];
+}
+
+size_t LightClusters::clusterCount() const {
+    return static_cast<size_t>(tilesX) * tilesY * slices;
+}
+
+namespace Clusters {
+
+ClusterSettings& settings() {
+    static ClusterSettings clusterSettings = { true };
+    return clusterSettings;
+}
+
+void printReport(int lightCount, int viewCount) {
+    const int tilesX = 16, tilesY = 9, slices = 24;
+    const int kSamplesPerView = 2000;
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(0.0f, 100.0f);
+    std::uniform_real_distribution<float> height(0.0f, 20.0f);
+    std::uniform_real_distribution<float> radius(2.0f, 12.0f);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::uniform_int_distribution<int> tileX(0, tilesX - 1), tileY(0, tilesY - 1), slice(0, slices - 1);
+
+    std::vector<PointLight> lights(lightCount);
+    for (auto& light : lights)
+        light = { glm::vec3(position(random), height(random), position(random)), radius(random), glm::vec3(1.0f), 1.0f };
+
+    float nearPlane = 0.1f, farPlane = 500.0f;
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, nearPlane, farPlane);
+    LightClusters fast(tilesX, tilesY, slices), simd(tilesX, tilesY, slices), scalar(tilesX, tilesY, slices);
+
+    double fastMs = 0.0, simdMs = 0.0, scalarMs = 0.0;
+    size_t rangeMismatches = 0, listMismatches = 0, missed = 0, extra = 0, indices = 0;
+    std::vector<uint8_t> listed(lights.size());
+    std::vector<glm::vec3> centers(lights.size());
+    for (int v = 0; v < viewCount; v++) {
+        float x = position(random), z = position(random), yaw = angle(random);
+        glm::vec3 eye(x, 5.0f, z);
+        glm::mat4 view = glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), -0.2f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        auto time = [&](LightClusters& clusters, bool useSimd, bool useThreads) {
+            auto start = std::chrono::steady_clock::now();
+            clusters.build(lights, view, projection, nearPlane, farPlane, 800, 600, useSimd, useThreads);
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        };
+        fastMs += time(fast, true, true);
+        simdMs += time(simd, true, false);
+        scalarMs += time(scalar, false, false);
+        indices += fast.indices().size();
+
+        for (size_t i = 0; i < lights.size(); i++) {
+            const LightClusterRange& a = fast.lightRanges()[i];
+            const LightClusterRange& b = scalar.lightRanges()[i];
+            bool aEmpty = a.z0 > a.z1, bEmpty = b.z0 > b.z1;
+            if (aEmpty != bEmpty || (!aEmpty && std::memcmp(&a, &b, sizeof(LightClusterRange)) != 0))
+                rangeMismatches++;
+        }
+        if (fast.ranges() != scalar.ranges() || fast.indices() != scalar.indices() || simd.indices() != scalar.indices())
+            listMismatches++;
+
+        // Brute force over points sampled inside random clusters: every light
+        // reaching a point must be in its cluster's list
+        for (size_t i = 0; i < lights.size(); i++)
+            centers[i] = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+        for (int sample = 0; sample < kSamplesPerView; sample++) {
+            int tx = tileX(random), ty = tileY(random), s = slice(random);
+            const Aabb& box = fast.clusterBounds(tx, ty, s);
+            float depth = glm::mix(-box.max.z, -box.min.z, unit(random));
+            float ndcX = -1.0f + 2.0f * (tx + unit(random)) / tilesX;
+            float ndcY = -1.0f + 2.0f * (ty + unit(random)) / tilesY;
+            glm::vec3 point(ndcX / projection[0][0] * depth, ndcY / projection[1][1] * depth, -depth);
+
+            glm::uvec2 range = fast.ranges()[(static_cast<size_t>(s) * tilesY + ty) * tilesX + tx];
+            std::fill(listed.begin(), listed.end(), 0);
+            for (unsigned int k = 0; k < range.y; k++)
+                listed[fast.indices()[range.x + k]] = 1;
+            for (size_t i = 0; i < lights.size(); i++) {
+                glm::vec3 offset = point - centers[i];
+                if (glm::dot(offset, offset) <= lights[i].radius * lights[i].radius && !listed[i])
+                    missed++;
+            }
+        }
+
+        // Listed lights must at least touch their cluster's box
+        for (size_t cluster = 0; cluster < fast.clusterCount(); cluster++) {
+            int tx = static_cast<int>(cluster % tilesX), ty = static_cast<int>(cluster / tilesX % tilesY);
+            const Aabb& box = fast.clusterBounds(tx, ty, static_cast<int>(cluster / (tilesX * tilesY)));
+            glm::uvec2 range = fast.ranges()[cluster];
+            for (unsigned int k = 0; k < range.y; k++) {
+                uint32_t light = fast.indices()[range.x + k];
+                glm::vec3 closest = glm::clamp(centers[light], box.min, box.max);
+                glm::vec3 offset = closest - centers[light];
+                if (glm::dot(offset, offset) > lights[light].radius * lights[light].radius)
+                    extra++;
+            }
+        }
+    }
+
+    std::cout << "Light cluster report: " << lightCount << " lights, " << tilesX << "x" << tilesY << "x" << slices
+        << " clusters, " << viewCount << " views, " << indices / viewCount << " indices per view" << std::endl;
+    std::cout << "  SSE + " << JobSystem::threadCount() << " threads " << fastMs / viewCount << " ms/view, SSE "
+        << simdMs / viewCount << " ms/view, scalar " << scalarMs / viewCount << " ms/view" << std::endl;
+    std::cout << "  " << rangeMismatches << " light ranges and " << listMismatches << " views differ from the scalar path; "
+        << missed << " lit sample points missing a light, " << extra << " listed lights outside their cluster" << std::endl;
+}
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "FrustumCuller.h"
+
+// Binding points of the clustered lighting blocks in receiving shaders
+const GLuint kClusterUniformBinding = 2;
+const GLuint kLightStorageBinding = 0;
+const GLuint kClusterStorageBinding = 1;
+const GLuint kLightIndexStorageBinding = 2;
+
+// Uploaded as-is: two std430 vec4s per light
+struct PointLight {
+    glm::vec3 position;
+    float radius; // Contribution reaches zero here
+    glm::vec3 color;
+    float intensity;
+};
+
+static_assert(sizeof(PointLight) == 32, "PointLight must match the std430 light layout");
+
+// std140 mirror of the ClusterData block
+struct ClusterUniformData {
+    glm::uvec4 grid;  // Tiles across, tiles down, depth slices, light count
+    glm::vec4 depth;  // Slice = log(view depth) * x + y
+    glm::vec4 screen; // Viewport size and its reciprocal
+};
+
+static_assert(sizeof(ClusterUniformData) == 3 * 16, "ClusterUniformData must match the std140 ClusterData block");
+
+struct ClusterSettings {
+    bool enabled;
+};
+
+// Inclusive cluster coordinates a light may touch; empty when z0 > z1
+struct LightClusterRange {
+    int16_t x0, x1, y0, y1, z0, z1;
+};
+
+// Clustered forward lighting. The view frustum is split into screen tiles
+// and exponential depth slices; every frame each light's cluster range is
+// found four lights at a time with SSE, the slices are filled on the job
+// system, and the result is one compact index list with an (offset, count)
+// pair per cluster that shaders walk for their fragment's cluster.
+class LightClusters {
+public:
+    LightClusters(int tilesX = 16, int tilesY = 9, int slices = 24);
+
+    // Bins the lights for this view. The flags select the scalar or
+    // single-threaded paths the report checks the fast path against.
+    void build(const std::vector<PointLight>& lights, const glm::mat4& view, const glm::mat4& projection,
+        float nearPlane, float farPlane, int viewportWidth, int viewportHeight, bool useSimd = true, bool useThreads = true);
+
+    // Streams the lights, the cluster ranges and the index list through the
+    // frame ring and binds them with the ClusterData block
+    void upload(const std::vector<PointLight>& lights);
+
+    // (offset, count) into indices() per cluster, x fastest, then y, then slice
+    const std::vector<glm::uvec2>& ranges() const;
+    const std::vector<uint32_t>& indices() const;
+    const std::vector<LightClusterRange>& lightRanges() const;
+
+    // View-space box of a cluster, for checks
+    const Aabb& clusterBounds(int x, int y, int slice) const;
+
+    size_t clusterCount() const;
+
+private:
+    void updateClusterBounds(const glm::mat4& projection, float nearPlane, float farPlane);
+    void computeRangesScalar(const std::vector<PointLight>& lights, const glm::mat4& view, size_t begin);
+    void computeRangesSimd(const std::vector<PointLight>& lights, const glm::mat4& view);
+    int sliceOf(float depth) const;
+    void binSlice(int slice, const std::vector<PointLight>& lights);
+
+    int tilesX, tilesY, slices;
+    glm::mat4 boundsProjection;
+    float boundsNear, boundsFar;
+    float sliceScale, sliceBias;
+    float nearPlane, farPlane;
+    glm::vec4 screen;
+    std::vector<Aabb> bounds;
+    std::vector<float> viewX, viewY, viewZ; // View-space light centres
+    std::vector<LightClusterRange> lightClusterRanges;
+    std::vector<std::vector<uint32_t>> slicePairs;   // (tile << 16 | light) found per slice
+    std::vector<std::vector<uint32_t>> sliceIndices; // The same lights grouped by tile
+    std::vector<glm::uvec2> clusterRanges;
+    std::vector<uint32_t> lightIndices;
+};
+
+namespace Clusters {
+    ClusterSettings& settings();
+
+    // Checks the SSE and threaded binning against the scalar single-threaded
+    // path and against lights found by brute force at points sampled inside
+    // the clusters, over random views, then times each path
+    void printReport(int lightCount = 1024, int viewCount = 100);
+}
+
+#endif // LIGHT_CLUSTERS_H
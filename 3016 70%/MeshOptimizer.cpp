@@ -0,0 +1,400 @@
+#include "MeshOptimizer.h"
+#include "AssetIOSystem.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <unordered_map>
+#include <glm.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+namespace {
+    // Welding key: a view into the source vertex array
+    struct VertexKey {
+        const float* data;
+        unsigned int stride;
+    };
+
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            uint32_t hash = 2166136261u;
+            for (unsigned int i = 0; i < key.stride; i++) {
+                float value = key.data[i] == 0.0f ? 0.0f : key.data[i]; // Treat -0 and +0 alike
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                hash = (hash ^ bits) * 16777619u;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexKeyEqual {
+        bool operator()(const VertexKey& a, const VertexKey& b) const {
+            for (unsigned int i = 0; i < a.stride; i++) {
+                if (a.data[i] != b.data[i])
+                    return false;
+            }
+            return true;
+        }
+    };
+
+    // Forsyth's scoring constants
+    const int kMaxCacheSize = 32;
+    const float kCacheDecayPower = 1.5f;
+    const float kLastTriScore = 0.75f;
+    const float kValenceBoostScale = 2.0f;
+    const float kValenceBoostPower = 0.5f;
+
+    float scoreVertex(int cachePosition, unsigned int liveTriangles) {
+        if (liveTriangles == 0)
+            return -1.0f; // No triangles left, never pick this vertex
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3) {
+                // Used by the last triangle, fixed score so it is not reused immediately
+                score = kLastTriScore;
+            }
+            else {
+                const float scaler = 1.0f / (kMaxCacheSize - 3);
+                score = std::pow(1.0f - (cachePosition - 3) * scaler, kCacheDecayPower);
+            }
+        }
+
+        // Boost vertices with few remaining triangles to finish them off
+        score += kValenceBoostScale * std::pow(static_cast<float>(liveTriangles), -kValenceBoostPower);
+        return score;
+    }
+
+    glm::vec3 positionAt(const std::vector<float>& vertices, unsigned int stride, unsigned int index) {
+        const float* p = &vertices[static_cast<size_t>(index) * stride];
+        return glm::vec3(p[0], p[1], p[2]);
+    }
+}
+
+namespace MeshOptimizer {
+
+void weldVertices(MeshData& mesh) {
+    size_t vertexCount = mesh.vertices.size() / mesh.stride;
+
+    std::unordered_map<VertexKey, unsigned int, VertexKeyHash, VertexKeyEqual> unique;
+    unique.reserve(vertexCount);
+
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<float> welded;
+    welded.reserve(mesh.vertices.size());
+
+    for (size_t v = 0; v < vertexCount; v++) {
+        const float* data = &mesh.vertices[v * mesh.stride];
+        unsigned int next = static_cast<unsigned int>(welded.size() / mesh.stride);
+        auto result = unique.emplace(VertexKey{ data, mesh.stride }, next);
+        if (result.second)
+            welded.insert(welded.end(), data, data + mesh.stride);
+        remap[v] = result.first->second;
+    }
+
+    for (auto& index : mesh.indices)
+        index = remap[index];
+
+    mesh.vertices.swap(welded);
+}
+
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Per-vertex adjacency: the live triangles of vertex v are
+    // triangleList[triangleOffsets[v] .. triangleOffsets[v] + liveCount[v])
+    std::vector<unsigned int> liveCount(vertexCount, 0);
+    for (auto index : indices)
+        liveCount[index]++;
+
+    std::vector<unsigned int> triangleOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        triangleOffsets[v + 1] = triangleOffsets[v] + liveCount[v];
+
+    std::vector<unsigned int> triangleList(indices.size());
+    std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        triangleList[fill[indices[i]]++] = static_cast<unsigned int>(i / 3);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        vertexScore[v] = scoreVertex(-1, liveCount[v]);
+
+    std::vector<char> emitted(triangleCount, 0);
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+
+    std::vector<unsigned int> cache;
+    std::vector<unsigned int> newCache;
+    cache.reserve(kMaxCacheSize + 3);
+    newCache.reserve(kMaxCacheSize + 3);
+
+    size_t scanCursor = 0;
+    long long bestTriangle = -1;
+
+    while (result.size() < indices.size()) {
+        if (bestTriangle < 0) {
+            // Nothing in the cache has live triangles left, start a new strip
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            if (scanCursor == triangleCount)
+                break;
+            bestTriangle = static_cast<long long>(scanCursor);
+        }
+
+        size_t t = static_cast<size_t>(bestTriangle);
+        emitted[t] = 1;
+
+        const unsigned int* tri = &indices[t * 3];
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = tri[k];
+            result.push_back(v);
+
+            // Remove the triangle from the vertex's live list
+            unsigned int* begin = &triangleList[triangleOffsets[v]];
+            unsigned int* end = begin + liveCount[v];
+            unsigned int* found = std::find(begin, end, static_cast<unsigned int>(t));
+            std::swap(*found, *(end - 1));
+            liveCount[v]--;
+        }
+
+        // Emitted vertices move to the front, everything else shifts back
+        newCache.clear();
+        newCache.insert(newCache.end(), tri, tri + 3);
+        for (auto v : cache) {
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                newCache.push_back(v);
+        }
+
+        for (size_t i = 0; i < newCache.size(); i++) {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < kMaxCacheSize ? static_cast<int>(i) : -1;
+            vertexScore[v] = scoreVertex(cachePosition[v], liveCount[v]);
+        }
+
+        // Rescore the triangles touched by the cache and pick the best one
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < newCache.size(); i++) {
+            unsigned int v = newCache[i];
+            for (unsigned int j = 0; j < liveCount[v]; j++) {
+                unsigned int candidate = triangleList[triangleOffsets[v] + j];
+                const unsigned int* c = &indices[candidate * 3];
+                float score = vertexScore[c[0]] + vertexScore[c[1]] + vertexScore[c[2]];
+                if (i < kMaxCacheSize && score > bestScore) {
+                    bestScore = score;
+                    bestTriangle = candidate;
+                }
+            }
+        }
+
+        if (newCache.size() > kMaxCacheSize)
+            newCache.resize(kMaxCacheSize);
+        cache.swap(newCache);
+    }
+
+    indices.swap(result);
+}
+
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, unsigned int stride, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    size_t vertexCount = vertices.size() / stride;
+    if (triangleCount < 2)
+        return;
+
+    VertexCacheStats original = analyzeVertexCache(indices, vertexCount);
+
+    // Split the cache-optimized sequence into clusters at hard boundaries,
+    // i.e. triangles where all three vertices miss the simulated cache
+    const unsigned int cacheSize = 16;
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    std::vector<size_t> clusterStarts;
+    for (size_t t = 0; t < triangleCount; t++) {
+        int misses = 0;
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - timestamps[v] > cacheSize) {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3)
+            clusterStarts.push_back(t);
+    }
+    clusterStarts.push_back(triangleCount);
+
+    size_t clusterCount = clusterStarts.size() - 1;
+    if (clusterCount < 2)
+        return;
+
+    glm::vec3 meshCentroid(0.0f);
+    for (auto index : indices)
+        meshCentroid += positionAt(vertices, stride, index);
+    meshCentroid /= static_cast<float>(indices.size());
+
+    // Clusters facing away from the mesh centre are drawn first so they
+    // occlude the inner and back-facing clusters drawn after them
+    std::vector<float> sortKeys(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+            glm::vec3 p0 = positionAt(vertices, stride, indices[t * 3]);
+            glm::vec3 p1 = positionAt(vertices, stride, indices[t * 3 + 1]);
+            glm::vec3 p2 = positionAt(vertices, stride, indices[t * 3 + 2]);
+            centroid += p0 + p1 + p2;
+            normal += glm::cross(p1 - p0, p2 - p0); // Area weighted
+        }
+        centroid /= static_cast<float>((clusterStarts[c + 1] - clusterStarts[c]) * 3);
+        float length = glm::length(normal);
+        sortKeys[c] = length > 0.0f ? glm::dot(centroid - meshCentroid, normal / length) : 0.0f;
+    }
+
+    std::vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++)
+        order[c] = c;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (auto c : order)
+        result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+
+    VertexCacheStats sorted = analyzeVertexCache(result, vertexCount);
+    if (sorted.acmr <= original.acmr * threshold)
+        indices.swap(result);
+}
+
+void optimizeVertexFetch(MeshData& mesh) {
+    size_t vertexCount = mesh.vertices.size() / mesh.stride;
+    const unsigned int unused = ~0u;
+
+    std::vector<unsigned int> remap(vertexCount, unused);
+    std::vector<float> reordered;
+    reordered.reserve(mesh.vertices.size());
+
+    unsigned int next = 0;
+    for (auto& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+            const float* data = &mesh.vertices[static_cast<size_t>(index) * mesh.stride];
+            reordered.insert(reordered.end(), data, data + mesh.stride);
+        }
+        index = remap[index];
+    }
+
+    // Vertices no index refers to are dropped
+    mesh.vertices.swap(reordered);
+}
+
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize) {
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return stats;
+
+    // FIFO cache simulation using insertion timestamps
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    std::vector<char> used(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0;
+    size_t uniqueVertices = 0;
+
+    for (auto v : indices) {
+        if (time - timestamps[v] > cacheSize) {
+            timestamps[v] = time++;
+            misses++;
+        }
+        if (!used[v]) {
+            used[v] = 1;
+            uniqueVertices++;
+        }
+    }
+
+    stats.acmr = static_cast<float>(misses) / triangleCount;
+    stats.atvr = uniqueVertices > 0 ? static_cast<float>(misses) / uniqueVertices : 0.0f;
+    return stats;
+}
+
+MeshOptimizeReport optimize(MeshData& mesh, const std::string& name) {
+    MeshOptimizeReport report;
+    report.verticesBefore = mesh.vertices.size() / mesh.stride;
+    report.before = analyzeVertexCache(mesh.indices, report.verticesBefore);
+
+    weldVertices(mesh);
+    optimizeVertexCache(mesh.indices, mesh.vertices.size() / mesh.stride);
+    optimizeOverdraw(mesh.indices, mesh.vertices, mesh.stride);
+    optimizeVertexFetch(mesh);
+
+    report.verticesAfter = mesh.vertices.size() / mesh.stride;
+    report.after = analyzeVertexCache(mesh.indices, report.verticesAfter);
+
+    std::cout << "Mesh optimize " << name << ": " << mesh.indices.size() / 3 << " triangles, vertices "
+        << report.verticesBefore << " -> " << report.verticesAfter
+        << ", ACMR " << report.before.acmr << " -> " << report.after.acmr
+        << ", ATVR " << report.before.atvr << " -> " << report.after.atvr << std::endl;
+
+    return report;
+}
+
+void reportDirectory(const std::string& root) {
+    if (!std::filesystem::exists(root)) {
+        std::cerr << "Mesh report: directory not found: " << root << std::endl;
+        return;
+    }
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+        if (!entry.is_regular_file())
+            continue;
+
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension != ".fbx")
+            continue;
+
+        std::string path = entry.path().string();
+        Assimp::Importer importer;
+        const aiScene* scene = AssetIO::readScene(importer, path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cerr << "Error loading model: " << importer.GetErrorString() << std::endl;
+            continue;
+        }
+
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+            const aiMesh* mesh = scene->mMeshes[i];
+
+            // Same position/UV/normal layout the sword renderer uploads
+            MeshData data;
+            data.stride = 8;
+            data.vertices.reserve(static_cast<size_t>(mesh->mNumVertices) * data.stride);
+            for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
+                aiVector3D pos = mesh->mVertices[j];
+                aiVector3D uv = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j] : aiVector3D(0.0f, 0.0f, 0.0f);
+                aiVector3D normal = mesh->mNormals ? mesh->mNormals[j] : aiVector3D(0.0f, 1.0f, 0.0f);
+                float vertex[] = { pos.x, pos.y, pos.z, uv.x, uv.y, normal.x, normal.y, normal.z };
+                data.vertices.insert(data.vertices.end(), vertex, vertex + 8);
+            }
+            for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
+                const aiFace& face = mesh->mFaces[j];
+                if (face.mNumIndices != 3)
+                    continue; // Skip points and lines left by triangulation
+                data.indices.insert(data.indices.end(), face.mIndices, face.mIndices + 3);
+            }
+
+            optimize(data, path + " [" + mesh->mName.C_Str() + "]");
+        }
+    }
+}
+
+}
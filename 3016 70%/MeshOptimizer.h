@@ -0,0 +1,51 @@
+#pragma once
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include <string>
+
+// Interleaved float vertex data as uploaded to the GPU. The position must be
+// the first three floats of every vertex.
+struct MeshData {
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    unsigned int stride; // Floats per vertex
+};
+
+struct VertexCacheStats {
+    float acmr; // Average cache miss ratio (misses per triangle)
+    float atvr; // Average transformed vertex ratio (misses per unique vertex)
+};
+
+struct MeshOptimizeReport {
+    size_t verticesBefore;
+    size_t verticesAfter;
+    VertexCacheStats before;
+    VertexCacheStats after;
+};
+
+namespace MeshOptimizer {
+    // Merges bitwise identical vertices and rewrites the index buffer
+    void weldVertices(MeshData& mesh);
+
+    // Reorders triangles for the post-transform vertex cache (Forsyth)
+    void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+    // Reorders cache-friendly triangle clusters outside-in to reduce overdraw.
+    // The result is rejected if ACMR grows by more than the given threshold.
+    void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, unsigned int stride, float threshold = 1.05f);
+
+    // Reorders vertices by first use so vertex fetch walks memory linearly
+    void optimizeVertexFetch(MeshData& mesh);
+
+    VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16);
+
+    // Runs all passes in order and prints ACMR/ATVR before and after
+    MeshOptimizeReport optimize(MeshData& mesh, const std::string& name);
+
+    // Imports every FBX file below root and prints the optimization report
+    void reportDirectory(const std::string& root);
+}
+
+#endif // MESH_OPTIMIZER_H
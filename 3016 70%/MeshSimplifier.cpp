@@ -0,0 +1,299 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <glm.hpp>
+
+namespace {
+    // Symmetric 4x4 error quadric for the plane equation ax + by + cz + d = 0
+    struct Quadric {
+        double a2, ab, ac, ad;
+        double b2, bc, bd;
+        double c2, cd;
+        double d2;
+    };
+
+    Quadric planeQuadric(const glm::dvec3& n, double d) {
+        return { n.x * n.x, n.x * n.y, n.x * n.z, n.x * d,
+                 n.y * n.y, n.y * n.z, n.y * d,
+                 n.z * n.z, n.z * d,
+                 d * d };
+    }
+
+    void addQuadric(Quadric& q, const Quadric& r) {
+        q.a2 += r.a2; q.ab += r.ab; q.ac += r.ac; q.ad += r.ad;
+        q.b2 += r.b2; q.bc += r.bc; q.bd += r.bd;
+        q.c2 += r.c2; q.cd += r.cd;
+        q.d2 += r.d2;
+    }
+
+    double evaluateQuadric(const Quadric& q, const glm::dvec3& p) {
+        double x = p.x, y = p.y, z = p.z;
+        return q.a2 * x * x + 2.0 * q.ab * x * y + 2.0 * q.ac * x * z + 2.0 * q.ad * x
+            + q.b2 * y * y + 2.0 * q.bc * y * z + 2.0 * q.bd * y
+            + q.c2 * z * z + 2.0 * q.cd * z
+            + q.d2;
+    }
+
+    struct Collapse {
+        unsigned int from;
+        unsigned int to;
+        double cost;
+    };
+
+    uint64_t positionKey(const float* p) {
+        uint32_t bits[3];
+        for (int i = 0; i < 3; i++) {
+            float value = p[i] == 0.0f ? 0.0f : p[i];
+            std::memcpy(&bits[i], &value, sizeof(uint32_t));
+        }
+        uint64_t hash = 1469598103934665603ull;
+        for (int i = 0; i < 3; i++)
+            hash = (hash ^ bits[i]) * 1099511628211ull;
+        return hash;
+    }
+
+    glm::vec3 triangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+        return glm::cross(p1 - p0, p2 - p0);
+    }
+}
+
+namespace MeshSimplifier {
+
+std::vector<unsigned int> simplify(const std::vector<float>& vertices, unsigned int stride, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float targetError, float* resultError) {
+    size_t vertexCount = vertices.size() / stride;
+    std::vector<unsigned int> result = indices;
+    if (resultError)
+        *resultError = 0.0f;
+    if (result.size() <= targetIndexCount || vertexCount == 0)
+        return result;
+
+    // Collapses work on positions, so attribute seams (same position, different
+    // UV or normal) move together. Every vertex maps to the first vertex at its position.
+    std::vector<unsigned int> canonical(vertexCount);
+    {
+        std::unordered_multimap<uint64_t, unsigned int> positions;
+        positions.reserve(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            const float* p = &vertices[v * stride];
+            uint64_t key = positionKey(p);
+            canonical[v] = static_cast<unsigned int>(v);
+            auto range = positions.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+                const float* q = &vertices[static_cast<size_t>(it->second) * stride];
+                if (p[0] == q[0] && p[1] == q[1] && p[2] == q[2]) {
+                    canonical[v] = it->second;
+                    break;
+                }
+            }
+            if (canonical[v] == v)
+                positions.emplace(key, static_cast<unsigned int>(v));
+        }
+    }
+
+    std::vector<glm::vec3> position(vertexCount);
+    glm::vec3 minBounds(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 maxBounds = minBounds;
+    for (size_t v = 0; v < vertexCount; v++) {
+        position[v] = glm::vec3(vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2]);
+        minBounds = glm::min(minBounds, position[v]);
+        maxBounds = glm::max(maxBounds, position[v]);
+    }
+    glm::vec3 size = maxBounds - minBounds;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+    if (extent <= 0.0f)
+        return result;
+
+    double maxCost = static_cast<double>(targetError) * extent;
+    maxCost *= maxCost;
+
+    // Unweighted plane quadrics, so the cost is a sum of squared distances
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+        unsigned int c0 = canonical[result[i]], c1 = canonical[result[i + 1]], c2 = canonical[result[i + 2]];
+        glm::dvec3 normal = glm::dvec3(triangleNormal(position[c0], position[c1], position[c2]));
+        double length = glm::length(normal);
+        if (length <= 0.0)
+            continue;
+        normal /= length;
+        Quadric q = planeQuadric(normal, -glm::dot(normal, glm::dvec3(position[c0])));
+        addQuadric(quadrics[c0], q);
+        addQuadric(quadrics[c1], q);
+        addQuadric(quadrics[c2], q);
+    }
+
+    // Open borders are locked so silhouettes and holes keep their shape
+    std::vector<char> locked(vertexCount, 0);
+    {
+        std::unordered_map<uint64_t, int> edgeUse;
+        edgeUse.reserve(result.size());
+        for (size_t i = 0; i + 2 < result.size(); i += 3) {
+            for (int e = 0; e < 3; e++) {
+                unsigned int a = canonical[result[i + e]], b = canonical[result[i + (e + 1) % 3]];
+                uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+                edgeUse[key]++;
+            }
+        }
+        for (const auto& edge : edgeUse) {
+            if (edge.second == 1) {
+                locked[edge.first >> 32] = 1;
+                locked[edge.first & 0xffffffffu] = 1;
+            }
+        }
+    }
+
+    std::vector<unsigned int> collapsedTo(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        collapsedTo[v] = static_cast<unsigned int>(v);
+
+    std::vector<Collapse> candidates;
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+    std::vector<unsigned int> adjacency;
+    std::vector<char> touched(vertexCount);
+    double worstCost = 0.0;
+
+    while (result.size() > targetIndexCount) {
+        size_t triangleCount = result.size() / 3;
+
+        // Triangle adjacency per canonical vertex for the flip test
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (auto index : result)
+            adjacencyOffsets[canonical[index] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < result.size(); i++)
+            adjacency[fill[canonical[result[i]]]++] = static_cast<unsigned int>(i / 3);
+
+        // Cheapest direction of every edge within the error budget
+        candidates.clear();
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int e = 0; e < 3; e++) {
+                unsigned int a = canonical[result[t * 3 + e]], b = canonical[result[t * 3 + (e + 1) % 3]];
+                if (a > b)
+                    continue; // Each interior edge is seen from both triangles
+                Quadric q = quadrics[a];
+                addQuadric(q, quadrics[b]);
+                double costAB = locked[a] ? DBL_MAX : evaluateQuadric(q, glm::dvec3(position[b]));
+                double costBA = locked[b] ? DBL_MAX : evaluateQuadric(q, glm::dvec3(position[a]));
+                Collapse collapse = costAB <= costBA ? Collapse{ a, b, costAB } : Collapse{ b, a, costBA };
+                if (collapse.cost <= maxCost)
+                    candidates.push_back(collapse);
+            }
+        }
+        if (candidates.empty())
+            break;
+
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        // Every collapse removes about two triangles
+        size_t collapseLimit = (result.size() - targetIndexCount) / 6 + 1;
+        size_t collapses = 0;
+        std::fill(touched.begin(), touched.end(), 0);
+
+        for (const auto& collapse : candidates) {
+            if (collapses >= collapseLimit)
+                break;
+            if (touched[collapse.from] || touched[collapse.to])
+                continue;
+
+            // Reject collapses that flip a surviving triangle around the moved vertex
+            bool flips = false;
+            for (unsigned int j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1] && !flips; j++) {
+                unsigned int t = adjacency[j];
+                unsigned int c[3] = { canonical[result[t * 3]], canonical[result[t * 3 + 1]], canonical[result[t * 3 + 2]] };
+                if (c[0] == collapse.to || c[1] == collapse.to || c[2] == collapse.to)
+                    continue; // Becomes degenerate and is removed
+                glm::vec3 before = triangleNormal(position[c[0]], position[c[1]], position[c[2]]);
+                for (int k = 0; k < 3; k++) {
+                    if (c[k] == collapse.from)
+                        c[k] = collapse.to;
+                }
+                glm::vec3 after = triangleNormal(position[c[0]], position[c[1]], position[c[2]]);
+                flips = glm::dot(before, after) <= 0.0f;
+            }
+            if (flips)
+                continue;
+
+            collapsedTo[collapse.from] = collapse.to;
+            addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+            touched[collapse.from] = 1;
+            touched[collapse.to] = 1;
+            worstCost = std::max(worstCost, collapse.cost);
+            collapses++;
+        }
+        if (collapses == 0)
+            break;
+
+        // Moved corners take the surviving vertex and its attributes; corners
+        // that did not move keep their own vertex so seams survive
+        size_t write = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            unsigned int corner[3];
+            unsigned int c[3];
+            for (int k = 0; k < 3; k++) {
+                corner[k] = result[t * 3 + k];
+                c[k] = canonical[corner[k]];
+                if (collapsedTo[c[k]] != c[k]) {
+                    c[k] = collapsedTo[c[k]];
+                    corner[k] = c[k];
+                }
+            }
+            if (c[0] == c[1] || c[1] == c[2] || c[0] == c[2])
+                continue;
+            result[write++] = corner[0];
+            result[write++] = corner[1];
+            result[write++] = corner[2];
+        }
+        result.resize(write);
+
+        // Collapse targets are never moved in the same pass, so one step resolves them
+        for (size_t v = 0; v < vertexCount; v++)
+            collapsedTo[v] = static_cast<unsigned int>(v);
+    }
+
+    if (resultError)
+        *resultError = static_cast<float>(std::sqrt(worstCost) / extent);
+    return result;
+}
+
+std::vector<LodLevel> buildLodChain(MeshData& mesh, int maxLevels, float reduction, float targetError) {
+    std::vector<LodLevel> levels;
+    levels.push_back({ 0, static_cast<unsigned int>(mesh.indices.size()), 0.0f });
+
+    size_t vertexCount = mesh.vertices.size() / mesh.stride;
+    std::vector<unsigned int> source = mesh.indices;
+    float errorLimit = targetError;
+
+    for (int level = 1; level < maxLevels; level++) {
+        size_t target = static_cast<size_t>(source.size() / 3 * reduction) * 3;
+        float error = 0.0f;
+        std::vector<unsigned int> lod = simplify(mesh.vertices, mesh.stride, source, target, errorLimit, &error);
+
+        // Stop once the error budget no longer buys a meaningful reduction
+        if (lod.empty() || lod.size() > source.size() * 0.9f)
+            break;
+
+        MeshOptimizer::optimizeVertexCache(lod, vertexCount);
+        levels.push_back({ static_cast<unsigned int>(mesh.indices.size()), static_cast<unsigned int>(lod.size()), error });
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+
+        source.swap(lod);
+        errorLimit *= 2.0f;
+    }
+
+    std::cout << "LOD chain:";
+    for (const auto& level : levels)
+        std::cout << " " << level.indexCount / 3;
+    std::cout << " triangles" << std::endl;
+
+    return levels;
+}
+
+}
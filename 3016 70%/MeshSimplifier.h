@@ -0,0 +1,27 @@
+#pragma once
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include "MeshOptimizer.h"
+
+// One level of detail stored as a range of a shared index buffer
+struct LodLevel {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    float error; // Relative to the mesh extent
+};
+
+namespace MeshSimplifier {
+    // Quadric error edge collapse. Collapses vertices onto existing vertices so
+    // the result indexes the same vertex buffer. Stops at targetIndexCount or
+    // when the next collapse would exceed targetError (relative to the mesh extent).
+    std::vector<unsigned int> simplify(const std::vector<float>& vertices, unsigned int stride, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+    // Appends up to maxLevels - 1 simplified index lists after the LOD 0
+    // indices in mesh.indices and returns the ranges of every level
+    std::vector<LodLevel> buildLodChain(MeshData& mesh, int maxLevels = 4, float reduction = 0.5f, float targetError = 0.01f);
+}
+
+#endif // MESH_SIMPLIFIER_H
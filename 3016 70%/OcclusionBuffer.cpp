@@ -0,0 +1,337 @@
+#include "OcclusionBuffer.h"
+#include "terrain.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <gtc/constants.hpp>
+#include <gtc/matrix_transform.hpp>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define OCCLUSION_BUFFER_SSE 1
+#endif
+
+namespace {
+    const int kTileSize = 8;
+
+    // Clips a polygon against the near plane z >= -w in clip space
+    int clipNear(const glm::vec4* input, int count, glm::vec4* output) {
+        int written = 0;
+        for (int i = 0; i < count; i++) {
+            const glm::vec4& current = input[i];
+            const glm::vec4& next = input[(i + 1) % count];
+            float currentDistance = current.z + current.w;
+            float nextDistance = next.z + next.w;
+            if (currentDistance >= 0.0f)
+                output[written++] = current;
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+                output[written++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+        }
+        return written;
+    }
+
+    // Triangles entirely beyond one side plane never reach the screen
+    bool outsideSidePlanes(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c) {
+        return (a.x > a.w && b.x > b.w && c.x > c.w) || (a.x < -a.w && b.x < -b.w && c.x < -c.w) ||
+               (a.y > a.w && b.y > b.w && c.y > c.w) || (a.y < -a.w && b.y < -b.w && c.y < -c.w);
+    }
+}
+
+OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : width((width + kTileSize - 1) / kTileSize * kTileSize), height((height + kTileSize - 1) / kTileSize * kTileSize),
+      viewProjection(1.0f), rasterMs(0.0f) {
+    tilesX = this->width / kTileSize;
+    tilesY = this->height / kTileSize;
+    depth.assign(static_cast<size_t>(this->width) * this->height, 1.0f);
+    tileDepth.assign(static_cast<size_t>(tilesX) * tilesY, 1.0f);
+}
+
+void OcclusionBuffer::buildOccluders(const Terrain& terrain, int step) {
+    int gridSize = terrain.getGridSize();
+    const std::vector<float>& heights = terrain.getHeights();
+    int samples = gridSize / step + 1;
+
+    occluderVertices.clear();
+    occluderIndices.clear();
+    for (int z = 0; z < samples; z++) {
+        for (int x = 0; x < samples; x++) {
+            int centerX = std::min(x * step, gridSize);
+            int centerZ = std::min(z * step, gridSize);
+
+            // Lowest sample under the triangles that touch this vertex
+            float lowest = heights[centerZ * (gridSize + 1) + centerX];
+            for (int sz = std::max(centerZ - step, 0); sz <= std::min(centerZ + step, gridSize); sz++) {
+                for (int sx = std::max(centerX - step, 0); sx <= std::min(centerX + step, gridSize); sx++)
+                    lowest = std::min(lowest, heights[sz * (gridSize + 1) + sx]);
+            }
+            occluderVertices.push_back(glm::vec3(centerX, lowest, centerZ));
+        }
+    }
+
+    for (int z = 0; z + 1 < samples; z++) {
+        for (int x = 0; x + 1 < samples; x++) {
+            unsigned int topLeft = z * samples + x;
+            unsigned int bottomLeft = topLeft + samples;
+            unsigned int quad[] = { topLeft, bottomLeft, topLeft + 1, topLeft + 1, bottomLeft, bottomLeft + 1 };
+            occluderIndices.insert(occluderIndices.end(), quad, quad + 6);
+        }
+    }
+}
+
+void OcclusionBuffer::rasterizeTriangle(const glm::vec3& a, glm::vec3 b, glm::vec3 c) {
+    float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    if (std::fabs(area) < 1e-6f)
+        return;
+    if (area < 0.0f) {
+        std::swap(b, c);
+        area = -area;
+    }
+
+    int minX = std::max(0, static_cast<int>(std::floor(std::min(a.x, std::min(b.x, c.x)))));
+    int maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max(a.x, std::max(b.x, c.x)))));
+    int minY = std::max(0, static_cast<int>(std::floor(std::min(a.y, std::min(b.y, c.y)))));
+    int maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max(a.y, std::max(b.y, c.y)))));
+    if (minX > maxX || minY > maxY)
+        return;
+    minX &= ~3; // Rows are processed four pixels at a time
+
+    // Edge functions E = A * x + B * y + C, positive inside
+    const glm::vec3* from[3] = { &a, &b, &c };
+    const glm::vec3* to[3] = { &b, &c, &a };
+    float edgeA[3], edgeB[3], edgeC[3];
+    for (int e = 0; e < 3; e++) {
+        edgeA[e] = -(to[e]->y - from[e]->y);
+        edgeB[e] = to[e]->x - from[e]->x;
+        edgeC[e] = -(edgeA[e] * from[e]->x + edgeB[e] * from[e]->y);
+    }
+
+    // Depth is linear in screen space
+    float dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / area;
+    float dzdy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / area;
+    float z0 = a.z - dzdx * a.x - dzdy * a.y;
+
+#ifdef OCCLUSION_BUFFER_SSE
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 stepX = _mm_set1_ps(4.0f);
+    __m128 A[3], startOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    for (int e = 0; e < 3; e++)
+        A[e] = _mm_set1_ps(edgeA[e]);
+    __m128 dzdxs = _mm_set1_ps(dzdx);
+
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(minX)), startOffsets);
+        __m128 E[3];
+        for (int e = 0; e < 3; e++)
+            E[e] = _mm_add_ps(_mm_mul_ps(A[e], px), _mm_set1_ps(edgeB[e] * py + edgeC[e]));
+        __m128 z = _mm_add_ps(_mm_mul_ps(dzdxs, px), _mm_set1_ps(dzdy * py + z0));
+
+        float* row = &depth[static_cast<size_t>(y) * width];
+        for (int x = minX; x <= maxX; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(E[0], zero), _mm_cmpge_ps(E[1], zero)), _mm_cmpge_ps(E[2], zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 current = _mm_loadu_ps(row + x);
+                __m128 candidate = _mm_min_ps(_mm_max_ps(z, zero), one);
+                __m128 nearer = _mm_min_ps(current, candidate);
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+            }
+            for (int e = 0; e < 3; e++)
+                E[e] = _mm_add_ps(E[e], _mm_mul_ps(A[e], stepX));
+            z = _mm_add_ps(z, _mm_mul_ps(dzdxs, stepX));
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; y++) {
+        float py = y + 0.5f;
+        float* row = &depth[static_cast<size_t>(y) * width];
+        for (int x = minX; x <= maxX; x++) {
+            float px = x + 0.5f;
+            if (edgeA[0] * px + edgeB[0] * py + edgeC[0] < 0.0f ||
+                edgeA[1] * px + edgeB[1] * py + edgeC[1] < 0.0f ||
+                edgeA[2] * px + edgeB[2] * py + edgeC[2] < 0.0f)
+                continue;
+            float z = std::min(std::max(dzdx * px + dzdy * py + z0, 0.0f), 1.0f);
+            row[x] = std::min(row[x], z);
+        }
+    }
+#endif
+}
+
+void OcclusionBuffer::updateTileDepths() {
+    for (int ty = 0; ty < tilesY; ty++) {
+        for (int tx = 0; tx < tilesX; tx++) {
+            float farthest = 0.0f;
+            for (int y = ty * kTileSize; y < (ty + 1) * kTileSize; y++) {
+                const float* row = &depth[static_cast<size_t>(y) * width + tx * kTileSize];
+                for (int x = 0; x < kTileSize; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            tileDepth[ty * tilesX + tx] = farthest;
+        }
+    }
+}
+
+void OcclusionBuffer::render(const glm::mat4& viewProjection) {
+    auto start = std::chrono::steady_clock::now();
+    this->viewProjection = viewProjection;
+    std::fill(depth.begin(), depth.end(), 1.0f);
+
+    std::vector<glm::vec4> clip(occluderVertices.size());
+    for (size_t i = 0; i < occluderVertices.size(); i++)
+        clip[i] = viewProjection * glm::vec4(occluderVertices[i], 1.0f);
+
+    auto toScreen = [&](const glm::vec4& v) {
+        glm::vec3 ndc = glm::vec3(v) / v.w;
+        return glm::vec3((ndc.x * 0.5f + 0.5f) * width, (ndc.y * 0.5f + 0.5f) * height, ndc.z * 0.5f + 0.5f);
+    };
+
+    for (size_t i = 0; i + 2 < occluderIndices.size(); i += 3) {
+        glm::vec4 triangle[3] = { clip[occluderIndices[i]], clip[occluderIndices[i + 1]], clip[occluderIndices[i + 2]] };
+        if (outsideSidePlanes(triangle[0], triangle[1], triangle[2]))
+            continue;
+
+        glm::vec4 polygon[4];
+        int count = clipNear(triangle, 3, polygon);
+        if (count < 3)
+            continue;
+        glm::vec3 first = toScreen(polygon[0]);
+        for (int v = 1; v + 1 < count; v++)
+            rasterizeTriangle(first, toScreen(polygon[v]), toScreen(polygon[v + 1]));
+    }
+
+    updateTileDepths();
+
+    rasterMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    RenderStats::frame().occluderRasterMs += rasterMs;
+}
+
+bool OcclusionBuffer::isVisible(const Aabb& box) const {
+    glm::vec2 minNdc(FLT_MAX), maxNdc(-FLT_MAX);
+    float nearest = FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+        glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+        if (clip.z < -clip.w)
+            return true; // Crosses the near plane, too close to reject
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        minNdc = glm::min(minNdc, glm::vec2(ndc));
+        maxNdc = glm::max(maxNdc, glm::vec2(ndc));
+        nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+    }
+
+    int x0 = std::max(0, static_cast<int>(std::floor((minNdc.x * 0.5f + 0.5f) * width)));
+    int x1 = std::min(width - 1, static_cast<int>(std::ceil((maxNdc.x * 0.5f + 0.5f) * width)));
+    int y0 = std::max(0, static_cast<int>(std::floor((minNdc.y * 0.5f + 0.5f) * height)));
+    int y1 = std::min(height - 1, static_cast<int>(std::ceil((maxNdc.y * 0.5f + 0.5f) * height)));
+    if (x0 > x1 || y0 > y1)
+        return true; // Off screen, left to the frustum test
+
+    for (int ty = y0 / kTileSize; ty <= y1 / kTileSize; ty++) {
+        for (int tx = x0 / kTileSize; tx <= x1 / kTileSize; tx++) {
+            // Every sample in the tile is nearer than the box
+            if (tileDepth[ty * tilesX + tx] < nearest)
+                continue;
+
+            int startX = std::max(x0, tx * kTileSize), endX = std::min(x1, (tx + 1) * kTileSize - 1);
+            int startY = std::max(y0, ty * kTileSize), endY = std::min(y1, (ty + 1) * kTileSize - 1);
+            for (int y = startY; y <= endY; y++) {
+                const float* row = &depth[static_cast<size_t>(y) * width];
+                int x = startX;
+#ifdef OCCLUSION_BUFFER_SSE
+                __m128 boxDepth = _mm_set1_ps(nearest);
+                for (; x + 3 <= endX; x += 4) {
+                    if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)))
+                        return true;
+                }
+#endif
+                for (; x <= endX; x++) {
+                    if (row[x] >= nearest)
+                        return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+void OcclusionBuffer::cull(const AabbSoA& boxes, std::vector<uint32_t>& visible) const {
+    size_t write = 0;
+    for (auto index : visible) {
+        glm::vec3 center(boxes.centerX[index], boxes.centerY[index], boxes.centerZ[index]);
+        glm::vec3 extent(boxes.extentX[index], boxes.extentY[index], boxes.extentZ[index]);
+        if (isVisible({ center - extent, center + extent }))
+            visible[write++] = index;
+    }
+
+    FrameStats& stats = RenderStats::frame();
+    stats.occlusionTested += static_cast<unsigned int>(visible.size());
+    stats.occlusionCulled += static_cast<unsigned int>(visible.size() - write);
+    visible.resize(write);
+}
+
+float OcclusionBuffer::rasterMilliseconds() const {
+    return rasterMs;
+}
+
+size_t OcclusionBuffer::occluderTriangles() const {
+    return occluderIndices.size() / 3;
+}
+
+namespace Occlusion {
+
+OcclusionSettings& settings() {
+    static OcclusionSettings occlusionSettings = { true };
+    return occlusionSettings;
+}
+
+void printReport(const Terrain& terrain, int propCount, int viewCount) {
+    std::mt19937 random(1234);
+    float gridSize = static_cast<float>(terrain.getGridSize());
+    std::uniform_real_distribution<float> position(0.0f, gridSize);
+    std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+
+    AabbSoA props;
+    for (int i = 0; i < propCount; i++) {
+        float x = position(random), z = position(random);
+        glm::vec3 base(x, terrain.getHeightAt(x, z), z);
+        props.add({ base - glm::vec3(0.5f, 0.0f, 0.5f), base + glm::vec3(0.5f, 1.0f, 0.5f) });
+    }
+
+    OcclusionBuffer buffer;
+    buffer.buildOccluders(terrain);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+
+    double rasterMs = 0.0, testMs = 0.0;
+    size_t inFrustum = 0, occluded = 0;
+    std::vector<uint32_t> visible;
+    for (int view = 0; view < viewCount; view++) {
+        float x = position(random), z = position(random), yaw = angle(random);
+        glm::vec3 eye(x, terrain.getHeightAt(x, z) + 2.0f, z);
+        glm::mat4 viewProjection = projection * glm::lookAt(eye, eye + glm::vec3(std::cos(yaw), 0.0f, std::sin(yaw)), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        buffer.render(viewProjection);
+        rasterMs += buffer.rasterMilliseconds();
+
+        FrustumCuller::cull(FrustumCuller::extract(viewProjection), props, visible);
+        size_t frustumVisible = visible.size();
+        inFrustum += frustumVisible;
+
+        auto start = std::chrono::steady_clock::now();
+        buffer.cull(props, visible);
+        testMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        occluded += frustumVisible - visible.size();
+    }
+
+    std::cout << "Occlusion report: " << buffer.occluderTriangles() << " occluder triangles, "
+        << propCount << " props, " << viewCount << " views" << std::endl;
+    std::cout << "  raster " << rasterMs / viewCount << " ms/view, test " << testMs / viewCount << " ms/view" << std::endl;
+    std::cout << "  " << inFrustum / viewCount << " props in frustum per view, " << occluded / viewCount << " occluded ("
+        << (inFrustum ? 100.0 * occluded / inFrustum : 0.0) << "%)" << std::endl;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "FrustumCuller.h"
+
+class Terrain;
+
+struct OcclusionSettings {
+    bool enabled;
+};
+
+// Small CPU depth buffer holding a conservative low-resolution copy of the
+// terrain. Prop boxes whose nearest point lies behind every covered depth
+// sample are rejected before submission.
+class OcclusionBuffer {
+public:
+    OcclusionBuffer(int width = 256, int height = 128);
+
+    // Builds the occluder mesh from every step-th heightfield sample. Each
+    // vertex takes the lowest height around it, so the occluder stays below
+    // the real surface and never hides anything the terrain would not.
+    void buildOccluders(const Terrain& terrain, int step = 4);
+
+    // Clears the buffer and rasterizes the occluders for this view
+    void render(const glm::mat4& viewProjection);
+
+    bool isVisible(const Aabb& box) const;
+
+    // Removes the boxes hidden by the occluders from visible (indices into
+    // boxes) and adds the tested and culled counts to the frame stats
+    void cull(const AabbSoA& boxes, std::vector<uint32_t>& visible) const;
+
+    float rasterMilliseconds() const;
+    size_t occluderTriangles() const;
+
+private:
+    void rasterizeTriangle(const glm::vec3& a, glm::vec3 b, glm::vec3 c);
+    void updateTileDepths();
+
+    int width, height;
+    int tilesX, tilesY;
+    std::vector<float> depth;     // Window-space depth in [0, 1], 1 is empty
+    std::vector<float> tileDepth; // Farthest depth of every 8x8 tile
+    std::vector<glm::vec3> occluderVertices;
+    std::vector<unsigned int> occluderIndices;
+    glm::mat4 viewProjection;
+    float rasterMs;
+};
+
+namespace Occlusion {
+    OcclusionSettings& settings();
+
+    // Scatters propCount boxes over the terrain, renders viewCount random
+    // ground-level views and prints raster time, test time and cull rate
+    void printReport(const Terrain& terrain, int propCount = 10000, int viewCount = 100);
+}
+
+#endif // OCCLUSION_BUFFER_H
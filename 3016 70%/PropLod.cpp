@@ -0,0 +1,108 @@
+#include "PropLod.h"
+#include "RenderStats.h"
+#include <algorithm>
+
+namespace PropLod {
+
+LodSettings& settings() {
+    static LodSettings lodSettings = { true, { 0.25f, 0.12f, 0.06f }, 0.15f, 0.004f };
+    return lodSettings;
+}
+
+glm::vec4 computeBoundingSphere(const std::vector<float>& vertices, unsigned int stride) {
+    if (vertices.size() < stride)
+        return glm::vec4(0.0f);
+
+    glm::vec3 minBounds(vertices[0], vertices[1], vertices[2]);
+    glm::vec3 maxBounds = minBounds;
+    for (size_t i = 0; i + 2 < vertices.size(); i += stride) {
+        glm::vec3 p(vertices[i], vertices[i + 1], vertices[i + 2]);
+        minBounds = glm::min(minBounds, p);
+        maxBounds = glm::max(maxBounds, p);
+    }
+
+    glm::vec3 center = (minBounds + maxBounds) * 0.5f;
+    float radius = 0.0f;
+    for (size_t i = 0; i + 2 < vertices.size(); i += stride)
+        radius = std::max(radius, glm::length(glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]) - center));
+
+    return glm::vec4(center, radius);
+}
+
+glm::vec4 mergeBoundingSpheres(const glm::vec4& a, const glm::vec4& b) {
+    if (a.w <= 0.0f)
+        return b;
+    if (b.w <= 0.0f)
+        return a;
+
+    glm::vec3 offset = glm::vec3(b) - glm::vec3(a);
+    float distance = glm::length(offset);
+    if (distance + b.w <= a.w)
+        return a;
+    if (distance + a.w <= b.w)
+        return b;
+
+    float radius = (distance + a.w + b.w) * 0.5f;
+    glm::vec3 center = glm::vec3(a) + offset * ((radius - a.w) / distance);
+    return glm::vec4(center, radius);
+}
+
+float projectedScreenSize(const glm::vec4& sphere, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection) {
+    glm::vec3 viewCenter = glm::vec3(view * model * glm::vec4(glm::vec3(sphere), 1.0f));
+    float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    float radius = sphere.w * scale;
+    float distance = glm::length(viewCenter);
+    if (distance <= radius)
+        return 1.0f; // Camera inside the bounds
+
+    return radius * projection[1][1] / distance;
+}
+
+LodChoice selectLod(float screenSize, int levelCount) {
+    const LodSettings& lod = settings();
+
+    int level = 0;
+    while (level < levelCount - 1 && level < kMaxLodLevels - 1 && screenSize < lod.screenSizes[level])
+        level++;
+
+    float threshold = level < levelCount - 1 ? lod.screenSizes[level] : lod.cullScreenSize;
+    if (screenSize < threshold)
+        return { -1, -1, 1.0f };
+
+    // Crossfade with the next level (or fade out) inside the band above the threshold
+    float bandTop = threshold * (1.0f + lod.fadeBand);
+    if (screenSize < bandTop) {
+        float fade = (screenSize - threshold) / (bandTop - threshold);
+        return { level, level + 1 < levelCount ? level + 1 : -1, fade };
+    }
+
+    return { level, -1, 1.0f };
+}
+
+void queueLod(const LodChoice& choice, const std::vector<LodLevel>& lods, const DrawItem& item, const glm::vec3& position, RenderQueue& queue) {
+    if (choice.level < 0)
+        return; // Culled, counted by the caller before it skips the instance
+
+    FrameStats& stats = RenderStats::frame();
+    stats.propInstances++;
+
+    // The outgoing level keeps the dither cells below the fade value and the
+    // incoming level the rest, so together they cover every pixel once
+    DrawItem draw = item;
+    const LodLevel& level = lods[choice.level];
+    draw.indexOffset = level.indexOffset;
+    draw.indexCount = level.indexCount;
+    draw.lodFade = glm::vec2(choice.fade < 1.0f ? choice.fade : 0.0f, choice.fade < 1.0f ? 1.0f : 0.0f);
+    queue.add(draw, position);
+
+    if (choice.fadeLevel >= 0) {
+        const LodLevel& next = lods[choice.fadeLevel];
+        draw.indexOffset = next.indexOffset;
+        draw.indexCount = next.indexCount;
+        draw.lodFade = glm::vec2(choice.fade, 0.0f);
+        queue.add(draw, position);
+        stats.lodCrossfades++;
+    }
+}
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef PROP_LOD_H
+#define PROP_LOD_H
+
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "MeshSimplifier.h"
+#include "RenderQueue.h"
+
+const int kMaxLodLevels = 4;
+
+struct LodSettings {
+    bool enabled;
+    float screenSizes[kMaxLodLevels - 1]; // Level i switches to level i + 1 below screenSizes[i]
+    float fadeBand;                       // Width of the crossfade band above each threshold, relative to it
+    float cullScreenSize;                 // Instances smaller than this fade out and are not drawn
+};
+
+struct LodChoice {
+    int level;     // -1 when culled
+    int fadeLevel; // Level drawn with the complementary dither pattern, -1 for none
+    float fade;    // Share of the dither pattern kept by level, 1 when not crossfading
+};
+
+namespace PropLod {
+    LodSettings& settings();
+
+    // Object-space bounding sphere (xyz centre, w radius) of interleaved vertices
+    glm::vec4 computeBoundingSphere(const std::vector<float>& vertices, unsigned int stride);
+    glm::vec4 mergeBoundingSpheres(const glm::vec4& a, const glm::vec4& b);
+
+    // Projected sphere radius relative to half the viewport height
+    float projectedScreenSize(const glm::vec4& sphere, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+
+    LodChoice selectLod(float screenSize, int levelCount);
+
+    // Queues the draws for a choice with the index buffer ranges of a LOD
+    // chain. item carries the state and model; each level gets its own range
+    // and dithered crossfade value.
+    void queueLod(const LodChoice& choice, const std::vector<LodLevel>& lods, const DrawItem& item, const glm::vec3& position, RenderQueue& queue);
+}
+
+#endif // PROP_LOD_H
@@ -0,0 +1,223 @@
+#include "RenderQueue.h"
+#include "CommandList.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+    // Smallest slice of sorted items worth recording on another thread
+    const size_t kItemsPerList = 256;
+}
+
+RenderQueue::RenderQueue()
+    : view(1.0f), nearPlane(0.1f), farPlane(1.0f), depthProgram(nullptr) {}
+
+void RenderQueue::begin(const glm::mat4& view, float nearPlane, float farPlane) {
+    this->view = view;
+    this->nearPlane = nearPlane;
+    this->farPlane = farPlane;
+    items.clear();
+    entries.clear();
+}
+
+uint64_t RenderQueue::makeKey(const DrawItem& item, float depth) const {
+    // GL names are small integers, so their low bits group equal state.
+    // A collision only costs a redundant bind, never a wrong draw.
+    uint64_t pass = static_cast<uint64_t>(item.pass) & 0xf;
+    uint64_t program = (item.program ? item.program->id() : 0) & 0x3ff;
+    uint64_t texture = item.texture & 0xfff;
+    uint64_t vertexArray = item.vertexArray & 0xfff;
+
+    float normalized = std::clamp((depth - nearPlane) / (farPlane - nearPlane), 0.0f, 1.0f);
+    uint64_t bucket = static_cast<uint64_t>(normalized * 65535.0f);
+    if (item.pass != RenderPass::Opaque)
+        bucket = 65535 - bucket; // Blended passes draw back to front
+
+    return (pass << 60) | (program << 50) | (texture << 38) | (vertexArray << 26) | (bucket << 10);
+}
+
+void RenderQueue::add(DrawItem item, const glm::vec3& position) {
+    float depth = -(view * glm::vec4(position, 1.0f)).z;
+    entries.push_back({ makeKey(item, depth), static_cast<uint32_t>(items.size()) });
+    items.push_back(std::move(item));
+}
+
+// LSD radix sort on bytes. Bytes every key shares are skipped, which leaves
+// about four passes since the low ten bits are unused and most frames have
+// few programs.
+void RenderQueue::sort() {
+    size_t count = entries.size();
+    scratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t histogram[256] = {};
+        for (const auto& entry : entries)
+            histogram[(entry.key >> shift) & 0xff]++;
+        if (histogram[(entries[0].key >> shift) & 0xff] == count)
+            continue;
+
+        size_t offset = 0;
+        for (auto& bucket : histogram) {
+            size_t bucketCount = bucket;
+            bucket = offset;
+            offset += bucketCount;
+        }
+        for (const auto& entry : entries)
+            scratch[histogram[(entry.key >> shift) & 0xff]++] = entry;
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::setDepthProgram(ShaderProgram* program) {
+    depthProgram = program;
+}
+
+void RenderQueue::recordDepthPrepass(CommandList& list, size_t begin, size_t end) const {
+    // Only positions are fetched and nothing is textured, so the vertex
+    // array is the only state that changes between items
+    list.useProgram(*depthProgram);
+    GLuint vertexArray = 0;
+    for (size_t i = begin; i < end; i++) {
+        const DrawItem& item = items[entries[i].item];
+        if (!item.depthVertexArray)
+            continue;
+        if (item.depthVertexArray != vertexArray) {
+            list.bindVertexArray(item.depthVertexArray);
+            vertexArray = item.depthVertexArray;
+        }
+        list.setMat4(*depthProgram, "model", item.model);
+        list.setVec2(*depthProgram, "lodFade", item.lodFade);
+        if (item.draw) {
+            // Callbacks draw with whatever vertex array is bound, which shares
+            // the index buffer of the item's own vertex array
+            list.call(item.draw);
+            vertexArray = 0;
+            continue;
+        }
+        list.drawElements(GL_TRIANGLES, item.indexCount, item.indexOffset);
+    }
+}
+
+void RenderQueue::recordShading(CommandList& list, size_t begin, size_t end, bool prepassed) const {
+    // State set earlier in this slice is not recorded again
+    ShaderProgram* program = nullptr;
+    GLuint texture = 0;
+    GLuint vertexArray = 0;
+    int depthEqual = -1;
+    for (size_t i = begin; i < end; i++) {
+        const DrawItem& item = items[entries[i].item];
+        if (item.program != program) {
+            list.useProgram(*item.program);
+            program = item.program;
+        }
+        if (item.texture && item.texture != texture) {
+            list.bindTexture(0, GL_TEXTURE_2D, item.texture);
+            texture = item.texture;
+        }
+        if (item.vertexArray && item.vertexArray != vertexArray) {
+            list.bindVertexArray(item.vertexArray);
+            vertexArray = item.vertexArray;
+        }
+
+        // Pre-passed items only shade the pixels they won in the pre-pass.
+        // The rest depth test and write as usual.
+        int equal = prepassed && item.depthVertexArray ? 1 : 0;
+        if (equal != depthEqual) {
+            list.depthFunc(equal ? GL_EQUAL : GL_LESS);
+            list.depthMask(!equal);
+            depthEqual = equal;
+        }
+
+        if (item.draw) {
+            // The callback may bind anything, so the slice forgets its state
+            list.call(item.draw);
+            program = nullptr;
+            texture = vertexArray = 0;
+            continue;
+        }
+        list.setMat4(*program, "model", item.model);
+        list.setVec2(*program, "lodFade", item.lodFade);
+        list.drawElements(GL_TRIANGLES, item.indexCount, item.indexOffset);
+    }
+}
+
+void RenderQueue::submit() {
+    FrameStats& stats = RenderStats::frame();
+    stats.queuedDraws += static_cast<unsigned int>(entries.size());
+    if (entries.empty())
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    sort();
+    auto sorted = std::chrono::steady_clock::now();
+
+    // Workers record the sorted items in slices; the lists replay in order
+    bool prepassed = DepthPrepass::settings().enabled && depthProgram;
+    if (prepassed) {
+        prepassTimer.begin();
+        GLState::colorMask(false);
+        GLState::depthFunc(GL_LESS);
+        GLState::depthMask(true);
+        CommandLists::recordAndExecute(entries.size(), kItemsPerList, [this](CommandList& list, size_t begin, size_t end) {
+            recordDepthPrepass(list, begin, end);
+        });
+        GLState::colorMask(true);
+        prepassTimer.end();
+        stats.gpuPrepassMs += prepassTimer.lastMs();
+    }
+
+    shadingTimer.begin();
+    CommandLists::recordAndExecute(entries.size(), kItemsPerList, [this, prepassed](CommandList& list, size_t begin, size_t end) {
+        recordShading(list, begin, end, prepassed);
+    });
+    GLState::depthFunc(GL_LESS);
+    GLState::depthMask(true);
+    shadingTimer.end();
+    stats.gpuShadingMs += shadingTimer.lastMs();
+
+    auto submitted = std::chrono::steady_clock::now();
+    stats.queueSortMs += std::chrono::duration<float, std::milli>(sorted - start).count();
+    stats.queueSubmitMs += std::chrono::duration<float, std::milli>(submitted - sorted).count();
+}
+
+size_t RenderQueue::size() const {
+    return items.size();
+}
+
+void RenderQueue::release() {
+    prepassTimer.release();
+    shadingTimer.release();
+}
+
+namespace DepthPrepass {
+
+DepthPrepassSettings& settings() {
+    static DepthPrepassSettings prepassSettings = { true };
+    return prepassSettings;
+}
+
+GLuint createVertexArray(const void* vertices, size_t vertexCount, size_t stride, GLuint elementBuffer, GLuint& positionBuffer) {
+    std::vector<float> positions(vertexCount * 3);
+    const unsigned char* source = static_cast<const unsigned char*>(vertices);
+    for (size_t v = 0; v < vertexCount; v++)
+        std::memcpy(&positions[v * 3], source + v * stride, 3 * sizeof(float));
+
+    GLuint vertexArray;
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &positionBuffer);
+
+    GLState::bindVertexArray(vertexArray);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, positionBuffer);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    GLState::bindVertexArray(0);
+    return vertexArray;
+}
+
+}
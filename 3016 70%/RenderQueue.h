@@ -0,0 +1,102 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "ShaderProgram.h"
+#include "GpuTimer.h"
+
+// Passes are submitted in this order
+enum class RenderPass : uint8_t {
+    Opaque,  // Front to back within each state group
+    Overlay, // Screen-space quads, back to front
+};
+
+// One deferred draw. State fields drive both the sort key and the binds
+// issued at submit time; the rest describes the draw itself.
+struct DrawItem {
+    RenderPass pass;
+    ShaderProgram* program;
+    GLuint texture;     // Bound to unit 0 when non-zero
+    GLuint vertexArray; // Bound when non-zero
+    GLuint depthVertexArray; // Position-only stream for the depth pre-pass; 0 keeps the item out of it
+    glm::mat4 model;    // Sent as "model" when the program has it
+    glm::vec2 lodFade;  // Sent as "lodFade" when the program has it
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    std::function<void()> draw; // Replaces the indexed draw when set
+};
+
+struct DepthPrepassSettings {
+    bool enabled;
+};
+
+// Collects the frame's draws from every subsystem, radix sorts them by a
+// 64-bit key and submits them in order:
+//   pass (4) | program (10) | texture (12) | vertex array (12) | depth (16) | unused (10)
+class CommandList;
+
+class RenderQueue {
+public:
+    RenderQueue();
+
+    // Clears the queue. Depth buckets are measured along the view direction
+    // between the near and far planes.
+    void begin(const glm::mat4& view, float nearPlane, float farPlane);
+
+    // position is the world point the item's depth bucket is taken from
+    void add(DrawItem item, const glm::vec3& position);
+
+    // Program that draws items with a depth vertex array during the pre-pass.
+    // It must transform positions exactly as the shading programs do.
+    void setDepthProgram(ShaderProgram* program);
+
+    // Sorts the keys, records the items into command lists on the job system
+    // and replays them on this thread, which must own the GL context. With the
+    // pre-pass enabled, items that have a depth vertex array first lay down
+    // depth with colour writes off and are then shaded with GL_EQUAL, so each
+    // covered pixel is shaded once. Sort and submit CPU times and the GPU time
+    // of both passes go to the frame stats.
+    void submit();
+
+    size_t size() const;
+
+    // Deletes the GPU timer queries
+    void release();
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    uint64_t makeKey(const DrawItem& item, float depth) const;
+    void sort();
+    void recordDepthPrepass(CommandList& list, size_t begin, size_t end) const;
+    void recordShading(CommandList& list, size_t begin, size_t end, bool prepassed) const;
+
+    glm::mat4 view;
+    float nearPlane;
+    float farPlane;
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    ShaderProgram* depthProgram;
+    GpuTimer prepassTimer;
+    GpuTimer shadingTimer;
+};
+
+namespace DepthPrepass {
+    DepthPrepassSettings& settings();
+
+    // Copies the first three floats of every interleaved vertex into a
+    // position-only buffer and returns a vertex array that reads it as
+    // attribute 0 with the given element buffer
+    GLuint createVertexArray(const void* vertices, size_t vertexCount, size_t stride, GLuint elementBuffer, GLuint& positionBuffer);
+}
+
+#endif // RENDER_QUEUE_H
@@ -0,0 +1,131 @@
+#include "RenderStats.h"
+#include "PropLod.h"
+#include "Impostor.h"
+#include <iostream>
+
+namespace {
+    // Each thread counts its own work; the simulation thread's counters
+    // reach the render thread's frame through merge()
+    thread_local FrameStats current = {};
+    FrameStats accumulated = {};
+    unsigned int framesAccumulated = 0;
+    float periodStart = 0.0f;
+    float lastFramesPerSecond = 0.0f;
+
+    void add(FrameStats& total, const FrameStats& frame) {
+        total.triangles += frame.triangles;
+        total.drawCalls += frame.drawCalls;
+        total.propInstances += frame.propInstances;
+        total.lodCulled += frame.lodCulled;
+        total.lodCrossfades += frame.lodCrossfades;
+        total.impostors += frame.impostors;
+        total.stateCallsIssued += frame.stateCallsIssued;
+        total.stateCallsSkipped += frame.stateCallsSkipped;
+        total.uniformUploads += frame.uniformUploads;
+        total.uniformUploadsSkipped += frame.uniformUploadsSkipped;
+        total.fenceWaitMs += frame.fenceWaitMs;
+        total.frustumTested += frame.frustumTested;
+        total.frustumCulled += frame.frustumCulled;
+        total.horizonTested += frame.horizonTested;
+        total.horizonCulled += frame.horizonCulled;
+        total.occlusionTested += frame.occlusionTested;
+        total.occlusionCulled += frame.occlusionCulled;
+        total.occluderRasterMs += frame.occluderRasterMs;
+        total.queuedDraws += frame.queuedDraws;
+        total.queueSortMs += frame.queueSortMs;
+        total.queueSubmitMs += frame.queueSubmitMs;
+        total.commandLists += frame.commandLists;
+        total.commandsReplayed += frame.commandsReplayed;
+        total.commandRecordMs += frame.commandRecordMs;
+        total.gpuPrepassMs += frame.gpuPrepassMs;
+        total.gpuShadingMs += frame.gpuShadingMs;
+        total.shadowCascadesRendered += frame.shadowCascadesRendered;
+        total.shadowCascadesCached += frame.shadowCascadesCached;
+        total.clusterLights += frame.clusterLights;
+        total.clusterLightIndices += frame.clusterLightIndices;
+        total.clusterBinMs += frame.clusterBinMs;
+        total.overlaySprites += frame.overlaySprites;
+        total.overlayUploadBytes += frame.overlayUploadBytes;
+        total.resolutionScale += frame.resolutionScale;
+        total.gpuSceneMs += frame.gpuSceneMs;
+        total.simulationMs += frame.simulationMs;
+        total.snapshotWaitMs += frame.snapshotWaitMs;
+        total.pipelineLatencyMs += frame.pipelineLatencyMs;
+        total.captureMs += frame.captureMs;
+        total.gpuCullMs += frame.gpuCullMs;
+    }
+}
+
+namespace RenderStats {
+
+FrameStats& frame() {
+    return current;
+}
+
+void beginFrame() {
+    current = {};
+}
+
+void merge(const FrameStats& stats) {
+    add(current, stats);
+}
+
+void endFrame(float currentTime) {
+    add(accumulated, current);
+    framesAccumulated++;
+
+    float elapsed = currentTime - periodStart;
+    if (elapsed < 1.0f)
+        return;
+
+    float frames = static_cast<float>(framesAccumulated);
+    lastFramesPerSecond = frames / elapsed;
+    std::cout << "Frame stats: " << frames / elapsed << " fps, "
+        << accumulated.triangles / framesAccumulated << " triangles/frame, "
+        << accumulated.drawCalls / frames << " draws/frame, "
+        << accumulated.propInstances / frames << " props/frame, "
+        << "LOD " << (PropLod::settings().enabled ? "on" : "off")
+        << " (" << accumulated.lodCulled / frames << " culled, "
+        << accumulated.lodCrossfades / frames << " crossfading), "
+        << "impostors " << (Impostor::settings().enabled ? "on" : "off")
+        << " (" << accumulated.impostors / frames << " drawn), "
+        << "GL state " << accumulated.stateCallsIssued / frames << " issued / "
+        << accumulated.stateCallsSkipped / frames << " skipped, "
+        << "uniforms " << accumulated.uniformUploads / frames << " uploaded / "
+        << accumulated.uniformUploadsSkipped / frames << " skipped, "
+        << "fence wait " << accumulated.fenceWaitMs / frames << " ms/frame, "
+        << "frustum " << (accumulated.frustumTested - accumulated.frustumCulled) / frames << " visible / "
+        << accumulated.frustumCulled / frames << " culled, "
+        << "horizon " << accumulated.horizonCulled / frames << " of " << accumulated.horizonTested / frames << " culled, "
+        << "occlusion " << accumulated.occlusionCulled / frames << " of " << accumulated.occlusionTested / frames << " culled, "
+        << "occluder raster " << accumulated.occluderRasterMs / frames << " ms/frame, "
+        << "queue " << accumulated.queuedDraws / frames << " draws, sort " << accumulated.queueSortMs / frames
+        << " ms, submit " << accumulated.queueSubmitMs / frames << " ms/frame, "
+        << "commands " << accumulated.commandsReplayed / frames << " in " << accumulated.commandLists / frames
+        << " lists, record " << accumulated.commandRecordMs / frames << " ms/frame, "
+        << "GPU depth pre-pass " << accumulated.gpuPrepassMs / frames << " ms, shading " << accumulated.gpuShadingMs / frames << " ms/frame, "
+        << "shadow cascades " << accumulated.shadowCascadesRendered / frames << " rendered, " << accumulated.shadowCascadesCached / frames << " cached/frame, "
+        << "clustered lights " << accumulated.clusterLights / frames << " in " << accumulated.clusterLightIndices / frames
+        << " indices, binning " << accumulated.clusterBinMs / frames << " ms/frame, "
+        << "overlay " << accumulated.overlaySprites / frames << " sprites, " << accumulated.overlayUploadBytes / frames << " bytes uploaded/frame, "
+        << "resolution scale " << accumulated.resolutionScale / frames << " (scene GPU " << accumulated.gpuSceneMs / frames << " ms/frame), "
+        << "simulation " << accumulated.simulationMs / frames << " ms, snapshot wait " << accumulated.snapshotWaitMs / frames
+        << " ms, input latency " << accumulated.pipelineLatencyMs / frames << " ms/frame, "
+        << "capture " << accumulated.captureMs / frames << " ms/frame, "
+        << "GPU culling " << accumulated.gpuCullMs / frames << " ms/frame" << std::endl;
+
+    accumulated = {};
+    framesAccumulated = 0;
+    periodStart = currentTime;
+}
+
+float framesPerSecond() {
+    return lastFramesPerSecond;
+}
+
+void countDraw(GLsizei indexCount, GLsizei instanceCount) {
+    current.triangles += static_cast<unsigned long long>(indexCount / 3) * instanceCount;
+    current.drawCalls++;
+}
+
+}
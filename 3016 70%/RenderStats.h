@@ -0,0 +1,68 @@
+#pragma once
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <glew.h>
+
+// Counters for the frame being rendered, reset by beginFrame. Each thread
+// has its own set.
+struct FrameStats {
+    unsigned long long triangles;
+    unsigned int drawCalls;
+    unsigned int propInstances; // Prop instances submitted
+    unsigned int lodCulled;     // Prop instances below the LOD cull threshold
+    unsigned int lodCrossfades; // Prop instances drawn twice while crossfading
+    unsigned int impostors;     // Prop instances drawn as impostor billboards
+    unsigned int stateCallsIssued;  // GL state calls forwarded by GLState
+    unsigned int stateCallsSkipped; // GL state calls GLState found redundant
+    unsigned int uniformUploads;        // Uniform values sent by ShaderProgram
+    unsigned int uniformUploadsSkipped; // Uniform values equal to the last upload
+    double fenceWaitMs; // CPU time blocked on streaming ring buffer fences
+    unsigned int frustumTested; // Bounding boxes tested against the view frustum
+    unsigned int frustumCulled; // Bounding boxes found outside it
+    unsigned int horizonTested; // Bounding boxes tested against the terrain horizon
+    unsigned int horizonCulled; // Bounding boxes below it
+    unsigned int occlusionTested; // Bounding boxes tested against the occlusion buffer
+    unsigned int occlusionCulled; // Bounding boxes hidden behind the occluders
+    float occluderRasterMs;       // CPU time rasterizing the occluders
+    unsigned int queuedDraws; // Items submitted through the render queue
+    float queueSortMs;        // CPU time radix sorting the queue
+    float queueSubmitMs;      // CPU time recording and replaying the queued draws
+    unsigned int commandLists;     // Command lists recorded, one per batch
+    unsigned int commandsReplayed; // Commands replayed on the GL thread
+    float commandRecordMs;         // Wall time recording command lists on the job system
+    float gpuPrepassMs; // GPU time of the depth pre-pass, a few frames late
+    float gpuShadingMs; // GPU time of the shading pass, a few frames late
+    unsigned int shadowCascadesRendered; // Shadow cascades drawn this frame
+    unsigned int shadowCascadesCached;   // Shadow cascades reused from an earlier frame
+    unsigned int clusterLights;       // Point lights touching at least one cluster
+    unsigned int clusterLightIndices; // Entries in the cluster light index list
+    float clusterBinMs;               // CPU time binning lights into clusters
+    unsigned int overlaySprites;     // Overlay quads drawn, glyphs included
+    unsigned int overlayUploadBytes; // Overlay vertex bytes uploaded; 0 while it is unchanged
+    float resolutionScale; // Fraction of the output size the scene was rendered at
+    float gpuSceneMs;      // GPU time of the scaled scene, a few frames late
+    float simulationMs;      // Simulation thread time producing the frame's snapshot
+    float snapshotWaitMs;    // Render thread time blocked waiting for the snapshot
+    float pipelineLatencyMs; // Input sample to the end of the frame's submission
+    float captureMs; // Render thread time spent on frame capture
+    float gpuCullMs; // GPU time of the depth pyramid and compute culling, a few frames late
+};
+
+namespace RenderStats {
+    FrameStats& frame();
+    void beginFrame();
+
+    // Adds counters gathered on another thread to this thread's frame
+    void merge(const FrameStats& stats);
+
+    // Accumulates the frame and prints per-frame averages once per second
+    void endFrame(float currentTime);
+
+    // Average of the last completed one-second period
+    float framesPerSecond();
+
+    void countDraw(GLsizei indexCount, GLsizei instanceCount = 1);
+}
+
+#endif // RENDER_STATS_H
@@ -0,0 +1,165 @@
+#include "RingBuffer.h"
+#include "RenderStats.h"
+#include "GLStateCache.h"
+#include <chrono>
+#include <iostream>
+
+namespace {
+    GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment) {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+RingBuffer::RingBuffer()
+    : buffer(0), mapped(nullptr), regionSize(0), region(0), head(0) {}
+
+bool RingBuffer::create(GLsizeiptr size, int framesInFlight) {
+    // Regions start on an alignment every binding target accepts
+    regionSize = alignUp(size, 256);
+    GLsizeiptr total = regionSize * framesInFlight;
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glCreateBuffers(1, &buffer);
+    glNamedBufferStorage(buffer, total, nullptr, flags);
+    mapped = static_cast<unsigned char*>(glMapNamedBufferRange(buffer, 0, total, flags));
+    if (!mapped) {
+        std::cerr << "Failed to map the streaming ring buffer" << std::endl;
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+        return false;
+    }
+
+    fences.assign(framesInFlight, nullptr);
+    region = 0;
+    head = 0;
+    return true;
+}
+
+void RingBuffer::release() {
+    for (GLuint old : retired) {
+        glUnmapNamedBuffer(old);
+        glDeleteBuffers(1, &old);
+    }
+    retired.clear();
+    for (auto& fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (buffer) {
+        glUnmapNamedBuffer(buffer);
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+}
+
+void RingBuffer::waitForRegion(int index) {
+    GLsync& fence = fences[index];
+    if (!fence)
+        return;
+
+    auto start = std::chrono::steady_clock::now();
+    GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    for (;;) {
+        GLenum result = glClientWaitSync(fence, waitFlags, 1000000); // 1 ms
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+            break;
+        if (result == GL_WAIT_FAILED) {
+            std::cerr << "Waiting on a ring buffer fence failed" << std::endl;
+            break;
+        }
+        waitFlags = 0; // Commands were flushed by the first wait
+    }
+    RenderStats::frame().fenceWaitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void RingBuffer::advance() {
+    if (fences[region])
+        glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region = (region + 1) % static_cast<int>(fences.size());
+    head = 0;
+}
+
+void RingBuffer::beginFrame() {
+    waitForRegion(region);
+}
+
+// The GL keeps a deleted buffer's storage until the commands reading it
+// complete, so the old buffer only has to outlive this frame's submissions
+bool RingBuffer::grow(GLsizeiptr minimumRegion) {
+    GLsizeiptr newRegionSize = regionSize * 2;
+    while (newRegionSize < minimumRegion)
+        newRegionSize *= 2;
+    retired.push_back(buffer);
+    for (auto& fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    std::cout << "Streaming ring buffer grew to " << newRegionSize << " bytes per frame" << std::endl;
+    return create(newRegionSize, static_cast<int>(fences.size()));
+}
+
+RingAllocation RingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+    if (!mapped)
+        return { nullptr, 0, 0, 0 };
+
+    GLsizeiptr offset = alignUp(head, alignment);
+    if (offset + size > regionSize) {
+        if (!grow(offset + size)) {
+            std::cerr << "Ring buffer allocation of " << size << " bytes failed" << std::endl;
+            return { nullptr, 0, 0, 0 };
+        }
+        offset = 0;
+    }
+    head = offset + size;
+
+    GLintptr absolute = region * regionSize + offset;
+    return { mapped + absolute, buffer, absolute, size };
+}
+
+void RingBuffer::endFrame() {
+    if (mapped)
+        advance();
+    for (GLuint old : retired) {
+        GLState::forgetBuffer(old);
+        glUnmapNamedBuffer(old);
+        glDeleteBuffers(1, &old);
+    }
+    retired.clear();
+}
+
+GLuint RingBuffer::id() const {
+    return buffer;
+}
+
+GLsizeiptr RingBuffer::capacity() const {
+    return regionSize * static_cast<GLsizeiptr>(fences.size());
+}
+
+namespace FrameRing {
+
+RingBuffer& get() {
+    static RingBuffer ring;
+    return ring;
+}
+
+GLsizeiptr uniformAlignment() {
+    static GLint alignment = 0;
+    if (alignment == 0)
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+GLsizeiptr storageAlignment() {
+    static GLint alignment = 0;
+    if (alignment == 0)
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    return alignment;
+}
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <vector>
+#include <glew.h>
+
+// A suballocated range of the ring: write through data, bind buffer at offset
+struct RingAllocation {
+    void* data;
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+// Persistently and coherently mapped buffer split into regions, one per
+// frame in flight. Each region is fenced when the frame ends, and the CPU
+// waits on that fence only when the region comes round again, so uploads
+// never re-specify storage or stall on buffers the GPU is still reading.
+class RingBuffer {
+public:
+    RingBuffer();
+
+    bool create(GLsizeiptr regionSize, int framesInFlight = 3);
+    void release();
+
+    // Waits until the GPU has finished with the region this frame writes
+    void beginFrame();
+
+    // Returns a range aligned to alignment (a power of two). Regions are only
+    // fenced at endFrame, so a frame that outgrows its region moves the ring
+    // to a larger buffer; earlier allocations stay valid in the old one,
+    // which is deleted once the frame is fenced.
+    RingAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16);
+
+    // Fences the commands that read this frame's region
+    void endFrame();
+
+    GLuint id() const;
+    GLsizeiptr capacity() const;
+
+private:
+    void advance();
+    bool grow(GLsizeiptr minimumRegion);
+    void waitForRegion(int index);
+
+    GLuint buffer;
+    unsigned char* mapped;
+    GLsizeiptr regionSize;
+    int region;
+    GLsizeiptr head;
+    std::vector<GLsync> fences;
+    std::vector<GLuint> retired; // Outgrown buffers still read by this frame
+};
+
+// Ring shared by everything that streams data each frame
+namespace FrameRing {
+    RingBuffer& get();
+
+    // Offset alignment required for uniform buffer ranges
+    GLsizeiptr uniformAlignment();
+
+    // Offset alignment required for shader storage buffer ranges
+    GLsizeiptr storageAlignment();
+}
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,187 @@
+#include "ShaderProgram.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <gtc/type_ptr.hpp>
+
+namespace {
+    // Bytes of client data behind one element of a uniform type
+    size_t uniformTypeSize(GLenum type) {
+        switch (type) {
+        case GL_FLOAT: return 4;
+        case GL_FLOAT_VEC2: return 8;
+        case GL_FLOAT_VEC3: return 12;
+        case GL_FLOAT_VEC4: return 16;
+        case GL_FLOAT_MAT3: return 36;
+        case GL_FLOAT_MAT4: return 64;
+        case GL_INT_VEC2: case GL_UNSIGNED_INT_VEC2: return 8;
+        case GL_INT_VEC3: case GL_UNSIGNED_INT_VEC3: return 12;
+        case GL_INT_VEC4: case GL_UNSIGNED_INT_VEC4: return 16;
+        default: return 4; // Scalars, bools and samplers
+        }
+    }
+
+    // Array uniforms are reported as "name[0]"; lookups use the bare name
+    std::string baseName(const char* name) {
+        std::string result(name);
+        size_t bracket = result.find('[');
+        return bracket == std::string::npos ? result : result.substr(0, bracket);
+    }
+}
+
+ShaderProgram::ShaderProgram()
+    : program(0) {}
+
+ShaderProgram::ShaderProgram(GLuint program)
+    : program(program) {
+    if (program != 0)
+        reflect();
+}
+
+GLuint ShaderProgram::id() const {
+    return program;
+}
+
+bool ShaderProgram::valid() const {
+    return program != 0;
+}
+
+void ShaderProgram::use() const {
+    GLState::useProgram(program);
+}
+
+void ShaderProgram::reflect() {
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<GLchar> name(std::max(maxLength, 1));
+
+    for (GLint i = 0; i < count; i++) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, static_cast<GLuint>(i), maxLength, nullptr, &size, &type, name.data());
+
+        // Members of uniform blocks have no location and are set through the block
+        GLint location = glGetUniformLocation(program, name.data());
+        if (location < 0)
+            continue;
+
+        size_t bytes = uniformTypeSize(type) * static_cast<size_t>(size);
+        uniforms.push_back({ ShaderHash::fnv1a(baseName(name.data()).c_str()), location, type, cache.size(), bytes, false });
+        cache.resize(cache.size() + bytes);
+    }
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(std::max(maxLength, 1));
+    for (GLint i = 0; i < count; i++) {
+        GLint dataSize;
+        glGetActiveUniformBlockName(program, static_cast<GLuint>(i), maxLength, nullptr, name.data());
+        glGetActiveUniformBlockiv(program, static_cast<GLuint>(i), GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+        blocks.push_back({ ShaderHash::fnv1a(name.data()), static_cast<GLuint>(i), dataSize });
+    }
+
+    auto byHash = [](const auto& a, const auto& b) { return a.hash < b.hash; };
+    std::sort(uniforms.begin(), uniforms.end(), byHash);
+    std::sort(blocks.begin(), blocks.end(), byHash);
+
+    auto sameHash = [](const auto& a, const auto& b) { return a.hash == b.hash; };
+    if (std::adjacent_find(uniforms.begin(), uniforms.end(), sameHash) != uniforms.end() ||
+        std::adjacent_find(blocks.begin(), blocks.end(), sameHash) != blocks.end()) {
+        std::cerr << "Shader program " << program << ": uniform name hash collision" << std::endl;
+    }
+}
+
+ShaderProgram::Uniform* ShaderProgram::find(uint32_t hash) {
+    auto it = std::lower_bound(uniforms.begin(), uniforms.end(), hash, [](const Uniform& u, uint32_t h) { return u.hash < h; });
+    return it != uniforms.end() && it->hash == hash ? &*it : nullptr;
+}
+
+const ShaderProgram::Uniform* ShaderProgram::find(uint32_t hash) const {
+    return const_cast<ShaderProgram*>(this)->find(hash);
+}
+
+GLint ShaderProgram::location(UniformId uniform) const {
+    const Uniform* u = find(uniform.hash);
+    return u ? u->location : -1;
+}
+
+bool ShaderProgram::has(UniformId uniform) const {
+    return find(uniform.hash) != nullptr;
+}
+
+ShaderProgram::Uniform* ShaderProgram::changed(UniformId uniform, const void* value, size_t size) {
+    Uniform* u = find(uniform.hash);
+    if (!u)
+        return nullptr; // Inactive uniforms are ignored, as glUniform* does for location -1
+
+    unsigned char* cached = cache.data() + u->cacheOffset;
+    size = std::min(size, u->cacheSize);
+    if (u->uploaded && std::memcmp(cached, value, size) == 0) {
+        RenderStats::frame().uniformUploadsSkipped++;
+        return nullptr;
+    }
+    std::memcpy(cached, value, size);
+    u->uploaded = true;
+    RenderStats::frame().uniformUploads++;
+    return u;
+}
+
+void ShaderProgram::setInt(UniformId uniform, int value) {
+    if (Uniform* u = changed(uniform, &value, sizeof(value)))
+        glProgramUniform1i(program, u->location, value);
+}
+
+void ShaderProgram::setFloat(UniformId uniform, float value) {
+    if (Uniform* u = changed(uniform, &value, sizeof(value)))
+        glProgramUniform1f(program, u->location, value);
+}
+
+void ShaderProgram::setVec2(UniformId uniform, const glm::vec2& value) {
+    if (Uniform* u = changed(uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniform2fv(program, u->location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::setVec3(UniformId uniform, const glm::vec3& value) {
+    if (Uniform* u = changed(uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniform3fv(program, u->location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::setVec4(UniformId uniform, const glm::vec4& value) {
+    if (Uniform* u = changed(uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniform4fv(program, u->location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::setMat3(UniformId uniform, const glm::mat3& value) {
+    if (Uniform* u = changed(uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniformMatrix3fv(program, u->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void ShaderProgram::setMat4(UniformId uniform, const glm::mat4& value) {
+    if (Uniform* u = changed(uniform, glm::value_ptr(value), sizeof(value)))
+        glProgramUniformMatrix4fv(program, u->location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+GLuint ShaderProgram::blockIndex(UniformId block) const {
+    auto it = std::lower_bound(blocks.begin(), blocks.end(), block.hash, [](const Block& b, uint32_t h) { return b.hash < h; });
+    return it != blocks.end() && it->hash == block.hash ? it->index : GL_INVALID_INDEX;
+}
+
+void ShaderProgram::bindBlock(UniformId block, GLuint binding) const {
+    GLuint index = blockIndex(block);
+    if (index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, binding);
+}
+
+void ShaderProgram::release() {
+    if (program != 0) {
+        GLState::forgetProgram(program);
+        glDeleteProgram(program);
+    }
+    program = 0;
+    uniforms.clear();
+    blocks.clear();
+    cache.clear();
+}
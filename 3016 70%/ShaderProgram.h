@@ -0,0 +1,85 @@
+#pragma once
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+
+namespace ShaderHash {
+    constexpr uint32_t fnv1a(const char* text, uint32_t hash = 2166136261u) {
+        return *text ? fnv1a(text + 1, (hash ^ static_cast<uint8_t>(*text)) * 16777619u) : hash;
+    }
+}
+
+// Name of a uniform or uniform block, hashed when the program is compiled.
+// String literals convert implicitly: program.setMat4("model", m)
+struct UniformId {
+    uint32_t hash;
+    const char* name;
+
+    consteval UniformId(const char* name)
+        : hash(ShaderHash::fnv1a(name)), name(name) {}
+};
+
+// Linked program with its active uniforms and blocks reflected once.
+// Uploads go through glProgramUniform*, so the program need not be bound,
+// and values equal to the last upload are skipped.
+class ShaderProgram {
+public:
+    ShaderProgram();
+    explicit ShaderProgram(GLuint program); // Takes ownership of a linked program, e.g. from LoadShaders
+
+    GLuint id() const;
+    bool valid() const;
+    void use() const;
+
+    GLint location(UniformId uniform) const;
+    bool has(UniformId uniform) const;
+
+    void setInt(UniformId uniform, int value);
+    void setFloat(UniformId uniform, float value);
+    void setVec2(UniformId uniform, const glm::vec2& value);
+    void setVec3(UniformId uniform, const glm::vec3& value);
+    void setVec4(UniformId uniform, const glm::vec4& value);
+    void setMat3(UniformId uniform, const glm::mat3& value);
+    void setMat4(UniformId uniform, const glm::mat4& value);
+
+    // Uniform block index, or GL_INVALID_INDEX when the block is not active
+    GLuint blockIndex(UniformId block) const;
+    void bindBlock(UniformId block, GLuint binding) const;
+
+    void release();
+
+private:
+    struct Uniform {
+        uint32_t hash;
+        GLint location;
+        GLenum type;
+        size_t cacheOffset; // Last uploaded value in the shadow buffer
+        size_t cacheSize;
+        bool uploaded;
+    };
+
+    struct Block {
+        uint32_t hash;
+        GLuint index;
+        GLint dataSize;
+    };
+
+    void reflect();
+    Uniform* find(uint32_t hash);
+    const Uniform* find(uint32_t hash) const;
+
+    // Returns the uniform when value differs from the cached copy and updates the cache
+    Uniform* changed(UniformId uniform, const void* value, size_t size);
+
+    GLuint program;
+    std::vector<Uniform> uniforms; // Sorted by hash
+    std::vector<Block> blocks;     // Sorted by hash
+    std::vector<unsigned char> cache;
+};
+
+#endif // SHADER_PROGRAM_H
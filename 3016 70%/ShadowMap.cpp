@@ -0,0 +1,243 @@
+#include "ShadowMap.h"
+#include "AssetMemory.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include "RingBuffer.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <gtc/matrix_transform.hpp>
+
+namespace {
+    // Cascade regions are this much wider than the sphere they must cover,
+    // which is how far the camera can move before a cascade re-renders
+    const float kRegionPadding = 1.25f;
+
+    // Blend of logarithmic and uniform split distances
+    const float kSplitLambda = 0.75f;
+
+    // Depth bias applied while rendering casters, on top of the receiver's normal offset
+    const float kSlopeBias = 2.0f;
+    const float kConstantBias = 4.0f;
+
+    bool contains(const Aabb& outer, const Aabb& inner) {
+        return glm::all(glm::lessThanEqual(outer.min, inner.min)) && glm::all(glm::greaterThanEqual(outer.max, inner.max));
+    }
+}
+
+CascadedShadowMap::CascadedShadowMap(int resolution, float shadowDistance)
+    : resolution(resolution), shadowDistance(shadowDistance), depthTexture(0), framebuffer(0),
+      sceneBounds{ glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) }, lightDirection(0.0f), lightView(1.0f),
+      depthNear(0.0f), depthFar(1.0f), cascades{}, uniformData{} {}
+
+bool CascadedShadowMap::create() {
+    glGenTextures(1, &depthTexture);
+    GLState::bindTexture(kShadowTextureUnit, GL_TEXTURE_2D_ARRAY, depthTexture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_DEPTH_COMPONENT24, resolution, resolution, kShadowCascades);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    GLfloat border[4] = { 1.0f, 1.0f, 1.0f, 1.0f }; // Outside the map is lit
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+
+    // Hardware comparison with bilinear filtering gives 2x2 PCF per tap
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &framebuffer);
+    GLState::bindFramebuffer(framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    GLState::bindDefaultFramebuffer();
+
+    if (!complete) {
+        std::cerr << "Shadow map framebuffer is incomplete" << std::endl;
+        release();
+        return false;
+    }
+
+    AssetMemory::track(MemorySubsystem::Shadows, "cascaded shadow map", 0,
+        static_cast<size_t>(resolution) * resolution * 4 * kShadowCascades);
+    invalidate();
+    return true;
+}
+
+void CascadedShadowMap::release() {
+    if (framebuffer)
+        glDeleteFramebuffers(1, &framebuffer);
+    if (depthTexture) {
+        glDeleteTextures(1, &depthTexture);
+        GLState::forgetTexture(depthTexture);
+    }
+    framebuffer = depthTexture = 0;
+}
+
+size_t CascadedShadowMap::addCaster(const ShadowCaster& caster) {
+    casters.push_back(caster);
+    sceneBounds = FrustumCuller::merge(sceneBounds, caster.bounds);
+    updateDepthRange();
+    invalidate();
+    return casters.size() - 1;
+}
+
+void CascadedShadowMap::moveCaster(size_t id, const glm::mat4& model, const Aabb& bounds) {
+    ShadowCaster& caster = casters[id];
+    movedBounds.push_back(caster.bounds);
+    movedBounds.push_back(bounds);
+    caster.model = model;
+    caster.bounds = bounds;
+
+    // A caster leaving the scene bounds widens the depth range of every cascade
+    if (!contains(sceneBounds, bounds)) {
+        sceneBounds = FrustumCuller::merge(sceneBounds, bounds);
+        updateDepthRange();
+        invalidate();
+    }
+}
+
+void CascadedShadowMap::invalidate() {
+    for (auto& cascade : cascades)
+        cascade.valid = false;
+}
+
+// Light-space depth range that holds every caster, so casters behind the
+// camera still shadow what it sees
+void CascadedShadowMap::updateDepthRange() {
+    if (casters.empty())
+        return;
+    float minZ = FLT_MAX, maxZ = -FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 point((corner & 1) ? sceneBounds.max.x : sceneBounds.min.x,
+                        (corner & 2) ? sceneBounds.max.y : sceneBounds.min.y,
+                        (corner & 4) ? sceneBounds.max.z : sceneBounds.min.z);
+        float z = (lightView * glm::vec4(point, 1.0f)).z;
+        minZ = std::min(minZ, z);
+        maxZ = std::max(maxZ, z);
+    }
+    depthNear = -maxZ - 1.0f;
+    depthFar = -minZ + 1.0f;
+}
+
+void CascadedShadowMap::update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, const glm::vec3& direction, ShaderProgram& shadowShader) {
+    const ShadowSettings& settings = Shadows::settings();
+    uniformData.lightDirection = glm::vec4(direction, 0.0f);
+
+    if (settings.enabled && depthTexture) {
+        glm::vec3 light = glm::normalize(direction);
+        if (glm::dot(light, lightDirection) < 0.99999f) {
+            lightDirection = light;
+            glm::vec3 up = std::fabs(light.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            lightView = glm::lookAt(glm::vec3(0.0f), -light, up);
+            updateDepthRange();
+            invalidate();
+        }
+        if (!settings.cacheStatic)
+            invalidate();
+
+        // Every cascade covers the sphere around the camera that holds the
+        // frustum up to its far split, so turning the camera never
+        // invalidates it; only moving does
+        float tanHalfFov = 1.0f / projection[1][1];
+        float aspect = projection[1][1] / projection[0][0];
+        float cornerScale = std::sqrt(1.0f + tanHalfFov * tanHalfFov * (1.0f + aspect * aspect));
+        glm::vec3 eye = glm::vec3(glm::inverse(view)[3]);
+        glm::vec2 eyeLight = glm::vec2(lightView * glm::vec4(eye, 1.0f));
+
+        FrameStats& stats = RenderStats::frame();
+        for (int i = 0; i < kShadowCascades; i++) {
+            float t = static_cast<float>(i + 1) / kShadowCascades;
+            float uniformSplit = nearPlane + (shadowDistance - nearPlane) * t;
+            float logSplit = nearPlane * std::pow(shadowDistance / nearPlane, t);
+            float split = glm::mix(uniformSplit, logSplit, kSplitLambda);
+            float radius = split * cornerScale;
+
+            Cascade& cascade = cascades[i];
+            glm::vec2 offset = glm::abs(eyeLight - cascade.center) + radius;
+            bool stale = !cascade.valid || offset.x > cascade.halfSize || offset.y > cascade.halfSize;
+            if (stale) {
+                // Snapping the centre to whole texels keeps edges from crawling on re-render
+                float halfSize = radius * kRegionPadding;
+                float texel = 2.0f * halfSize / resolution;
+                cascade.center = glm::floor(eyeLight / texel + 0.5f) * texel;
+                cascade.halfSize = halfSize;
+                glm::mat4 ortho = glm::ortho(cascade.center.x - halfSize, cascade.center.x + halfSize,
+                    cascade.center.y - halfSize, cascade.center.y + halfSize, depthNear, depthFar);
+                cascade.viewProjection = ortho * lightView;
+                cascade.frustum = FrustumCuller::extract(cascade.viewProjection);
+            }
+            for (size_t m = 0; m < movedBounds.size() && !stale; m++)
+                stale = FrustumCuller::intersects(cascade.frustum, movedBounds[m]);
+
+            if (stale) {
+                render(i, shadowShader);
+                cascade.valid = true;
+                stats.shadowCascadesRendered++;
+            }
+            else {
+                stats.shadowCascadesCached++;
+            }
+
+            uniformData.lightViewProjection[i] = cascade.viewProjection;
+            uniformData.cascadeEnds[i] = split;
+            uniformData.cascadeTexelSize[i] = 2.0f * cascade.halfSize / resolution;
+        }
+        uniformData.lightDirection.w = 1.0f;
+        GLState::bindTexture(kShadowTextureUnit, GL_TEXTURE_2D_ARRAY, depthTexture);
+    }
+    movedBounds.clear();
+
+    // Receivers read the block even with shadows off, where w tells them to skip the lookup
+    RingAllocation block = FrameRing::get().allocate(sizeof(ShadowUniformData), FrameRing::uniformAlignment());
+    if (!block.data)
+        return;
+    std::memcpy(block.data, &uniformData, sizeof(ShadowUniformData));
+    GLState::bindBufferRange(GL_UNIFORM_BUFFER, kShadowUniformBinding, block.buffer, block.offset, block.size);
+}
+
+void CascadedShadowMap::render(int index, ShaderProgram& shadowShader) {
+    const Cascade& cascade = cascades[index];
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLState::bindFramebuffer(framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, index);
+    GLState::viewport(0, 0, resolution, resolution);
+    GLState::depthMask(true);
+    GLState::depthFunc(GL_LESS);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    GLState::setEnabled(GL_POLYGON_OFFSET_FILL, true);
+    glPolygonOffset(kSlopeBias, kConstantBias);
+
+    shadowShader.use();
+    shadowShader.setMat4("lightViewProjection", cascade.viewProjection);
+    for (const auto& caster : casters) {
+        if (!FrustumCuller::intersects(cascade.frustum, caster.bounds))
+            continue;
+        shadowShader.setMat4("model", caster.model);
+        GLState::bindVertexArray(caster.vertexArray);
+        glDrawElements(GL_TRIANGLES, caster.indexCount, GL_UNSIGNED_INT, (void*)(caster.indexOffset * sizeof(unsigned int)));
+        RenderStats::countDraw(caster.indexCount);
+    }
+
+    GLState::setEnabled(GL_POLYGON_OFFSET_FILL, false);
+    GLState::bindDefaultFramebuffer();
+    GLState::viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+GLuint CascadedShadowMap::texture() const {
+    return depthTexture;
+}
+
+namespace Shadows {
+
+ShadowSettings& settings() {
+    static ShadowSettings shadowSettings = { true, true };
+    return shadowSettings;
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "FrustumCuller.h"
+#include "ShaderProgram.h"
+
+// Uniform buffer binding point of the ShadowData block in receiving shaders
+const GLuint kShadowUniformBinding = 1;
+
+// Texture unit the shadow map array is bound to
+const GLuint kShadowTextureUnit = 1;
+
+const int kShadowCascades = 4;
+
+// std140 mirror of the ShadowData block
+struct ShadowUniformData {
+    glm::mat4 lightViewProjection[kShadowCascades];
+    glm::vec4 cascadeEnds;      // View-space distance where each cascade ends
+    glm::vec4 cascadeTexelSize; // World size of one shadow texel per cascade
+    glm::vec4 lightDirection;   // xyz towards the light, w is 1 when shadows are on
+};
+
+static_assert(sizeof(ShadowUniformData) == kShadowCascades * 64 + 3 * 16, "ShadowUniformData must match the std140 ShadowData block");
+
+struct ShadowSettings {
+    bool enabled;
+    bool cacheStatic; // Off re-renders every cascade every frame, for comparison
+};
+
+// Geometry drawn into the shadow map: a range of a position-only vertex array
+struct ShadowCaster {
+    GLuint vertexArray;
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    glm::mat4 model;
+    Aabb bounds; // World box
+};
+
+// Cascaded shadow map for the directional light. Every cascade covers a
+// padded, texel-snapped square in light space around its slice of the view
+// frustum and keeps its depth until the light changes, a caster inside it
+// moves, or the camera leaves the padding. A scene without moving casters
+// therefore re-renders a cascade only when the camera has travelled a
+// fraction of its width.
+class CascadedShadowMap {
+public:
+    CascadedShadowMap(int resolution = 1024, float shadowDistance = 150.0f);
+
+    bool create();
+    void release();
+
+    // Returns the id moveCaster takes
+    size_t addCaster(const ShadowCaster& caster);
+
+    // Cascades that contained the caster before or contain it now re-render
+    // on the next update
+    void moveCaster(size_t id, const glm::mat4& model, const Aabb& bounds);
+
+    // Forces every cascade to re-render, for changes the map cannot see
+    void invalidate();
+
+    // Fits the cascades to the camera, re-renders the stale ones with the
+    // shadow program and uploads and binds the ShadowData block. lightDirection
+    // points towards the light.
+    void update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, const glm::vec3& lightDirection, ShaderProgram& shadowShader);
+
+    GLuint texture() const;
+
+private:
+    struct Cascade {
+        glm::mat4 viewProjection;
+        Frustum frustum;
+        glm::vec2 center; // Light-space centre of the rendered square
+        float halfSize;
+        bool valid;
+    };
+
+    void updateDepthRange();
+    void render(int index, ShaderProgram& shadowShader);
+
+    int resolution;
+    float shadowDistance;
+    GLuint depthTexture;
+    GLuint framebuffer;
+    std::vector<ShadowCaster> casters;
+    std::vector<Aabb> movedBounds; // Old and new boxes of casters moved since the last update
+    Aabb sceneBounds;
+    glm::vec3 lightDirection;
+    glm::mat4 lightView;
+    float depthNear, depthFar;
+    Cascade cascades[kShadowCascades];
+    ShadowUniformData uniformData;
+};
+
+namespace Shadows {
+    ShadowSettings& settings();
+}
+
+#endif // SHADOW_MAP_H
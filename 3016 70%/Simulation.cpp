@@ -0,0 +1,93 @@
+#include "Simulation.h"
+
+SimulationThread::SimulationThread(UpdateFunction update)
+    : update(std::move(update)), pendingInput{}, inputPending(false), stopping(false), produced(0), consumed(0) {}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (!thread.joinable())
+        thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    inputReady.notify_all();
+    if (thread.joinable())
+        thread.join();
+    stopping = false;
+}
+
+void SimulationThread::submit(const SimulationInput& input) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingInput = input;
+        pendingInput.sampleTime = std::chrono::steady_clock::now();
+        inputPending = true;
+    }
+    inputReady.notify_one();
+}
+
+const FrameSnapshot& SimulationThread::acquire() {
+    auto start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    snapshotReady.wait(lock, [&] { return produced > consumed; });
+    RenderStats::frame().snapshotWaitMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return snapshots[consumed % 2];
+}
+
+void SimulationThread::release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    const FrameSnapshot& snapshot = snapshots[consumed % 2];
+    RenderStats::merge(snapshot.stats);
+    FrameStats& stats = RenderStats::frame();
+    stats.simulationMs += snapshot.simulationMs;
+    stats.pipelineLatencyMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - snapshot.sampleTime).count();
+    consumed++;
+}
+
+void SimulationThread::run() {
+    for (;;) {
+        SimulationInput input;
+        FrameSnapshot* snapshot;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            inputReady.wait(lock, [&] { return stopping || inputPending; });
+            if (stopping)
+                return;
+            input = pendingInput;
+            inputPending = false;
+            snapshot = &snapshots[produced % 2];
+        }
+
+        // Counters of the update land in this thread's frame and travel with the snapshot
+        auto start = std::chrono::steady_clock::now();
+        RenderStats::beginFrame();
+        update(input, *snapshot);
+        snapshot->frame = input.frame;
+        snapshot->time = input.time;
+        snapshot->sampleTime = input.sampleTime;
+        snapshot->stats = RenderStats::frame();
+        snapshot->simulationMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            produced++;
+        }
+        snapshotReady.notify_one();
+    }
+}
+
+namespace Simulation {
+
+SimulationSettings& settings() {
+    static SimulationSettings simulationSettings = { true };
+    return simulationSettings;
+}
+
+}
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <glm.hpp>
+#include "Camera.h"
+#include "LightClusters.h"
+#include "RenderStats.h"
+
+// What the render thread samples for one frame: the clock, the window input
+// and the toggles the simulation acts on
+struct SimulationInput {
+    int frame;
+    float time; // Seconds; headless runs advance it by a fixed step
+    float deltaTime;
+    CameraInput movement;
+    glm::vec2 mouseOffset; // Cursor movement since the previous sample
+    glm::mat4 projection;  // Follows the framebuffer's aspect ratio at the sample
+    bool occlusionCulling;
+    bool horizonCulling;
+    bool gpuCulling; // The render thread culls the swords, so the simulation skips them
+    std::chrono::steady_clock::time_point sampleTime; // Set by submit()
+};
+
+// Everything the render thread needs from the simulation for one frame.
+// Written by the simulation thread only, and read-only once published.
+struct FrameSnapshot {
+    int frame;
+    float time;
+    glm::vec3 cameraPosition;
+    glm::mat4 view;
+    glm::mat4 projection;
+    std::vector<uint32_t> visibleChunks;
+    std::vector<uint32_t> visibleSwords1;
+    std::vector<uint32_t> visibleSwords2;
+    bool gpuCullSwords; // Swords left to the compute culling; the lists above are empty
+    std::vector<uint32_t> visibleKeys;
+    std::vector<PointLight> pointLights;
+    FrameStats stats; // Counters of the simulation work, merged into the rendered frame
+    std::chrono::steady_clock::time_point sampleTime;
+    float simulationMs;
+};
+
+struct SimulationSettings {
+    bool pipelined; // Simulate frame N+1 while frame N is submitted
+};
+
+// Runs the per-frame update on its own thread and hands the render thread
+// double-buffered snapshots. The render thread submits the input of the
+// next frame while it still holds the current snapshot, so the update of
+// frame N+1 overlaps the GL submission of frame N:
+//
+//   submit(0); loop { acquire(); submit(n + 1); render; release(); }
+//
+// At most one input may be outstanding, which keeps the snapshot being
+// written apart from the one being read.
+class SimulationThread {
+public:
+    using UpdateFunction = std::function<void(const SimulationInput& input, FrameSnapshot& snapshot)>;
+
+    SimulationThread(UpdateFunction update);
+    ~SimulationThread();
+
+    void start();
+
+    // Joins the thread; a snapshot still being simulated is finished first
+    void stop();
+
+    // Queues the input of the next snapshot and returns at once
+    void submit(const SimulationInput& input);
+
+    // Waits for the oldest unread snapshot. It stays valid until release().
+    const FrameSnapshot& acquire();
+
+    // Returns the snapshot and records the simulation's counters, time and
+    // the input-to-submission latency in this thread's frame stats
+    void release();
+
+private:
+    void run();
+
+    UpdateFunction update;
+    FrameSnapshot snapshots[2];
+    SimulationInput pendingInput;
+    bool inputPending;
+    bool stopping;
+    unsigned long long produced; // Snapshots published
+    unsigned long long consumed; // Snapshots released
+    std::mutex mutex;
+    std::condition_variable inputReady;
+    std::condition_variable snapshotReady;
+    std::thread thread;
+};
+
+namespace Simulation {
+    SimulationSettings& settings();
+}
+
+#endif // SIMULATION_H
@@ -0,0 +1,364 @@
+#include "SpriteBatch.h"
+#include "AssetMemory.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <gtc/packing.hpp>
+
+namespace {
+    const int kGlyphWidth = 8;
+    const int kGlyphHeight = 13;
+    const int kGlyphAdvance = 7;
+    const int kLineHeight = 15;
+    const char kFirstGlyph = ' ';
+    const char kLastGlyph = '~';
+
+    // Empty texels between atlas regions so filtering never reads a neighbour
+    const int kPadding = 1;
+
+    // Printable ASCII, one byte per row with the leftmost pixel in the high
+    // bit; DejaVu Sans Mono rendered monochrome at 12 pixels, baseline on row 10
+    const uint8_t kGlyphRows[kLastGlyph - kFirstGlyph + 1][kGlyphHeight] = {
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // space
+        { 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00 }, // !
+        { 0x00, 0x28, 0x28, 0x28, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // "
+        { 0x00, 0x00, 0x14, 0x24, 0x7e, 0x28, 0x28, 0xfc, 0x48, 0x50, 0x00, 0x00, 0x00 }, // #
+        { 0x00, 0x10, 0x38, 0x54, 0x50, 0x70, 0x1c, 0x14, 0x54, 0x38, 0x10, 0x10, 0x00 }, // $
+        { 0x00, 0x60, 0x90, 0x90, 0x64, 0x18, 0x6c, 0x12, 0x12, 0x0c, 0x00, 0x00, 0x00 }, // %
+        { 0x00, 0x1c, 0x20, 0x20, 0x30, 0x30, 0x4a, 0x4e, 0x64, 0x3a, 0x00, 0x00, 0x00 }, // &
+        { 0x00, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // '
+        { 0x0c, 0x08, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x08, 0x08, 0x0c, 0x00, 0x00 }, // (
+        { 0x30, 0x10, 0x10, 0x08, 0x08, 0x08, 0x08, 0x08, 0x10, 0x10, 0x30, 0x00, 0x00 }, // )
+        { 0x00, 0x10, 0x54, 0x38, 0x38, 0x54, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // *
+        { 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0xfe, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // +
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x20, 0x00, 0x00 }, // ,
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // -
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00 }, // .
+        { 0x00, 0x02, 0x04, 0x04, 0x08, 0x08, 0x10, 0x10, 0x20, 0x20, 0x40, 0x00, 0x00 }, // /
+        { 0x00, 0x3c, 0x24, 0x42, 0x42, 0x4a, 0x42, 0x42, 0x24, 0x3c, 0x00, 0x00, 0x00 }, // 0
+        { 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7c, 0x00, 0x00, 0x00 }, // 1
+        { 0x00, 0x3c, 0x42, 0x02, 0x02, 0x04, 0x08, 0x10, 0x20, 0x7e, 0x00, 0x00, 0x00 }, // 2
+        { 0x00, 0x3c, 0x42, 0x02, 0x02, 0x1c, 0x02, 0x02, 0x42, 0x3c, 0x00, 0x00, 0x00 }, // 3
+        { 0x00, 0x0c, 0x0c, 0x14, 0x34, 0x24, 0x44, 0x7e, 0x04, 0x04, 0x00, 0x00, 0x00 }, // 4
+        { 0x00, 0x7c, 0x40, 0x40, 0x7c, 0x06, 0x02, 0x02, 0x46, 0x3c, 0x00, 0x00, 0x00 }, // 5
+        { 0x00, 0x1c, 0x22, 0x40, 0x5c, 0x66, 0x42, 0x42, 0x26, 0x3c, 0x00, 0x00, 0x00 }, // 6
+        { 0x00, 0x7e, 0x06, 0x04, 0x04, 0x08, 0x08, 0x10, 0x10, 0x20, 0x00, 0x00, 0x00 }, // 7
+        { 0x00, 0x3c, 0x42, 0x42, 0x42, 0x3c, 0x42, 0x42, 0x42, 0x3c, 0x00, 0x00, 0x00 }, // 8
+        { 0x00, 0x3c, 0x64, 0x42, 0x42, 0x46, 0x3a, 0x02, 0x44, 0x38, 0x00, 0x00, 0x00 }, // 9
+        { 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00 }, // :
+        { 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x00, 0x00, 0x10, 0x10, 0x20, 0x00, 0x00 }, // ;
+        { 0x00, 0x00, 0x00, 0x02, 0x1c, 0x60, 0x60, 0x1c, 0x02, 0x00, 0x00, 0x00, 0x00 }, // <
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x00, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00 }, // =
+        { 0x00, 0x00, 0x00, 0x40, 0x38, 0x06, 0x06, 0x38, 0x40, 0x00, 0x00, 0x00, 0x00 }, // >
+        { 0x00, 0x1c, 0x22, 0x02, 0x0c, 0x18, 0x10, 0x00, 0x10, 0x10, 0x00, 0x00, 0x00 }, // ?
+        { 0x00, 0x00, 0x1c, 0x26, 0x42, 0x4e, 0x52, 0x52, 0x4e, 0x60, 0x20, 0x1c, 0x00 }, // @
+        { 0x00, 0x18, 0x18, 0x18, 0x24, 0x24, 0x24, 0x3c, 0x42, 0x42, 0x00, 0x00, 0x00 }, // A
+        { 0x00, 0x7c, 0x42, 0x42, 0x42, 0x7c, 0x42, 0x42, 0x42, 0x7c, 0x00, 0x00, 0x00 }, // B
+        { 0x00, 0x1c, 0x22, 0x40, 0x40, 0x40, 0x40, 0x40, 0x22, 0x1c, 0x00, 0x00, 0x00 }, // C
+        { 0x00, 0x78, 0x44, 0x42, 0x42, 0x42, 0x42, 0x42, 0x44, 0x78, 0x00, 0x00, 0x00 }, // D
+        { 0x00, 0x7e, 0x40, 0x40, 0x40, 0x7e, 0x40, 0x40, 0x40, 0x7e, 0x00, 0x00, 0x00 }, // E
+        { 0x00, 0x7e, 0x40, 0x40, 0x40, 0x7e, 0x40, 0x40, 0x40, 0x40, 0x00, 0x00, 0x00 }, // F
+        { 0x00, 0x1c, 0x22, 0x40, 0x40, 0x46, 0x42, 0x42, 0x22, 0x1c, 0x00, 0x00, 0x00 }, // G
+        { 0x00, 0x42, 0x42, 0x42, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 }, // H
+        { 0x00, 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7c, 0x00, 0x00, 0x00 }, // I
+        { 0x00, 0x1c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x44, 0x38, 0x00, 0x00, 0x00 }, // J
+        { 0x00, 0x42, 0x44, 0x48, 0x50, 0x70, 0x48, 0x4c, 0x44, 0x42, 0x00, 0x00, 0x00 }, // K
+        { 0x00, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x7e, 0x00, 0x00, 0x00 }, // L
+        { 0x00, 0x42, 0x66, 0x66, 0x5a, 0x5a, 0x5a, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 }, // M
+        { 0x00, 0x62, 0x62, 0x52, 0x52, 0x5a, 0x4a, 0x4a, 0x46, 0x46, 0x00, 0x00, 0x00 }, // N
+        { 0x00, 0x3c, 0x24, 0x42, 0x42, 0x42, 0x42, 0x42, 0x24, 0x3c, 0x00, 0x00, 0x00 }, // O
+        { 0x00, 0x7c, 0x42, 0x42, 0x42, 0x7c, 0x40, 0x40, 0x40, 0x40, 0x00, 0x00, 0x00 }, // P
+        { 0x00, 0x3c, 0x24, 0x42, 0x42, 0x42, 0x42, 0x42, 0x26, 0x3c, 0x04, 0x04, 0x00 }, // Q
+        { 0x00, 0x7c, 0x42, 0x42, 0x42, 0x7c, 0x44, 0x42, 0x42, 0x41, 0x00, 0x00, 0x00 }, // R
+        { 0x00, 0x3c, 0x42, 0x40, 0x60, 0x3c, 0x02, 0x02, 0x42, 0x3c, 0x00, 0x00, 0x00 }, // S
+        { 0x00, 0xfe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // T
+        { 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x3c, 0x00, 0x00, 0x00 }, // U
+        { 0x00, 0x42, 0x42, 0x24, 0x24, 0x24, 0x24, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 }, // V
+        { 0x00, 0x82, 0x92, 0x92, 0xaa, 0xaa, 0xaa, 0x6c, 0x44, 0x44, 0x00, 0x00, 0x00 }, // W
+        { 0x00, 0x42, 0x24, 0x24, 0x18, 0x18, 0x18, 0x24, 0x24, 0x42, 0x00, 0x00, 0x00 }, // X
+        { 0x00, 0x82, 0x44, 0x28, 0x28, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // Y
+        { 0x00, 0x7e, 0x06, 0x04, 0x08, 0x18, 0x10, 0x20, 0x60, 0x7e, 0x00, 0x00, 0x00 }, // Z
+        { 0x18, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x00, 0x00 }, // [
+        { 0x00, 0x40, 0x20, 0x20, 0x10, 0x10, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00, 0x00 }, // backslash
+        { 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x30, 0x00, 0x00 }, // ]
+        { 0x00, 0x30, 0x48, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ^
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xfe }, // _
+        { 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // `
+        { 0x00, 0x00, 0x00, 0x38, 0x44, 0x04, 0x3c, 0x44, 0x44, 0x3c, 0x00, 0x00, 0x00 }, // a
+        { 0x40, 0x40, 0x40, 0x78, 0x44, 0x44, 0x44, 0x44, 0x44, 0x78, 0x00, 0x00, 0x00 }, // b
+        { 0x00, 0x00, 0x00, 0x38, 0x64, 0x40, 0x40, 0x40, 0x60, 0x3c, 0x00, 0x00, 0x00 }, // c
+        { 0x04, 0x04, 0x04, 0x3c, 0x44, 0x44, 0x44, 0x44, 0x44, 0x3c, 0x00, 0x00, 0x00 }, // d
+        { 0x00, 0x00, 0x00, 0x38, 0x64, 0x44, 0x7c, 0x40, 0x44, 0x38, 0x00, 0x00, 0x00 }, // e
+        { 0x0c, 0x10, 0x10, 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 }, // f
+        { 0x00, 0x00, 0x00, 0x3c, 0x44, 0x44, 0x44, 0x44, 0x44, 0x3c, 0x04, 0x24, 0x18 }, // g
+        { 0x40, 0x40, 0x40, 0x58, 0x64, 0x44, 0x44, 0x44, 0x44, 0x44, 0x00, 0x00, 0x00 }, // h
+        { 0x10, 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x7c, 0x00, 0x00, 0x00 }, // i
+        { 0x08, 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x30 }, // j
+        { 0x40, 0x40, 0x40, 0x44, 0x48, 0x50, 0x60, 0x50, 0x48, 0x44, 0x00, 0x00, 0x00 }, // k
+        { 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x0c, 0x00, 0x00, 0x00 }, // l
+        { 0x00, 0x00, 0x00, 0x7c, 0x54, 0x54, 0x54, 0x54, 0x54, 0x54, 0x00, 0x00, 0x00 }, // m
+        { 0x00, 0x00, 0x00, 0x58, 0x64, 0x44, 0x44, 0x44, 0x44, 0x44, 0x00, 0x00, 0x00 }, // n
+        { 0x00, 0x00, 0x00, 0x38, 0x44, 0x44, 0x44, 0x44, 0x44, 0x38, 0x00, 0x00, 0x00 }, // o
+        { 0x00, 0x00, 0x00, 0x78, 0x44, 0x44, 0x44, 0x44, 0x44, 0x78, 0x40, 0x40, 0x40 }, // p
+        { 0x00, 0x00, 0x00, 0x3c, 0x44, 0x44, 0x44, 0x44, 0x44, 0x3c, 0x04, 0x04, 0x04 }, // q
+        { 0x00, 0x00, 0x00, 0x3c, 0x32, 0x20, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00 }, // r
+        { 0x00, 0x00, 0x00, 0x38, 0x44, 0x40, 0x38, 0x04, 0x44, 0x38, 0x00, 0x00, 0x00 }, // s
+        { 0x00, 0x10, 0x10, 0x7c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1c, 0x00, 0x00, 0x00 }, // t
+        { 0x00, 0x00, 0x00, 0x44, 0x44, 0x44, 0x44, 0x44, 0x44, 0x3c, 0x00, 0x00, 0x00 }, // u
+        { 0x00, 0x00, 0x00, 0x44, 0x44, 0x28, 0x28, 0x28, 0x10, 0x10, 0x00, 0x00, 0x00 }, // v
+        { 0x00, 0x00, 0x00, 0x82, 0x82, 0x54, 0x54, 0x6c, 0x28, 0x28, 0x00, 0x00, 0x00 }, // w
+        { 0x00, 0x00, 0x00, 0x44, 0x28, 0x28, 0x10, 0x28, 0x28, 0x44, 0x00, 0x00, 0x00 }, // x
+        { 0x00, 0x00, 0x00, 0x44, 0x44, 0x28, 0x28, 0x28, 0x30, 0x10, 0x10, 0x20, 0x60 }, // y
+        { 0x00, 0x00, 0x00, 0x7c, 0x04, 0x08, 0x10, 0x20, 0x40, 0x7c, 0x00, 0x00, 0x00 }, // z
+        { 0x1c, 0x10, 0x10, 0x10, 0x10, 0x60, 0x10, 0x10, 0x10, 0x10, 0x1c, 0x00, 0x00 }, // {
+        { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00 }, // |
+        { 0x70, 0x10, 0x10, 0x10, 0x10, 0x0c, 0x10, 0x10, 0x10, 0x10, 0x70, 0x00, 0x00 }, // }
+        { 0x00, 0x00, 0x00, 0x00, 0x00, 0x70, 0x0e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }, // ~
+    };
+}
+
+SpriteBatch::SpriteBatch(int atlasSize, int maxSprites)
+    : atlasSize(atlasSize), maxSprites(maxSprites), atlasTexture(0), VAO(0), VBO(0), EBO(0),
+      shelfX(kPadding), shelfY(kPadding), shelfHeight(0), firstGlyph(-1), overflowed(false) {}
+
+bool SpriteBatch::create() {
+    glGenTextures(1, &atlasTexture);
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, atlasSize, atlasSize);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    std::vector<unsigned char> clear(static_cast<size_t>(atlasSize) * atlasSize * 4, 0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, atlasSize, atlasSize, GL_RGBA, GL_UNSIGNED_BYTE, clear.data());
+    AssetMemory::track(MemorySubsystem::Textures, "overlay atlas", 0, AssetMemory::textureBytes(atlasSize, atlasSize, 4, false));
+
+    // Glyphs are white with the bitmap in alpha, so the sprite tint colours them
+    unsigned char glyph[kGlyphWidth * kGlyphHeight * 4];
+    for (char c = kFirstGlyph; c <= kLastGlyph; c++) {
+        const uint8_t* rows = kGlyphRows[c - kFirstGlyph];
+        for (int y = 0; y < kGlyphHeight; y++) {
+            for (int x = 0; x < kGlyphWidth; x++) {
+                unsigned char* texel = &glyph[(y * kGlyphWidth + x) * 4];
+                texel[0] = texel[1] = texel[2] = 255;
+                texel[3] = (rows[y] >> (kGlyphWidth - 1 - x)) & 1 ? 255 : 0;
+            }
+        }
+        int id = addRegion(glyph, kGlyphWidth, kGlyphHeight);
+        if (c == kFirstGlyph)
+            firstGlyph = id;
+    }
+
+    // Quads share one static index buffer; only the corners stream
+    std::vector<unsigned int> indices(static_cast<size_t>(maxSprites) * 6);
+    for (unsigned int i = 0; i < static_cast<unsigned int>(maxSprites); i++) {
+        unsigned int quad[] = { i * 4, i * 4 + 1, i * 4 + 2, i * 4 + 2, i * 4 + 1, i * 4 + 3 };
+        std::copy(quad, quad + 6, &indices[i * 6]);
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    GLState::bindVertexArray(VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(maxSprites) * 4 * sizeof(SpriteVertex), nullptr, GL_DYNAMIC_DRAW);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, texCoord));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, color));
+    glEnableVertexAttribArray(2);
+    GLState::bindVertexArray(0);
+
+    return firstGlyph >= 0;
+}
+
+void SpriteBatch::release() {
+    if (VAO) {
+        glDeleteVertexArrays(1, &VAO);
+        GLState::forgetVertexArray(VAO);
+    }
+    if (VBO) {
+        glDeleteBuffers(1, &VBO);
+        GLState::forgetBuffer(VBO);
+    }
+    if (EBO) {
+        glDeleteBuffers(1, &EBO);
+        GLState::forgetBuffer(EBO);
+    }
+    if (atlasTexture) {
+        glDeleteTextures(1, &atlasTexture);
+        GLState::forgetTexture(atlasTexture);
+    }
+    VAO = VBO = EBO = atlasTexture = 0;
+    uploaded.clear();
+}
+
+// Shelf packer: regions fill rows left to right, a new row starts above the
+// tallest region of the current one
+bool SpriteBatch::pack(int width, int height, glm::ivec2& origin) {
+    if (shelfX + width + kPadding > atlasSize) {
+        shelfY += shelfHeight + kPadding;
+        shelfX = kPadding;
+        shelfHeight = 0;
+    }
+    if (width + 2 * kPadding > atlasSize || shelfY + height + kPadding > atlasSize)
+        return false;
+
+    origin = glm::ivec2(shelfX, shelfY);
+    shelfX += width + kPadding;
+    shelfHeight = std::max(shelfHeight, height);
+    return true;
+}
+
+int SpriteBatch::addRegion(const unsigned char* rgba, int width, int height) {
+    glm::ivec2 origin;
+    if (!pack(width, height, origin)) {
+        std::cerr << "Overlay atlas is full, dropping a " << width << "x" << height << " image" << std::endl;
+        return -1;
+    }
+    GLState::bindTexture(0, GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, origin.x, origin.y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    float texel = 1.0f / atlasSize;
+    regions.push_back({ glm::vec2(origin) * texel, glm::vec2(origin + glm::ivec2(width, height)) * texel, glm::ivec2(width, height) });
+    return static_cast<int>(regions.size() - 1);
+}
+
+int SpriteBatch::addImage(const unsigned char* pixels, int sourceWidth, int sourceHeight, int channels, int width, int height) {
+    if (!pixels || width <= 0 || height <= 0)
+        return -1;
+
+    // Every target texel averages the source texels its footprint covers
+    std::vector<unsigned char> rgba(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; y++) {
+        int y0 = y * sourceHeight / height;
+        int y1 = std::max((y + 1) * sourceHeight / height, y0 + 1);
+        for (int x = 0; x < width; x++) {
+            int x0 = x * sourceWidth / width;
+            int x1 = std::max((x + 1) * sourceWidth / width, x0 + 1);
+            unsigned int sum[4] = { 0, 0, 0, 0 };
+            for (int sy = y0; sy < y1; sy++) {
+                for (int sx = x0; sx < x1; sx++) {
+                    const unsigned char* source = &pixels[(static_cast<size_t>(sy) * sourceWidth + sx) * channels];
+                    for (int c = 0; c < 4; c++) {
+                        if (c == 3)
+                            sum[c] += channels == 4 ? source[3] : 255;
+                        else
+                            sum[c] += source[channels >= 3 ? c : 0];
+                    }
+                }
+            }
+            unsigned int count = static_cast<unsigned int>((y1 - y0) * (x1 - x0));
+            for (int c = 0; c < 4; c++)
+                rgba[(static_cast<size_t>(y) * width + x) * 4 + c] = static_cast<unsigned char>(sum[c] / count);
+        }
+    }
+    return addRegion(rgba.data(), width, height);
+}
+
+const SpriteRegion& SpriteBatch::region(int sprite) const {
+    return regions[sprite];
+}
+
+void SpriteBatch::begin() {
+    vertices.clear();
+}
+
+void SpriteBatch::addQuad(const glm::vec2& position, const glm::vec2& size, const SpriteRegion& region, uint32_t color) {
+    if (vertices.size() / 4 >= static_cast<size_t>(maxSprites)) {
+        if (!overflowed)
+            std::cerr << "Overlay holds more than " << maxSprites << " sprites, dropping the rest" << std::endl;
+        overflowed = true;
+        return;
+    }
+    glm::vec2 end = position + size;
+    vertices.push_back({ position, region.uvMin, color });
+    vertices.push_back({ glm::vec2(end.x, position.y), glm::vec2(region.uvMax.x, region.uvMin.y), color });
+    vertices.push_back({ glm::vec2(position.x, end.y), glm::vec2(region.uvMin.x, region.uvMax.y), color });
+    vertices.push_back({ end, region.uvMax, color });
+}
+
+void SpriteBatch::sprite(int sprite, const glm::vec2& position, const glm::vec2& size, const glm::vec4& color) {
+    if (sprite < 0 || sprite >= static_cast<int>(regions.size()))
+        return;
+    addQuad(position, size, regions[sprite], glm::packUnorm4x8(color));
+}
+
+glm::vec2 SpriteBatch::text(const std::string& text, const glm::vec2& position, int scale, const glm::vec4& color) {
+    uint32_t packed = glm::packUnorm4x8(color);
+    glm::vec2 pen = glm::round(position);
+    glm::vec2 extent = pen;
+    glm::vec2 cell(static_cast<float>(kGlyphWidth * scale), static_cast<float>(kGlyphHeight * scale));
+    for (char c : text) {
+        if (c == '\n') {
+            pen = glm::vec2(glm::round(position.x), pen.y + kLineHeight * scale);
+            continue;
+        }
+        if (c < kFirstGlyph || c > kLastGlyph)
+            c = '?';
+        if (c != ' ')
+            addQuad(pen, cell, regions[firstGlyph + (c - kFirstGlyph)], packed);
+        pen.x += kGlyphAdvance * scale;
+        extent = glm::max(extent, pen + glm::vec2(0.0f, kLineHeight * scale));
+    }
+    return extent;
+}
+
+glm::vec2 SpriteBatch::measure(const std::string& text, int scale) const {
+    int columns = 0, longest = 0, lines = 1;
+    for (char c : text) {
+        if (c == '\n') {
+            lines++;
+            columns = 0;
+            continue;
+        }
+        longest = std::max(longest, ++columns);
+    }
+    return glm::vec2(static_cast<float>(longest * kGlyphAdvance * scale), static_cast<float>(lines * kLineHeight * scale));
+}
+
+void SpriteBatch::end() {
+    // An unchanged overlay keeps the buffer contents of an earlier frame
+    bool same = vertices.size() == uploaded.size() &&
+        (vertices.empty() || std::memcmp(vertices.data(), uploaded.data(), vertices.size() * sizeof(SpriteVertex)) == 0);
+    if (!same && !vertices.empty()) {
+        GLState::bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(SpriteVertex), vertices.data());
+        RenderStats::frame().overlayUploadBytes += static_cast<unsigned int>(vertices.size() * sizeof(SpriteVertex));
+    }
+    uploaded.swap(vertices);
+    vertices.clear();
+}
+
+void SpriteBatch::queue(ShaderProgram& shader, RenderQueue& renderQueue, int viewportWidth, int viewportHeight) {
+    if (uploaded.empty() || !VAO)
+        return;
+    DrawItem item = { RenderPass::Overlay, &shader, atlasTexture, VAO, 0, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+    item.draw = [this, &shader, viewportWidth, viewportHeight] { draw(shader, viewportWidth, viewportHeight); };
+    renderQueue.add(item, glm::vec3(0.0f));
+}
+
+void SpriteBatch::draw(ShaderProgram& shader, int viewportWidth, int viewportHeight) {
+    shader.setVec2("viewportSize", glm::vec2(viewportWidth, viewportHeight));
+
+    // Drawn over the scene in submission order with straight alpha
+    GLState::setEnabled(GL_DEPTH_TEST, false);
+    GLState::setEnabled(GL_BLEND, true);
+    GLState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    GLsizei quads = static_cast<GLsizei>(uploaded.size() / 4);
+    glDrawElements(GL_TRIANGLES, quads * 6, GL_UNSIGNED_INT, nullptr);
+    RenderStats::countDraw(quads * 6);
+    RenderStats::frame().overlaySprites += static_cast<unsigned int>(quads);
+
+    GLState::setEnabled(GL_BLEND, false);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+}
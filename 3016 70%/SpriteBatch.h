@@ -0,0 +1,80 @@
+#pragma once
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+
+// Screen-space vertex: pixel position from the top-left corner, atlas
+// coordinates and an RGBA8 tint
+struct SpriteVertex {
+    glm::vec2 position;
+    glm::vec2 texCoord;
+    uint32_t color;
+};
+
+// Rectangle of the atlas holding one image or glyph
+struct SpriteRegion {
+    glm::vec2 uvMin;
+    glm::vec2 uvMax;
+    glm::ivec2 size; // Pixels
+};
+
+// Batched 2D overlay. Images and the built-in glyph font share one atlas
+// texture, so a frame's sprites and text become one vertex buffer drawn
+// with a single call. The buffer is only re-uploaded when the overlay
+// differs from the previous frame's.
+class SpriteBatch {
+public:
+    SpriteBatch(int atlasSize = 1024, int maxSprites = 4096);
+
+    // Creates the atlas with the glyphs packed in, and the buffers
+    bool create();
+    void release();
+
+    // Packs an image into the atlas, area-resampled to width x height, and
+    // returns its sprite id, or -1 when the atlas is full
+    int addImage(const unsigned char* pixels, int sourceWidth, int sourceHeight, int channels, int width, int height);
+    const SpriteRegion& region(int sprite) const;
+
+    // Starts collecting this frame's overlay
+    void begin();
+
+    void sprite(int sprite, const glm::vec2& position, const glm::vec2& size, const glm::vec4& color = glm::vec4(1.0f));
+
+    // Draws a line of text with the glyph font at an integer scale; '\n'
+    // starts a new line. Returns the bottom-right corner of the text.
+    glm::vec2 text(const std::string& text, const glm::vec2& position, int scale = 1, const glm::vec4& color = glm::vec4(1.0f));
+    glm::vec2 measure(const std::string& text, int scale = 1) const;
+
+    // Uploads the collected vertices if they changed since the last upload
+    void end();
+
+    // Adds one overlay item drawing everything collected by the last end().
+    // The sprite program's atlas sampler must read unit 0.
+    void queue(ShaderProgram& shader, RenderQueue& renderQueue, int viewportWidth, int viewportHeight);
+
+private:
+    bool pack(int width, int height, glm::ivec2& origin);
+    int addRegion(const unsigned char* rgba, int width, int height);
+    void addQuad(const glm::vec2& position, const glm::vec2& size, const SpriteRegion& region, uint32_t color);
+    void draw(ShaderProgram& shader, int viewportWidth, int viewportHeight);
+
+    int atlasSize;
+    int maxSprites;
+    GLuint atlasTexture;
+    GLuint VAO, VBO, EBO;
+    int shelfX, shelfY, shelfHeight; // Next free spot of the shelf packer
+    std::vector<SpriteRegion> regions;
+    int firstGlyph; // Sprite id of the space glyph
+    std::vector<SpriteVertex> vertices;
+    std::vector<SpriteVertex> uploaded; // What the vertex buffer holds
+    bool overflowed;
+};
+
+#endif // SPRITE_BATCH_H
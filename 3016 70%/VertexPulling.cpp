@@ -0,0 +1,181 @@
+#include "VertexPulling.h"
+#include "GLStateCache.h"
+#include "RenderStats.h"
+#include "RingBuffer.h"
+#include "GpuCulling.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <numeric>
+
+static_assert(sizeof(PulledVertex) == 48, "PulledVertex must match the std430 layout");
+static_assert(sizeof(PulledInstance) == 128, "PulledInstance must match the std430 layout");
+
+VertexPool::VertexPool()
+    : vertexBuffer(0), indexBuffer(0), instanceIndexBuffer(0), vao(0) {}
+
+PulledMesh VertexPool::add(const std::vector<PulledVertex>& meshVertices, const std::vector<unsigned int>& meshIndices,
+    MemorySubsystem subsystem, const std::string& name) {
+    PulledMesh mesh = { static_cast<unsigned int>(indices.size()), static_cast<int>(vertices.size()) };
+    vertices.insert(vertices.end(), meshVertices.begin(), meshVertices.end());
+    indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+    AssetMemory::track(subsystem, name + " (pulled)", 0, meshVertices.size() * sizeof(PulledVertex) + meshIndices.size() * sizeof(unsigned int));
+    return mesh;
+}
+
+bool VertexPool::create() {
+    if (vertices.empty() || indices.empty())
+        return false;
+    glCreateBuffers(1, &vertexBuffer);
+    glNamedBufferStorage(vertexBuffer, vertices.size() * sizeof(PulledVertex), vertices.data(), 0);
+    glCreateBuffers(1, &indexBuffer);
+    glNamedBufferStorage(indexBuffer, indices.size() * sizeof(unsigned int), indices.data(), 0);
+
+    std::vector<GLuint> instanceIndices(kMaxPulledInstances);
+    std::iota(instanceIndices.begin(), instanceIndices.end(), 0u);
+    glCreateBuffers(1, &instanceIndexBuffer);
+    glNamedBufferStorage(instanceIndexBuffer, instanceIndices.size() * sizeof(GLuint), instanceIndices.data(), 0);
+
+    // No vertex attributes: the shaders pull by gl_VertexID, which includes
+    // each command's base vertex. gl_BaseInstance is not available
+    // everywhere (llvmpipe lacks it), so the instance index is an attribute
+    // that starts at each command's base instance.
+    glCreateVertexArrays(1, &vao);
+    glVertexArrayElementBuffer(vao, indexBuffer);
+    glVertexArrayVertexBuffer(vao, kPulledInstanceAttribute, instanceIndexBuffer, 0, sizeof(GLuint));
+    glVertexArrayBindingDivisor(vao, kPulledInstanceAttribute, 1);
+    glVertexArrayAttribIFormat(vao, kPulledInstanceAttribute, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(vao, kPulledInstanceAttribute, kPulledInstanceAttribute);
+    glEnableVertexArrayAttrib(vao, kPulledInstanceAttribute);
+
+    std::vector<PulledVertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
+    return true;
+}
+
+bool VertexPool::created() const {
+    return vao != 0;
+}
+
+GLuint VertexPool::vertexArray() const {
+    return vao;
+}
+
+void VertexPool::bind() const {
+    GLState::bindBufferBase(GL_SHADER_STORAGE_BUFFER, kPulledVertexBinding, vertexBuffer);
+}
+
+void VertexPool::release() {
+    if (vao) {
+        GLState::forgetVertexArray(vao);
+        glDeleteVertexArrays(1, &vao);
+    }
+    GLuint* buffers[] = { &vertexBuffer, &indexBuffer, &instanceIndexBuffer };
+    for (GLuint* buffer : buffers) {
+        if (*buffer) {
+            GLState::forgetBuffer(*buffer);
+            glDeleteBuffers(1, buffer);
+            *buffer = 0;
+        }
+    }
+    vao = 0;
+    vertices.clear();
+    indices.clear();
+}
+
+void PulledDrawList::clear() {
+    entries.clear();
+    instances.clear();
+}
+
+void PulledDrawList::add(const PulledMesh& mesh, unsigned int indexOffset, unsigned int indexCount, const glm::mat4& model, const glm::mat3& normalMatrix) {
+    entries.push_back({ mesh.firstIndex + indexOffset, indexCount, mesh.baseVertex, static_cast<uint32_t>(instances.size()) });
+    instances.push_back({ model, glm::mat4(normalMatrix) });
+}
+
+bool PulledDrawList::empty() const {
+    return entries.empty();
+}
+
+void PulledDrawList::draw(const VertexPool& pool) {
+    if (entries.empty())
+        return;
+    if (entries.size() > kMaxPulledInstances) {
+        static bool warned = false;
+        if (!warned) {
+            warned = true;
+            std::cerr << "Pulled draw list holds " << entries.size() << " instances, drawing the first " << kMaxPulledInstances << std::endl;
+        }
+        entries.resize(kMaxPulledInstances);
+    }
+
+    // Instances of the same range become neighbours, and each run one command
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        if (a.firstIndex != b.firstIndex)
+            return a.firstIndex < b.firstIndex;
+        if (a.indexCount != b.indexCount)
+            return a.indexCount < b.indexCount;
+        return a.baseVertex < b.baseVertex;
+    });
+    size_t commandCount = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& entry = entries[i];
+        if (i == 0 || entry.firstIndex != entries[i - 1].firstIndex || entry.indexCount != entries[i - 1].indexCount || entry.baseVertex != entries[i - 1].baseVertex)
+            commandCount++;
+    }
+
+    RingAllocation instanceBlock = FrameRing::get().allocate(entries.size() * sizeof(PulledInstance), FrameRing::storageAlignment());
+    RingAllocation commandBlock = FrameRing::get().allocate(commandCount * sizeof(DrawElementsIndirectCommand), 16);
+    if (!instanceBlock.data || !commandBlock.data)
+        return;
+    PulledInstance* instanceData = static_cast<PulledInstance*>(instanceBlock.data);
+    DrawElementsIndirectCommand* commands = static_cast<DrawElementsIndirectCommand*>(commandBlock.data);
+    size_t command = 0;
+    GLsizei drawnIndices = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& entry = entries[i];
+        std::memcpy(&instanceData[i], &instances[entry.instance], sizeof(PulledInstance));
+        if (i > 0 && entry.firstIndex == entries[i - 1].firstIndex && entry.indexCount == entries[i - 1].indexCount && entry.baseVertex == entries[i - 1].baseVertex) {
+            commands[command - 1].instanceCount++;
+        }
+        else {
+            commands[command++] = { entry.indexCount, 1, entry.firstIndex, entry.baseVertex, static_cast<GLuint>(i) };
+        }
+        drawnIndices += static_cast<GLsizei>(entry.indexCount);
+    }
+
+    pool.bind();
+    GLState::bindBufferRange(GL_SHADER_STORAGE_BUFFER, kPulledInstanceBinding, instanceBlock.buffer, instanceBlock.offset, instanceBlock.size);
+    GLState::bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBlock.buffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commandBlock.offset, static_cast<GLsizei>(commandCount), 0);
+    RenderStats::countDraw(drawnIndices);
+}
+
+namespace VertexPulling {
+
+VertexPullingSettings& settings() {
+    static VertexPullingSettings pullingSettings = { false };
+    return pullingSettings;
+}
+
+std::vector<PulledVertex> fromVertices(const std::vector<Vertex>& vertices) {
+    std::vector<PulledVertex> pulled;
+    pulled.reserve(vertices.size());
+    for (const auto& vertex : vertices) {
+        pulled.push_back({ glm::vec4(vertex.position, vertex.texCoord.x), glm::vec4(vertex.normal, vertex.texCoord.y),
+            glm::vec4(vertex.color, 1.0f) });
+    }
+    return pulled;
+}
+
+std::vector<PulledVertex> fromInterleaved(const std::vector<float>& vertices) {
+    std::vector<PulledVertex> pulled;
+    pulled.reserve(vertices.size() / 8);
+    for (size_t i = 0; i + 8 <= vertices.size(); i += 8) {
+        const float* v = &vertices[i];
+        pulled.push_back({ glm::vec4(v[0], v[1], v[2], v[3]), glm::vec4(v[5], v[6], v[7], v[4]), glm::vec4(1.0f) });
+    }
+    return pulled;
+}
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+#ifndef VERTEX_PULLING_H
+#define VERTEX_PULLING_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glm.hpp>
+#include <glew.h>
+#include "Vertex.h"
+#include "AssetMemory.h"
+
+// Storage bindings of the pulled vertices and the per-instance data, above
+// the clustered lighting and GPU culling ones
+const GLuint kPulledVertexBinding = 8;
+const GLuint kPulledInstanceBinding = 9;
+const GLuint kPulledInstanceAttribute = 0;
+
+// Instances one draw list can address, the size of the instance index stream
+const GLuint kMaxPulledInstances = 65536;
+
+// Layout every pulled mesh is converted to, whatever its source layout (std430)
+struct PulledVertex {
+    glm::vec4 positionU; // xyz position, w texture u
+    glm::vec4 normalV;   // xyz normal, w texture v
+    glm::vec4 color;     // rgb vertex colour, white for meshes without one
+};
+
+// Per-instance data the vertex shader reads by instance index (std430)
+struct PulledInstance {
+    glm::mat4 model;
+    glm::mat4 normalMatrix; // Upper 3x3 used
+};
+
+// Where a mesh landed in the pool. Index ranges inside the mesh, such as
+// terrain chunks and LOD levels, are offset by firstIndex.
+struct PulledMesh {
+    unsigned int firstIndex;
+    int baseVertex;
+};
+
+struct VertexPullingSettings {
+    bool enabled;
+};
+
+// Every pulled mesh in one vertex storage buffer and one index buffer. The
+// shaders fetch vertices by gl_VertexID, so a single vertex array serves all
+// meshes: it holds the index buffer and the instance index stream only.
+// Indices still go through the fixed-function index fetch, which keeps the
+// post-transform cache reuse the mesh optimizer orders them for.
+class VertexPool {
+public:
+    VertexPool();
+
+    // Appends a mesh; only valid before create(). indices are relative to
+    // the mesh's own vertices.
+    PulledMesh add(const std::vector<PulledVertex>& vertices, const std::vector<unsigned int>& indices,
+        MemorySubsystem subsystem, const std::string& name);
+
+    // Uploads the pool and frees the CPU copies
+    bool create();
+    bool created() const;
+
+    GLuint vertexArray() const;
+
+    // Binds the vertex storage buffer the pulling shaders read
+    void bind() const;
+
+    void release();
+
+private:
+    std::vector<PulledVertex> vertices;
+    std::vector<unsigned int> indices;
+    GLuint vertexBuffer;
+    GLuint indexBuffer;
+    GLuint instanceIndexBuffer; // 0, 1, 2, ...: read from each command's base instance
+    GLuint vao;
+};
+
+// Draws of pulled meshes collected over a frame. Instances of the same
+// index range share a command, and every command of the list goes out in
+// one glMultiDrawElementsIndirect, whichever meshes they come from.
+class PulledDrawList {
+public:
+    void clear();
+
+    // One instance of the index range [indexOffset, indexOffset + indexCount) of a mesh
+    void add(const PulledMesh& mesh, unsigned int indexOffset, unsigned int indexCount, const glm::mat4& model, const glm::mat3& normalMatrix);
+
+    bool empty() const;
+
+    // Streams the commands and instances through the frame ring and issues
+    // the multi-draw. The pool's vertex array must be bound.
+    void draw(const VertexPool& pool);
+
+private:
+    struct Entry {
+        unsigned int firstIndex;
+        unsigned int indexCount;
+        int baseVertex;
+        uint32_t instance;
+    };
+
+    std::vector<Entry> entries;
+    std::vector<PulledInstance> instances;
+};
+
+namespace VertexPulling {
+    VertexPullingSettings& settings();
+
+    // Conversions from the layouts the vertex arrays use
+    std::vector<PulledVertex> fromVertices(const std::vector<Vertex>& vertices);
+    std::vector<PulledVertex> fromInterleaved(const std::vector<float>& vertices); // Position, UV, normal: 8 floats
+
+    // Reads a whole buffer back, for filling the pool from meshes that are
+    // already uploaded without keeping CPU copies of them
+    template <typename T>
+    std::vector<T> readBuffer(GLuint buffer) {
+        GLint64 size = 0;
+        glGetNamedBufferParameteri64v(buffer, GL_BUFFER_SIZE, &size);
+        std::vector<T> data(static_cast<size_t>(size) / sizeof(T));
+        glGetNamedBufferSubData(buffer, 0, data.size() * sizeof(T), data.data());
+        return data;
+    }
+}
+
+#endif // VERTEX_PULLING_H
@@ -0,0 +1,72 @@
+#include "VirtualFileSystem.h"
+#include "AssetPack.h"
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    AssetPack mountedPack;
+}
+
+FileView::FileView()
+    : bytes(nullptr), length(0) {}
+
+FileView::FileView(const unsigned char* data, size_t size)
+    : bytes(data), length(size) {}
+
+FileView::FileView(std::shared_ptr<MappedFile> file)
+    : bytes(file->data()), length(file->size()), owned(std::move(file)) {}
+
+bool FileView::valid() const {
+    return bytes != nullptr;
+}
+
+const unsigned char* FileView::data() const {
+    return bytes;
+}
+
+size_t FileView::size() const {
+    return length;
+}
+
+namespace Vfs {
+
+bool mountPack(const std::string& path) {
+    if (!mountedPack.open(path))
+        return false;
+    std::cout << "Mounted asset pack " << path << " (" << mountedPack.entryCount() << " files)" << std::endl;
+    return true;
+}
+
+bool hasPack() {
+    return mountedPack.isOpen();
+}
+
+FileView open(const std::string& path) {
+    const unsigned char* data;
+    size_t size;
+    if (mountedPack.find(path, data, size))
+        return FileView(data, size);
+
+    // Development fallback: map the loose file, so it is read the same way
+    // as the pack, without a copy
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(path))
+        return FileView();
+    return FileView(std::move(file));
+}
+
+bool exists(const std::string& path) {
+    const unsigned char* data;
+    size_t size;
+    if (mountedPack.find(path, data, size))
+        return true;
+    std::error_code error;
+    return std::filesystem::is_regular_file(path, error);
+}
+
+std::string extension(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    return ext.empty() ? ext : ext.substr(1);
+}
+
+}
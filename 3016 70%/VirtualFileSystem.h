@@ -0,0 +1,40 @@
+#pragma once
+#ifndef VIRTUAL_FILE_SYSTEM_H
+#define VIRTUAL_FILE_SYSTEM_H
+
+#include <memory>
+#include <string>
+#include "MappedFile.h"
+
+// Read-only view of a file's contents. Views into the mounted pack point
+// straight at the pack's mapping; loose files are mapped on their own and
+// keep that mapping alive while any copy of the view exists.
+class FileView {
+public:
+    FileView();
+    FileView(const unsigned char* data, size_t size);
+    explicit FileView(std::shared_ptr<MappedFile> file);
+
+    bool valid() const;
+    const unsigned char* data() const;
+    size_t size() const;
+
+private:
+    const unsigned char* bytes;
+    size_t length;
+    std::shared_ptr<MappedFile> owned;
+};
+
+namespace Vfs {
+    // Maps a pack once; lookups hit it before falling back to loose files
+    bool mountPack(const std::string& path);
+    bool hasPack();
+
+    FileView open(const std::string& path);
+    bool exists(const std::string& path);
+
+    // Extension of a path without the dot, e.g. "fbx", as Assimp's import hint expects
+    std::string extension(const std::string& path);
+}
+
+#endif // VIRTUAL_FILE_SYSTEM_H
@@ -0,0 +1,19 @@
+#include "Visibility.h"
+#include "HorizonCuller.h"
+#include "OcclusionBuffer.h"
+
+namespace Visibility {
+
+ViewCull build(const glm::mat4& viewProjection, const HorizonCuller* horizon, const OcclusionBuffer* occlusion) {
+    return { FrustumCuller::extract(viewProjection), horizon, occlusion };
+}
+
+void cull(const ViewCull& view, const AabbSoA& boxes, std::vector<uint32_t>& visible) {
+    FrustumCuller::cull(view.frustum, boxes, visible);
+    if (view.horizon)
+        view.horizon->cull(boxes, visible);
+    if (view.occlusion)
+        view.occlusion->cull(boxes, visible);
+}
+
+}
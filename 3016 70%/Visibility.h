@@ -0,0 +1,28 @@
+#pragma once
+#ifndef VISIBILITY_H
+#define VISIBILITY_H
+
+#include <cstdint>
+#include <vector>
+#include <glm.hpp>
+#include "FrustumCuller.h"
+
+class HorizonCuller;
+class OcclusionBuffer;
+
+// Per-view culling inputs shared by every renderer this frame
+struct ViewCull {
+    Frustum frustum;
+    const HorizonCuller* horizon;     // Null when horizon culling is off
+    const OcclusionBuffer* occlusion; // Null when occlusion culling is off
+};
+
+namespace Visibility {
+    ViewCull build(const glm::mat4& viewProjection, const HorizonCuller* horizon, const OcclusionBuffer* occlusion);
+
+    // Fills visible with the indices of the boxes that pass every enabled test,
+    // cheapest first: frustum planes, the terrain horizon, then the occlusion buffer
+    void cull(const ViewCull& view, const AabbSoA& boxes, std::vector<uint32_t>& visible);
+}
+
+#endif // VISIBILITY_H
@@ -1,6 +1,9 @@
 #include <iostream>
 #include <vector>
+#include <string>
 #include <random>
+#include <cmath>
+#include <chrono>
 #include <glew.h>
 #include <glfw3.h>
 #include <FastNoiseLite.h>
@@ -8,28 +11,56 @@
 #include <gtc/matrix_transform.hpp>
 #include <gtc/type_ptr.hpp>
 #include "Vertex.h"
-#include "Terrain.h"
-#include "Sword.h"
+#include "terrain.h"
+#include "sword.h"
 #include "Key.h"
 #include "Camera.h"
+#include "MeshOptimizer.h"
+#include "PropLod.h"
+#include "Impostor.h"
+#include "AssetMemory.h"
+#include "AssetPack.h"
+#include "VirtualFileSystem.h"
+#include "RenderStats.h"
+#include "GLStateCache.h"
+#include "ShaderProgram.h"
+#include "FrameUniforms.h"
+#include "RingBuffer.h"
+#include "FrustumCuller.h"
+#include "HorizonCuller.h"
+#include "OcclusionBuffer.h"
+#include "Visibility.h"
+#include "JobSystem.h"
+#include "RenderQueue.h"
+#include "ShadowMap.h"
+#include "LightClusters.h"
+#include "SpriteBatch.h"
+#include "Headless.h"
+#include "DynamicResolution.h"
+#include "Simulation.h"
+#include "FrameCapture.h"
+#include "GpuCulling.h"
+#include "VertexPulling.h"
 #include "shaders/LoadShaders.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+// Scene placement draws from one generator; headless runs seed it with a constant
+std::mt19937 sceneRandom(std::random_device{}());
+
 // Function to generate a random float between min and max
 float randomFloat(float min, float max) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
     std::uniform_real_distribution<> dis(min, max);
-    return dis(gen);
+    return dis(sceneRandom);
 }
 
-// Create a Camera object
+// Create a Camera object; once the loop starts only the simulation thread moves it
 Camera camera(glm::vec3(50.0f, 50.0f, 150.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, 0.0f);
 
 float lastX = 400, lastY = 300;
 bool firstMouse = true;
+glm::vec2 mouseOffset(0.0f); // Cursor movement since the last input sample
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     if (firstMouse) {
@@ -44,41 +75,21 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
     lastX = xpos;
     lastY = ypos;
 
-    camera.ProcessMouseMovement(xoffset, yoffset);
+    mouseOffset += glm::vec2(xoffset, yoffset);
 }
 
-GLuint loadTexture(const char* path) {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else {
+// Decodes an image and packs it into the overlay atlas at the given size
+int loadSprite(SpriteBatch& overlay, const char* path, int width, int height) {
+    int sourceWidth, sourceHeight, nrComponents;
+    FileView file = Vfs::open(path);
+    unsigned char* data = file.valid() ? stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &sourceWidth, &sourceHeight, &nrComponents, 0) : nullptr;
+    if (!data) {
         std::cerr << "Failed to load texture: " << path << std::endl;
-        stbi_image_free(data);
+        return -1;
     }
-
-    return textureID;
+    int sprite = overlay.addImage(data, sourceWidth, sourceHeight, nrComponents, width, height);
+    stbi_image_free(data);
+    return sprite;
 }
 
 // Function to calculate delta time
@@ -90,129 +101,252 @@ float calculateDeltaTime() {
     return deltaTime;
 }
 
-int main() {
-    // GLFW and GLEW Initialization
-    if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW!" << std::endl;
-        return -1;
+int main(int argc, char** argv) {
+    // Offline report: optimize every prop mesh and print ACMR/ATVR, no window needed
+    if (argc > 1 && std::string(argv[1]) == "--mesh-report") {
+        MeshOptimizer::reportDirectory("models");
+        return 0;
     }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // Cook the loose assets into a pack that later runs map at startup
+    if (argc > 1 && std::string(argv[1]) == "--build-pack") {
+        return AssetPack::build({ "models", "shaders", "Signature" }, "assets.pak") ? 0 : -1;
+    }
 
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Procedural Terrain", nullptr, nullptr);
-    if (!window) {
-        std::cerr << "Failed to create GLFW window!" << std::endl;
-        glfwTerminate();
+    // Offline report: horizon and occlusion culling cost and cull rate over random views, no window needed
+    if (argc > 1 && std::string(argv[1]) == "--occlusion-report") {
+        FastNoiseLite noise;
+        noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+        noise.SetFrequency(0.05f);
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        Terrain terrain(100, 5.0f, noise);
+        terrain.generateTerrain(vertices, indices);
+        Horizon::printReport(terrain);
+        Occlusion::printReport(terrain);
+        JobSystem::shutdown();
+        return 0;
+    }
+
+    // Offline report: clustered light binning cost and correctness over random views, no window needed
+    if (argc > 1 && std::string(argv[1]) == "--cluster-report") {
+        Clusters::printReport();
+        JobSystem::shutdown();
+        return 0;
+    }
+
+    // Offline report: compute culling checked against the CPU culler over random views, on an offscreen context
+    if (argc > 1 && std::string(argv[1]) == "--gpu-cull-report") {
+        FastNoiseLite noise;
+        noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
+        noise.SetFrequency(0.05f);
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        Terrain terrain(100, 5.0f, noise);
+        terrain.generateTerrain(vertices, indices);
+        if (!Headless::createContext())
+            return -1;
+        GLenum glewStatus = glewInit();
+        if (glewStatus != GLEW_OK && glewStatus != GLEW_ERROR_NO_GLX_DISPLAY) {
+            std::cerr << "Failed to initialize GLEW!" << std::endl;
+            return -1;
+        }
+        bool matched = GpuCulling::printReport(terrain, vertices, indices);
+        Headless::destroyContext();
+        JobSystem::shutdown();
+        return matched ? 0 : 1;
+    }
+
+    // Without a pack every asset is read from its loose file
+    if (!Vfs::mountPack("assets.pak")) {
+        std::cout << "No asset pack found, loading loose files" << std::endl;
+    }
+
+    // Headless runs render a scripted camera path offscreen, for benchmarks and image checks
+    HeadlessOptions headlessOptions;
+    if (!Headless::parseArguments(argc, argv, headlessOptions)) {
+        std::cerr << "Malformed headless option" << std::endl;
         return -1;
     }
-    glfwMakeContextCurrent(window);
+    bool headless = headlessOptions.enabled;
 
-    if (glewInit() != GLEW_OK) {
+    // Captures read frames back asynchronously, in windowed and headless runs alike
+    CaptureOptions captureOptions;
+    if (!Capture::parseArguments(argc, argv, captureOptions)) {
+        std::cerr << "Malformed capture option" << std::endl;
+        return -1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--gpu-culling")
+            GpuCulling::settings().enabled = true;
+        if (std::string(argv[i]) == "--vertex-pulling")
+            VertexPulling::settings().enabled = true;
+    }
+    GLFWwindow* window = nullptr;
+    if (headless) {
+        if (!Headless::createContext())
+            return -1;
+        sceneRandom.seed(1);
+    }
+    else {
+        // GLFW and GLEW Initialization
+        if (!glfwInit()) {
+            std::cerr << "Failed to initialize GLFW!" << std::endl;
+            return -1;
+        }
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 6);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        window = glfwCreateWindow(800, 600, "Procedural Terrain", nullptr, nullptr);
+        if (!window) {
+            std::cerr << "Failed to create GLFW window!" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+    }
+
+    // Without a window GLEW may find no GLX display, which only affects the GLX extensions
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && !(headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY)) {
         std::cerr << "Failed to initialize GLEW!" << std::endl;
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST);
+    GLState::setEnabled(GL_DEPTH_TEST, true);
+
+    // Offscreen target that stands in for the window, created before any pass returns to it
+    HeadlessTarget headlessTarget(headlessOptions);
+    if (headless && !headlessTarget.create())
+        return -1;
+    FrameCapture frameCapture(captureOptions);
+    if (!frameCapture.create())
+        return -1;
 
     // Set the mouse callback
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (window) {
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
 
     // Shader setup for terrain
     ShaderInfo terrainShaders[] = {
         { GL_VERTEX_SHADER, "shaders/terrain_vertex_shader.glsl" },
         { GL_FRAGMENT_SHADER, "shaders/terrain_fragment_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/clustered_lighting.glsl" },
         { GL_NONE, NULL }
     };
-    GLuint terrainShaderProgram = LoadShaders(terrainShaders);
+    ShaderProgram terrainShader(LoadShaders(terrainShaders));
 
     // Shader setup for swords
     ShaderInfo swordShaders[] = {
         { GL_VERTEX_SHADER, "shaders/sword_vertex_shader.glsl" },
         { GL_FRAGMENT_SHADER, "shaders/sword_fragment_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/clustered_lighting.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram swordShader(LoadShaders(swordShaders));
+
+    // Shader setup for GPU-culled swords, which take their transforms from the cull's buffers
+    ShaderInfo swordIndirectShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/sword_indirect_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/sword_fragment_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/clustered_lighting.glsl" },
         { GL_NONE, NULL }
     };
-    GLuint swordShaderProgram = LoadShaders(swordShaders);
+    ShaderProgram swordIndirectShader(LoadShaders(swordIndirectShaders));
+    swordIndirectShader.setInt("texture1", 0);
+    swordIndirectShader.setVec2("lodFade", glm::vec2(0.0f)); // Callback draws never set it
+
+    // Compute shaders for the GPU culling and the depth pyramid it tests against
+    ShaderInfo cullShaders[] = {
+        { GL_COMPUTE_SHADER, "shaders/gpu_cull_compute_shader.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram cullShader(LoadShaders(cullShaders));
+    ShaderInfo pyramidShaders[] = {
+        { GL_COMPUTE_SHADER, "shaders/depth_pyramid_compute_shader.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram pyramidShader(LoadShaders(pyramidShaders));
+    DepthPyramid depthPyramid;
+
+    // Shader setup for vertex pulling: one vertex shader fetches every mesh type from the pool
+    ShaderInfo pulledTerrainShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/pulled_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/terrain_fragment_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/clustered_lighting.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram pulledTerrainShader(LoadShaders(pulledTerrainShaders));
+    pulledTerrainShader.setInt("shadowMap", kShadowTextureUnit);
+    ShaderInfo pulledSwordShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/pulled_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/sword_fragment_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/clustered_lighting.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram pulledSwordShader(LoadShaders(pulledSwordShaders));
+    pulledSwordShader.setInt("texture1", 0);
+    pulledSwordShader.setVec2("lodFade", glm::vec2(0.0f));
 
     // Shader setup for keys
     ShaderInfo keyShaders[] = {
         { GL_VERTEX_SHADER, "shaders/key_vertex_shader.glsl" },
         { GL_FRAGMENT_SHADER, "shaders/key_fragment_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/clustered_lighting.glsl" },
         { GL_NONE, NULL }
     };
-    GLuint keyShaderProgram = LoadShaders(keyShaders);
-
-    // Shader setup for quad (signature)
-    const char* quadVertexShaderSource = R"(
-    #version 460 core
-    layout (location = 0) in vec2 aPos;
-    layout (location = 1) in vec2 aTexCoords;
-
-    out vec2 TexCoords;
-
-    void main() {
-        TexCoords = aTexCoords;
-        gl_Position = vec4(aPos, 0.0, 1.0);
-    }
-    )";
-
-    const char* quadFragmentShaderSource = R"(
-    #version 460 core
-    out vec4 FragColor;
+    ShaderProgram keyShader(LoadShaders(keyShaders));
 
-    in vec2 TexCoords;
+    // Shader setup for impostor billboards
+    ShaderInfo impostorShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/impostor_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/impostor_fragment_shader.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram impostorShader(LoadShaders(impostorShaders));
 
-    uniform sampler2D texture1;
+    // Shader setup for the depth pre-pass
+    ShaderInfo depthShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/depth_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/depth_fragment_shader.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram depthShader(LoadShaders(depthShaders));
 
-    void main() {
-        FragColor = texture(texture1, TexCoords);
-    }
-    )";
-
-    GLuint quadVertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(quadVertexShader, 1, &quadVertexShaderSource, NULL);
-    glCompileShader(quadVertexShader);
-
-    GLuint quadFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(quadFragmentShader, 1, &quadFragmentShaderSource, NULL);
-    glCompileShader(quadFragmentShader);
-
-    GLuint quadShaderProgram = glCreateProgram();
-    glAttachShader(quadShaderProgram, quadVertexShader);
-    glAttachShader(quadShaderProgram, quadFragmentShader);
-    glLinkProgram(quadShaderProgram);
-
-    glDeleteShader(quadVertexShader);
-    glDeleteShader(quadFragmentShader);
-
-    // Create a quad
-    float quadVertices[] = {
-        // positions   // texCoords
-        -0.9f,  0.9f,  0.0f, 0.0f,
-        -0.9f,  0.7f,  0.0f, 1.0f,
-        -0.7f,  0.7f,  1.0f, 1.0f,
-
-        -0.9f,  0.9f,  0.0f, 0.0f,
-        -0.7f,  0.7f,  1.0f, 1.0f,
-        -0.7f,  0.9f,  1.0f, 0.0f
+    // Shader setup for shadow casters, sharing the depth pre-pass fragment shader
+    ShaderInfo shadowShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/shadow_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/depth_fragment_shader.glsl" },
+        { GL_NONE, NULL }
     };
+    ShaderProgram shadowShader(LoadShaders(shadowShaders));
 
+    // Shader setup for the 2D overlay
+    ShaderInfo spriteShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/sprite_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/sprite_fragment_shader.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram spriteShader(LoadShaders(spriteShaders));
+    spriteShader.setInt("atlas", 0);
 
-    GLuint quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glBindVertexArray(0);
+    // Shader setup for upscaling the dynamic-resolution scene
+    ShaderInfo upscaleShaders[] = {
+        { GL_VERTEX_SHADER, "shaders/upscale_vertex_shader.glsl" },
+        { GL_FRAGMENT_SHADER, "shaders/upscale_fragment_shader.glsl" },
+        { GL_NONE, NULL }
+    };
+    ShaderProgram upscaleShader(LoadShaders(upscaleShaders));
+    upscaleShader.setInt("scene", 0);
 
-    GLuint signatureTexture = loadTexture("Signature/signature.jpg");
+    // The signature and the HUD text are batched from one atlas
+    SpriteBatch overlay;
+    overlay.create();
+    int signatureSprite = loadSprite(overlay, "Signature/signature.jpg", 80, 60);
 
     // Terrain generation
     FastNoiseLite noise;
@@ -232,11 +366,11 @@ int main() {
     glGenBuffers(1, &terrainVBO);
     glGenBuffers(1, &terrainEBO);
 
-    glBindVertexArray(terrainVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, terrainVBO);
+    GLState::bindVertexArray(terrainVAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, terrainVBO);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, terrainEBO);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
@@ -251,24 +385,79 @@ int main() {
     glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoord));
     glEnableVertexAttribArray(3);
 
-    glm::mat4 model = glm::mat4(1.0f);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 500.0f);
+    // Positions alone for the depth pre-pass, sharing the terrain indices
+    GLuint terrainPositionVBO;
+    GLuint terrainDepthVAO = DepthPrepass::createVertexArray(vertices.data(), vertices.size(), sizeof(Vertex), terrainEBO, terrainPositionVBO);
+
+    // Chunk boxes for view culling; visible chunks go out in one multi-draw
+    AabbSoA terrainChunkBounds;
+    for (const auto& chunk : terrain.getChunks())
+        terrainChunkBounds.add(chunk.bounds);
+    std::vector<GLsizei> chunkCounts;
+    std::vector<const void*> chunkOffsets;
+
+    // Filled from the uploaded buffers the first time vertex pulling is enabled
+    VertexPool vertexPool;
+    PulledMesh terrainPulled = { 0, 0 };
+    PulledDrawList terrainDraws;
+    RenderQueue renderQueue;
+    renderQueue.setDepthProgram(&depthShader);
+
+    // The scene renders at a scale held to the frame budget; the overlay is
+    // queued separately and drawn at full resolution after the upscale
+    ResolutionScaler resolutionScaler;
+    RenderQueue overlayQueue;
+    if (headless)
+        DynamicResolution::settings().enabled = false; // Captures and timings stay comparable between runs
+
+    // Low-resolution copy of the terrain that hides props behind hills
+    OcclusionBuffer occlusionBuffer;
+    occlusionBuffer.buildOccluders(terrain);
+    HorizonCuller horizonCuller(terrain);
+
+    // The terrain buffers now hold the only copy of the mesh
+    AssetMemory::track(MemorySubsystem::Terrain, "terrain mesh", 0, vertices.size() * (sizeof(Vertex) + sizeof(glm::vec3)) + indices.size() * sizeof(unsigned int));
+    std::vector<Vertex>().swap(vertices);
+    std::vector<unsigned int>().swap(indices);
 
-    GLuint terrainModelLoc = glGetUniformLocation(terrainShaderProgram, "model");
-    GLuint terrainViewLoc = glGetUniformLocation(terrainShaderProgram, "view");
-    GLuint terrainProjLoc = glGetUniformLocation(terrainShaderProgram, "projection");
-    GLuint terrainLightPosLoc = glGetUniformLocation(terrainShaderProgram, "lightPos");
-    GLuint terrainViewPosLoc = glGetUniformLocation(terrainShaderProgram, "viewPos");
-    GLuint terrainLightColorLoc = glGetUniformLocation(terrainShaderProgram, "lightColor");
+    glm::mat4 model = glm::mat4(1.0f);
+    float nearPlane = 0.1f;
+    float farPlane = 500.0f;
+    // The aspect ratio follows the framebuffer: the window's, or --size when
+    // headless. A minimised window keeps the last one.
+    float aspectRatio = static_cast<float>(headlessOptions.width) / headlessOptions.height;
 
-    glUseProgram(terrainShaderProgram);
-    glUniformMatrix4fv(terrainProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // Per-frame constants and instance data stream through one persistently
+    // mapped ring with three frames in flight
+    FrameRing::get().create(1024 * 1024, 3);
 
     glm::vec3 lightPos(100.0f, 100.0f, 100.0f);
     glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
-
-    glUniform3fv(terrainLightPosLoc, 1, glm::value_ptr(lightPos));
-    glUniform3fv(terrainLightColorLoc, 1, glm::value_ptr(lightColor));
+    FrameUniforms::setLight(lightPos, lightColor);
+
+    // The terrain never moves, so its normal matrix is computed once here
+    glm::mat3 terrainNormalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+    terrainShader.setMat4("model", model);
+    terrainShader.setMat3("normalMatrix", terrainNormalMatrix);
+    terrainShader.setInt("shadowMap", kShadowTextureUnit);
+
+    // The light is treated as directional for shadows, shining from lightPos onto the terrain centre
+    glm::vec3 lightDirection = glm::normalize(lightPos - glm::vec3(gridSize * 0.5f, 0.0f, gridSize * 0.5f));
+    CascadedShadowMap shadowMap;
+    shadowMap.create();
+    for (const auto& chunk : terrain.getChunks())
+        shadowMap.addCaster({ terrainDepthVAO, chunk.indexOffset, chunk.indexCount, model, chunk.bounds });
+
+    // Torches scattered over the terrain, binned into view clusters every frame
+    std::vector<PointLight> pointLights;
+    std::vector<float> torchPhases;
+    for (int i = 0; i < 256; ++i) {
+        float x = randomFloat(0.0f, static_cast<float>(gridSize));
+        float z = randomFloat(0.0f, static_cast<float>(gridSize));
+        pointLights.push_back({ glm::vec3(x, terrain.getHeightAt(x, z) + 1.5f, z), 8.0f, glm::vec3(1.0f, 0.55f, 0.2f), 6.0f });
+        torchPhases.push_back(randomFloat(0.0f, 6.2831853f));
+    }
+    LightClusters lightClusters;
 
     // Sword scattering
     Sword sword("models/Swords/fbx/_sword_1.fbx", "models/Swords/fbx/_sword_2.fbx");
@@ -277,13 +466,7 @@ int main() {
     std::vector<glm::mat4> swordTransforms2;
     float swordScaleFactor = 0.2f; // Example scale factor
     float offset = 7.0f; // Example offset value to control embedding depth
-    sword.scatterSwords(15, gridSize, scale, swordScaleFactor, offset, noise, swordTransforms1, swordTransforms2);
-
-    GLuint swordViewLoc = glGetUniformLocation(swordShaderProgram, "view");
-    GLuint swordProjLoc = glGetUniformLocation(swordShaderProgram, "projection");
-
-    glUseProgram(swordShaderProgram);
-    glUniformMatrix4fv(swordProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    sword.scatterSwords(15, gridSize, scale, swordScaleFactor, offset, noise, swordTransforms1, swordTransforms2, sceneRandom());
 
     // Key scattering
     Key key("models/Key/FBX/rust_key.FBX");
@@ -300,13 +483,21 @@ int main() {
         transform = glm::rotate(transform, glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
         transform = glm::scale(transform, glm::vec3(keyScaleFactor));
         key.addKeyTransform(transform);
+        pointLights.push_back({ glm::vec3(x, y + 0.5f, z), 4.0f, glm::vec3(0.2f, 1.0f, 0.3f), 3.0f }); // Key glow
     }
 
-    GLuint keyViewLoc = glGetUniformLocation(keyShaderProgram, "view");
-    GLuint keyProjLoc = glGetUniformLocation(keyShaderProgram, "projection");
+    // Nothing in the scene moves, so every caster is static and the cascades are cached
+    sword.addShadowCasters(swordTransforms1, swordTransforms2, shadowMap);
+    key.addShadowCasters(shadowMap);
+
+    // Nothing is binned yet, so the impostors bake without point lights
+    lightClusters.upload(pointLights);
 
-    glUseProgram(keyShaderProgram);
-    glUniformMatrix4fv(keyProjLoc, 1, GL_FALSE, glm::value_ptr(projection));
+    // Bake the distant-prop impostors from the loaded meshes
+    sword.bakeImpostors(swordShader);
+    key.bakeImpostor(keyShader);
+
+    AssetMemory::printReport();
 
     // Generate random starting position for the camera
     float startX = randomFloat(0.0f, static_cast<float>(gridSize));
@@ -316,17 +507,59 @@ int main() {
     // Update camera position
     camera.Position = glm::vec3(startX, startY, startZ);
 
-    float deltaTime = 0.0f;
-    float lastFrame = 0.0f;
-
-    // Main rendering loop
-    while (!glfwWindowShouldClose(window)) {
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    bool lodKeyWasDown = false;
+    bool impostorKeyWasDown = false;
+    bool occlusionKeyWasDown = false;
+    bool horizonKeyWasDown = false;
+    bool prepassKeyWasDown = false;
+    bool shadowCacheKeyWasDown = false;
+    bool clusterKeyWasDown = false;
+    bool resolutionKeyWasDown = false;
+    bool sharpenKeyWasDown = false;
+    bool pipelineKeyWasDown = false;
+    bool gpuCullingKeyWasDown = false;
+    bool pullingKeyWasDown = false;
+
+    // Samples the clock and the window for the frame the simulation produces next
+    float lastSampleTime = 0.0f;
+    auto sampleInput = [&](int frame) {
+        SimulationInput input = {};
+        input.frame = frame;
+        // Headless frames advance a fixed step, so flicker and captures repeat exactly
+        input.time = headless ? frame * headlessOptions.frameTime : static_cast<float>(glfwGetTime());
+        input.deltaTime = input.time - lastSampleTime;
+        lastSampleTime = input.time;
+        int framebufferWidth = headlessOptions.width, framebufferHeight = headlessOptions.height;
+        if (window)
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        if (framebufferWidth > 0 && framebufferHeight > 0)
+            aspectRatio = static_cast<float>(framebufferWidth) / framebufferHeight;
+        input.projection = glm::perspective(glm::radians(45.0f), aspectRatio, nearPlane, farPlane);
+        if (window) {
+            input.movement = Camera::SampleKeyboard(window);
+            input.mouseOffset = mouseOffset;
+            mouseOffset = glm::vec2(0.0f);
+        }
+        input.occlusionCulling = Occlusion::settings().enabled;
+        input.horizonCulling = Horizon::settings().enabled;
+        input.gpuCulling = GpuCulling::settings().enabled;
+        return input;
+    };
 
-        // Process input
-        camera.ProcessKeyboard(window, deltaTime);
+    // The camera, the torches and the view culling advance on the simulation
+    // thread, which owns the camera, the occlusion buffer and the horizon from here on
+    SimulationThread simulation([&](const SimulationInput& input, FrameSnapshot& snapshot) {
+        if (headless) {
+            glm::vec2 pathPosition;
+            float pathYaw, pathPitch;
+            Headless::cameraPath(input.frame, headlessOptions.frames, static_cast<float>(gridSize), pathPosition, pathYaw, pathPitch);
+            camera.Position = glm::vec3(pathPosition.x, terrain.getHeightAt(pathPosition.x, pathPosition.y) + 2.0f, pathPosition.y);
+            camera.SetOrientation(pathYaw, pathPitch);
+        }
+        else {
+            camera.ProcessMouseMovement(input.mouseOffset.x, input.mouseOffset.y);
+            camera.ProcessMovement(input.movement, input.deltaTime);
+        }
 
         // Constrain camera position to the terrain bounds
         camera.Position.x = glm::clamp(camera.Position.x, 0.0f, static_cast<float>(gridSize));
@@ -336,49 +569,327 @@ int main() {
         float terrainHeight = terrain.getHeightAt(camera.Position.x, camera.Position.z);
         camera.Position.y = glm::mix(camera.Position.y, terrainHeight + 2.0f, 0.1f); // Smoothly interpolate to the target height
 
+        snapshot.cameraPosition = camera.Position;
+        snapshot.view = camera.GetViewMatrix();
+        snapshot.projection = input.projection;
+
+        // Flicker the torches
+        snapshot.pointLights = pointLights;
+        for (size_t i = 0; i < torchPhases.size(); i++)
+            snapshot.pointLights[i].intensity = 6.0f * (0.85f + 0.15f * std::sin(input.time * 9.0f + torchPhases[i]));
+
+        // Occluders and the horizon are built first so every renderer can test against them
+        glm::mat4 viewProjection = snapshot.projection * snapshot.view;
+        const OcclusionBuffer* occlusion = nullptr;
+        if (input.occlusionCulling) {
+            occlusionBuffer.render(viewProjection);
+            occlusion = &occlusionBuffer;
+        }
+        const HorizonCuller* horizon = nullptr;
+        if (input.horizonCulling) {
+            horizonCuller.update(camera.Position);
+            horizon = &horizonCuller;
+        }
+        ViewCull viewCull = Visibility::build(viewProjection, horizon, occlusion);
+        Visibility::cull(viewCull, terrainChunkBounds, snapshot.visibleChunks);
+        snapshot.gpuCullSwords = input.gpuCulling;
+        if (input.gpuCulling) {
+            snapshot.visibleSwords1.clear();
+            snapshot.visibleSwords2.clear();
+        }
+        else {
+            sword.cullSwords(swordTransforms1, swordTransforms2, viewCull, snapshot.visibleSwords1, snapshot.visibleSwords2);
+        }
+        key.cull(viewCull, snapshot.visibleKeys);
+    });
+    simulation.start();
+    simulation.submit(sampleInput(0));
+
+    // Main rendering loop
+    int frameIndex = 0;
+    while (headless ? frameIndex < headlessOptions.frames : !glfwWindowShouldClose(window)) {
+        auto frameStart = std::chrono::steady_clock::now();
+        RenderStats::beginFrame();
+        FrameRing::get().beginFrame();
+
+        if (headless) {
+            headlessTarget.beginFrame();
+        }
+        else {
+            // Toggle prop LODs to compare triangles per frame
+            bool lodKeyDown = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+            if (lodKeyDown && !lodKeyWasDown) {
+                PropLod::settings().enabled = !PropLod::settings().enabled;
+                std::cout << "Prop LOD " << (PropLod::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            lodKeyWasDown = lodKeyDown;
+
+            bool impostorKeyDown = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+            if (impostorKeyDown && !impostorKeyWasDown) {
+                Impostor::settings().enabled = !Impostor::settings().enabled;
+                std::cout << "Prop impostors " << (Impostor::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            impostorKeyWasDown = impostorKeyDown;
+
+            bool occlusionKeyDown = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+            if (occlusionKeyDown && !occlusionKeyWasDown) {
+                Occlusion::settings().enabled = !Occlusion::settings().enabled;
+                std::cout << "Occlusion culling " << (Occlusion::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            occlusionKeyWasDown = occlusionKeyDown;
+
+            bool horizonKeyDown = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+            if (horizonKeyDown && !horizonKeyWasDown) {
+                Horizon::settings().enabled = !Horizon::settings().enabled;
+                std::cout << "Horizon culling " << (Horizon::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            horizonKeyWasDown = horizonKeyDown;
+
+            // Toggle the depth pre-pass to compare the GPU shading time
+            bool prepassKeyDown = glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS;
+            if (prepassKeyDown && !prepassKeyWasDown) {
+                DepthPrepass::settings().enabled = !DepthPrepass::settings().enabled;
+                std::cout << "Depth pre-pass " << (DepthPrepass::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            prepassKeyWasDown = prepassKeyDown;
+
+            // Toggle shadow caching to compare against re-rendering every cascade
+            bool shadowCacheKeyDown = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+            if (shadowCacheKeyDown && !shadowCacheKeyWasDown) {
+                Shadows::settings().cacheStatic = !Shadows::settings().cacheStatic;
+                std::cout << "Shadow cascade caching " << (Shadows::settings().cacheStatic ? "enabled" : "disabled") << std::endl;
+            }
+            shadowCacheKeyWasDown = shadowCacheKeyDown;
+
+            // Toggle the clustered point lights
+            bool clusterKeyDown = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+            if (clusterKeyDown && !clusterKeyWasDown) {
+                Clusters::settings().enabled = !Clusters::settings().enabled;
+                std::cout << "Clustered point lights " << (Clusters::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            clusterKeyWasDown = clusterKeyDown;
+
+            // Toggle dynamic resolution and the sharpening upscale
+            bool resolutionKeyDown = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+            if (resolutionKeyDown && !resolutionKeyWasDown) {
+                DynamicResolution::settings().enabled = !DynamicResolution::settings().enabled;
+                std::cout << "Dynamic resolution " << (DynamicResolution::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            resolutionKeyWasDown = resolutionKeyDown;
+
+            bool sharpenKeyDown = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+            if (sharpenKeyDown && !sharpenKeyWasDown) {
+                DynamicResolution::settings().sharpen = !DynamicResolution::settings().sharpen;
+                std::cout << "Upscale sharpening " << (DynamicResolution::settings().sharpen ? "enabled" : "disabled") << std::endl;
+            }
+            sharpenKeyWasDown = sharpenKeyDown;
+
+            // Toggle pipelining to compare against simulating and rendering in turn
+            bool pipelineKeyDown = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+            if (pipelineKeyDown && !pipelineKeyWasDown) {
+                Simulation::settings().pipelined = !Simulation::settings().pipelined;
+                std::cout << "Pipelined simulation " << (Simulation::settings().pipelined ? "enabled" : "disabled") << std::endl;
+            }
+            pipelineKeyWasDown = pipelineKeyDown;
+
+            // Toggle the compute culling of the swords against the CPU culling
+            bool gpuCullingKeyDown = glfwGetKey(window, GLFW_KEY_U) == GLFW_PRESS;
+            if (gpuCullingKeyDown && !gpuCullingKeyWasDown) {
+                GpuCulling::settings().enabled = !GpuCulling::settings().enabled;
+                depthPyramid.release(); // Its camera is stale once re-enabled
+                std::cout << "GPU culling " << (GpuCulling::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            gpuCullingKeyWasDown = gpuCullingKeyDown;
+
+            // Toggle vertex pulling against the per-layout vertex arrays
+            bool pullingKeyDown = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+            if (pullingKeyDown && !pullingKeyWasDown) {
+                VertexPulling::settings().enabled = !VertexPulling::settings().enabled;
+                std::cout << "Vertex pulling " << (VertexPulling::settings().enabled ? "enabled" : "disabled") << std::endl;
+            }
+            pullingKeyWasDown = pullingKeyDown;
+        }
+
+        // Pipelined, the next frame is simulated while this one is submitted
+        const FrameSnapshot& snapshot = simulation.acquire();
+        bool pipelined = Simulation::settings().pipelined;
+        if (pipelined)
+            simulation.submit(sampleInput(frameIndex + 1));
+        const glm::mat4& view = snapshot.view;
+        const glm::mat4& projection = snapshot.projection;
+        float frameTime = snapshot.time;
+
+        // The scene goes to the scaled target, so the clear and every pass after it land there
+        int framebufferWidth = headlessOptions.width, framebufferHeight = headlessOptions.height;
+        if (window)
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        resolutionScaler.beginScene(framebufferWidth, framebufferHeight);
+        glm::ivec2 sceneSize = resolutionScaler.sceneSize();
+
         // Clear the screen
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Render the terrain
-        glUseProgram(terrainShaderProgram);
-        glm::mat4 view = camera.GetViewMatrix();
-        glUniformMatrix4fv(terrainViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        glUniformMatrix4fv(terrainModelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glUniform3fv(terrainViewPosLoc, 1, glm::value_ptr(camera.Position));
-        glBindVertexArray(terrainVAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-        // Render the swords
-        glUseProgram(swordShaderProgram);
-        glUniformMatrix4fv(swordViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        sword.renderSwords(swordTransforms1, swordTransforms2, swordShaderProgram);
-
-        // Render the keys
-        glUseProgram(keyShaderProgram);
-        glUniformMatrix4fv(keyViewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        key.render(view, projection, keyShaderProgram);
-
-        // Render the signature quad
-        glUseProgram(quadShaderProgram);
-        glBindVertexArray(quadVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, signatureTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glBindVertexArray(0);
-
-        // Swap buffers and poll IO events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        // One upload of the camera for every program this frame
+        FrameUniforms::setCamera(view, projection, snapshot.cameraPosition);
+        FrameUniforms::upload();
+
+        // Only cascades the camera has left or that hold moving casters are drawn
+        shadowMap.update(view, projection, nearPlane, lightDirection, shadowShader);
+
+        // Bin every light into the clusters it reaches
+        lightClusters.build(snapshot.pointLights, view, projection, nearPlane, farPlane, sceneSize.x, sceneSize.y);
+        lightClusters.upload(snapshot.pointLights);
+
+        // Every subsystem queues its draws; the queue sorts and submits them
+        renderQueue.begin(view, nearPlane, farPlane);
+
+        bool pulling = VertexPulling::settings().enabled;
+        if (pulling && !vertexPool.created()) {
+            terrainPulled = vertexPool.add(VertexPulling::fromVertices(VertexPulling::readBuffer<Vertex>(terrainVBO)),
+                VertexPulling::readBuffer<unsigned int>(terrainEBO), MemorySubsystem::Terrain, "terrain mesh");
+            sword.addToPool(vertexPool);
+            pulling = VertexPulling::settings().enabled = vertexPool.create();
+        }
+
+        // Queue the visible terrain chunks as one multi-draw
+        chunkCounts.clear();
+        chunkOffsets.clear();
+        GLsizei visibleTerrainIndices = 0;
+        for (auto index : snapshot.visibleChunks) {
+            const TerrainChunk& chunk = terrain.getChunks()[index];
+            chunkCounts.push_back(static_cast<GLsizei>(chunk.indexCount));
+            chunkOffsets.push_back((void*)(chunk.indexOffset * sizeof(unsigned int)));
+            visibleTerrainIndices += static_cast<GLsizei>(chunk.indexCount);
+        }
+        if (pulling) {
+            terrainDraws.clear();
+            for (auto index : snapshot.visibleChunks) {
+                const TerrainChunk& chunk = terrain.getChunks()[index];
+                terrainDraws.add(terrainPulled, chunk.indexOffset, chunk.indexCount, model, terrainNormalMatrix);
+            }
+            if (!terrainDraws.empty()) {
+                DrawItem terrainItem = { RenderPass::Opaque, &pulledTerrainShader, 0, vertexPool.vertexArray(), 0, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+                terrainItem.draw = [&] { terrainDraws.draw(vertexPool); };
+                renderQueue.add(terrainItem, snapshot.cameraPosition);
+            }
+        }
+        else if (!chunkCounts.empty()) {
+            DrawItem terrainItem = { RenderPass::Opaque, &terrainShader, 0, terrainVAO, terrainDepthVAO, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+            terrainItem.model = model;
+            terrainItem.draw = [&] {
+                glMultiDrawElements(GL_TRIANGLES, chunkCounts.data(), GL_UNSIGNED_INT, chunkOffsets.data(), static_cast<GLsizei>(chunkCounts.size()));
+                RenderStats::countDraw(visibleTerrainIndices);
+            };
+            renderQueue.add(terrainItem, snapshot.cameraPosition); // Surrounds the camera, so it goes first
+        }
+
+        // Queue the swords and keys. GPU-culled swords test against last frame's depth pyramid.
+        if (snapshot.gpuCullSwords) {
+            sword.cullSwordsGpu(swordTransforms1, swordTransforms2, cullShader, view, projection, depthPyramid);
+            sword.queueSwordsGpu(swordIndirectShader, snapshot.cameraPosition, renderQueue);
+        }
+        else if (pulling) {
+            sword.queueSwordsPulled(swordTransforms1, swordTransforms2, snapshot.visibleSwords1, snapshot.visibleSwords2, pulledSwordShader, view, projection, vertexPool, renderQueue);
+        }
+        else {
+            sword.queueSwords(swordTransforms1, swordTransforms2, snapshot.visibleSwords1, snapshot.visibleSwords2, swordShader, view, projection, renderQueue);
+        }
+        key.queue(view, projection, keyShader, snapshot.visibleKeys, renderQueue);
+
+        // Queue the distant props batched as impostors
+        sword.queueImpostors(impostorShader, renderQueue);
+        key.queueImpostors(impostorShader, renderQueue);
+
+        // Rebuild the overlay; it only re-uploads when a toggle or the fps changes
+        auto onOff = [](bool enabled) { return enabled ? "on" : "off"; };
+        std::string hud = std::to_string(static_cast<int>(RenderStats::framesPerSecond() + 0.5f)) + " fps\n"
+            + "[L] LOD " + onOff(PropLod::settings().enabled) + "  [I] impostors " + onOff(Impostor::settings().enabled)
+            + "  [O] occlusion " + onOff(Occlusion::settings().enabled) + "  [H] horizon " + onOff(Horizon::settings().enabled) + "\n"
+            + "[P] depth pre-pass " + onOff(DepthPrepass::settings().enabled) + "  [C] shadow cache " + onOff(Shadows::settings().cacheStatic)
+            + "  [G] point lights " + onOff(Clusters::settings().enabled) + "\n"
+            + "[R] dynamic resolution " + onOff(DynamicResolution::settings().enabled)
+            + " (" + std::to_string(static_cast<int>(resolutionScaler.scale() * 100.0f + 0.5f)) + "%)"
+            + "  [F] sharpen " + onOff(DynamicResolution::settings().sharpen) + "  [T] pipelined " + onOff(Simulation::settings().pipelined)
+            + "\n[U] GPU culling " + onOff(GpuCulling::settings().enabled) + "  [V] vertex pulling " + onOff(VertexPulling::settings().enabled);
+        overlay.begin();
+        overlay.sprite(signatureSprite, glm::vec2(40.0f, 30.0f), glm::vec2(80.0f, 60.0f));
+        overlay.text(hud, glm::vec2(141.0f, 31.0f), 1, glm::vec4(0.0f, 0.0f, 0.0f, 0.6f)); // Drop shadow
+        overlay.text(hud, glm::vec2(140.0f, 30.0f), 1, glm::vec4(1.0f, 0.95f, 0.8f, 1.0f));
+        overlay.end();
+
+        renderQueue.submit();
+
+        // The finished scene depth becomes the next frame's occluders
+        if (snapshot.gpuCullSwords && GpuCulling::settings().occlusion)
+            depthPyramid.build(pyramidShader, sceneSize.x, sceneSize.y, projection * view);
+
+        // Upscale into the output, then draw the overlay on top at full resolution
+        resolutionScaler.endScene(upscaleShader);
+        overlayQueue.begin(view, nearPlane, farPlane);
+        overlay.queue(spriteShader, overlayQueue, framebufferWidth, framebufferHeight);
+        overlayQueue.submit();
+        resolutionScaler.update(std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        frameCapture.capture(frameIndex, framebufferWidth, framebufferHeight);
+
+        simulation.release();
+        if (!pipelined)
+            simulation.submit(sampleInput(frameIndex + 1));
+
+        FrameRing::get().endFrame();
+        RenderStats::endFrame(frameTime);
+
+        if (headless) {
+            headlessTarget.endFrame(frameIndex);
+        }
+        else {
+            // Swap buffers and poll IO events
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+        frameIndex++;
     }
+    simulation.stop();
+    frameCapture.finish();
+    if (headless)
+        headlessTarget.finish();
 
     // Clean up and exit
     glDeleteVertexArrays(1, &terrainVAO);
     glDeleteBuffers(1, &terrainVBO);
     glDeleteBuffers(1, &terrainEBO);
-    glDeleteProgram(terrainShaderProgram);
-    glDeleteProgram(swordShaderProgram);
-    glDeleteProgram(keyShaderProgram);
-
-    glfwTerminate();
+    glDeleteVertexArrays(1, &terrainDepthVAO);
+    glDeleteBuffers(1, &terrainPositionVBO);
+    terrainShader.release();
+    swordShader.release();
+    swordIndirectShader.release();
+    cullShader.release();
+    pyramidShader.release();
+    depthPyramid.release();
+    sword.releaseGpuCulling();
+    pulledTerrainShader.release();
+    pulledSwordShader.release();
+    vertexPool.release();
+    keyShader.release();
+    impostorShader.release();
+    spriteShader.release();
+    overlay.release();
+    upscaleShader.release();
+    resolutionScaler.release();
+    frameCapture.release();
+    overlayQueue.release();
+    depthShader.release();
+    shadowShader.release();
+    shadowMap.release();
+    renderQueue.release();
+    FrameRing::get().release();
+    JobSystem::shutdown();
+
+    if (headless) {
+        headlessTarget.release();
+        Headless::destroyContext();
+    }
+    else {
+        glfwTerminate();
+    }
     return 0;
     }
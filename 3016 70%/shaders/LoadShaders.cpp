@@ -9,6 +9,30 @@
 
 #include "glew.h"
 #include "LoadShaders.h"
+#include "../VirtualFileSystem.h"
+
+//----------------------------------------------------------------------------
+
+// Returns a view of the shader source from the mounted pack or the loose
+// file; the text is not null-terminated, so its length goes to glShaderSource
+static FileView
+	ReadShader(const char* filename)
+{
+	FileView source = Vfs::open(filename);
+
+	if (!source.valid()) {
+#ifdef _DEBUG
+		std::cerr << "Unable to open shader file '" << filename << "'" << std::endl;
+#endif /* DEBUG */
+		return source;
+	}
+
+#ifdef _DEBUG
+	std::cerr << "Shader file '" << filename << "' read successfully, length: " << source.size() << " bytes." << std::endl;
+#endif /* DEBUG */
+
+	return source;
+}
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,54 +50,6 @@ extern "C" {
 
 	//----------------------------------------------------------------------------
 
-	static const GLchar*
-		ReadShader(const char* filename)
-	{
-		// Attempt to open the shader file
-		FILE* infile;
-		fopen_s(&infile, filename, "rb");
-
-		if (!infile) {
-#ifdef _DEBUG
-			std::cerr << "Unable to open shader file '" << filename << "'" << std::endl;
-#endif /* DEBUG */
-			return NULL;
-		}
-
-		// Get the file length
-		fseek(infile, 0, SEEK_END);
-		long len = ftell(infile); // Use long to avoid overflow issues
-		fseek(infile, 0, SEEK_SET);
-
-		// Read the shader source code
-		GLchar* source = new GLchar[len + 1]; // Allocate space for null terminator
-
-		// Check if memory allocation is successful
-		if (source == nullptr) {
-			std::cerr << "Memory allocation for shader source failed!" << std::endl;
-			fclose(infile);
-			return NULL;
-		}
-
-		size_t bytesRead = fread(source, 1, len, infile);
-		if (bytesRead != len) {
-			std::cerr << "Error reading shader file '" << filename << "'. Expected " << len << " bytes, but read " << bytesRead << " bytes." << std::endl;
-			delete[] source;
-			fclose(infile);
-			return NULL;
-		}
-
-		fclose(infile);
-
-		source[len] = 0; // Null-terminate the shader code
-
-#ifdef _DEBUG
-		std::cerr << "Shader file '" << filename << "' read successfully, length: " << len << " bytes." << std::endl;
-#endif /* DEBUG */
-
-		return const_cast<const GLchar*>(source);
-	}
-
 	//----------------------------------------------------------------------------
 
 	GLuint
@@ -106,8 +82,8 @@ extern "C" {
 			entry->shader = shader;
 
 			// Read shader source code
-			const GLchar* source = ReadShader(entry->filename);
-			if (source == NULL) {
+			FileView source = ReadShader(entry->filename);
+			if (!source.valid()) {
 #ifdef _DEBUG
 				std::cerr << "Failed to read shader file: " << entry->filename << std::endl;
 #endif /* DEBUG */
@@ -120,8 +96,9 @@ extern "C" {
 			}
 
 			// Compile shader
-			glShaderSource(shader, 1, &source, NULL);
-			delete[] source;
+			const GLchar* text = reinterpret_cast<const GLchar*>(source.data());
+			GLint length = static_cast<GLint>(source.size());
+			glShaderSource(shader, 1, &text, &length);
 
 			glCompileShader(shader);
 
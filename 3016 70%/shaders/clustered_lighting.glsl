@@ -0,0 +1,67 @@
+#version 460 core
+
+// Linked into the lit fragment programs; callers declare
+// vec3 clusteredLighting(vec3 worldPos, vec3 normal);
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+layout(std140, binding = 2) uniform ClusterData {
+    uvec4 clusterGrid;  // Tiles across, tiles down, depth slices, light count
+    vec4 clusterDepth;  // Slice = log(view depth) * x + y
+    vec4 clusterScreen; // Viewport size and its reciprocal
+};
+
+struct PointLight {
+    vec4 positionRadius;
+    vec4 colorIntensity;
+};
+
+layout(std430, binding = 0) readonly buffer PointLights {
+    PointLight pointLights[];
+};
+
+// (offset, count) into lightIndices per cluster, x fastest, then y, then slice
+layout(std430, binding = 1) readonly buffer LightClusters {
+    uvec2 clusterRanges[];
+};
+
+layout(std430, binding = 2) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+// Diffuse light from the point lights binned into the fragment's cluster
+vec3 clusteredLighting(vec3 worldPos, vec3 normal) {
+    if (clusterGrid.w == 0u)
+        return vec3(0.0);
+
+    float depth = -(view * vec4(worldPos, 1.0)).z;
+    int slice = clamp(int(floor(log(depth) * clusterDepth.x + clusterDepth.y)), 0, int(clusterGrid.z) - 1);
+    uvec2 tile = min(uvec2(gl_FragCoord.xy * clusterScreen.zw * vec2(clusterGrid.xy)), clusterGrid.xy - 1u);
+    uvec2 range = clusterRanges[(uint(slice) * clusterGrid.y + tile.y) * clusterGrid.x + tile.x];
+
+    vec3 n = normalize(normal);
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        PointLight light = pointLights[lightIndices[range.x + i]];
+        vec3 toLight = light.positionRadius.xyz - worldPos;
+        float distanceSquared = dot(toLight, toLight);
+        float radius = light.positionRadius.w;
+        if (distanceSquared >= radius * radius)
+            continue;
+
+        // Inverse square falloff windowed to reach zero at the radius
+        float ratio = distanceSquared / (radius * radius);
+        float window = (1.0 - ratio) * (1.0 - ratio);
+        float attenuation = window / (1.0 + distanceSquared);
+        float diffuse = max(dot(n, toLight * inversesqrt(distanceSquared + 1e-6)), 0.0);
+        result += light.colorIntensity.rgb * light.colorIntensity.w * diffuse * attenuation;
+    }
+    return result;
+}
@@ -0,0 +1,12 @@
+#version 460 core
+
+uniform vec2 lodFade; // Same dithered crossfade as the shading pass
+
+const float bayer4x4[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
+void main() {
+    ivec2 cell = ivec2(gl_FragCoord.xy) & 3;
+    float dither = (bayer4x4[cell.y * 4 + cell.x] + 0.5) / 16.0;
+    if ((dither < lodFade.x) != (lodFade.y > 0.5))
+        discard;
+}
@@ -0,0 +1,29 @@
+#version 460 core
+
+layout(local_size_x = 8, local_size_y = 8) in;
+
+uniform sampler2D source;
+uniform int sourceLevel;
+
+layout(r32f, binding = 0) uniform writeonly image2D target;
+
+// Each target texel keeps the farthest depth of the source texels it
+// overlaps. With odd sizes some overlap a third row or column, so every
+// level stays conservative.
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 targetSize = imageSize(target);
+    if (any(greaterThanEqual(texel, targetSize)))
+        return;
+
+    ivec2 sourceSize = max(textureSize(source, 0) >> sourceLevel, ivec2(1));
+    ivec2 first = texel * sourceSize / targetSize;
+    ivec2 last = ((texel + 1) * sourceSize + targetSize - 1) / targetSize - 1;
+
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++)
+            depth = max(depth, texelFetch(source, ivec2(x, y), sourceLevel).r);
+    }
+    imageStore(target, texel, vec4(depth));
+}
@@ -0,0 +1,21 @@
+#version 460 core
+
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// Must match the shading vertex shaders bit for bit so GL_EQUAL passes
+invariant gl_Position;
+
+void main() {
+    gl_Position = viewProjection * model * vec4(aPos, 1.0);
+}
@@ -0,0 +1,173 @@
+#version 460 core
+
+layout(local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std140, binding = 3) uniform CullData {
+    vec4 planes[6];
+    mat4 view;
+    mat4 pyramidViewProjection;
+    vec4 lodScreenSizes; // Thresholds below levels 0-2, then the cull size
+    vec4 projectionScale; // x: projection[1][1]
+    uvec4 counts;         // Instances, meshes, flags (1 LOD, 2 occlusion), pyramid levels
+    vec4 meshBounds[16];
+    uvec4 meshRanges[16]; // First command, LOD count
+};
+
+layout(std430, binding = 3) readonly buffer InstanceTransforms {
+    mat4 transforms[];
+};
+
+layout(std430, binding = 4) writeonly buffer VisibleInstances {
+    uint visibleInstances[];
+};
+
+layout(std430, binding = 5) readonly buffer InstanceBounds {
+    vec4 bounds[]; // World box centre and extent per instance
+};
+
+layout(std430, binding = 6) buffer DrawCommands {
+    DrawCommand commands[];
+};
+
+layout(std430, binding = 7) writeonly buffer CullResults {
+    uint results[];
+};
+
+uniform sampler2D depthPyramid;
+
+const uint kOutsideFrustum = 0u;
+const uint kOccluded = 1u;
+const uint kVisible = 2u;
+
+// The arithmetic below is precise and ordered as the CPU code it mirrors
+// (FrustumCuller's SSE path, glm's matrix products), so both reach the same
+// verdict on boxes that touch a plane or a threshold
+
+bool outsideFrustum(vec3 center, vec3 extent) {
+    for (int p = 0; p < 6; p++) {
+        vec4 plane = planes[p];
+        precise float distance = (plane.x * center.x + plane.y * center.y) + (plane.z * center.z + plane.w);
+        precise float radius = (abs(plane.x) * extent.x + abs(plane.y) * extent.y) + abs(plane.z) * extent.z;
+        precise float sum = distance + radius;
+        if (sum < 0.0)
+            return true;
+    }
+    return false;
+}
+
+// Rejects the box when its nearest point lies behind the farthest depth
+// the pyramid holds over its screen rectangle, tested on the coarsest
+// level where the rectangle covers at most 2x2 texels
+bool occluded(vec3 center, vec3 extent) {
+    precise vec3 boxMin = center - extent;
+    precise vec3 boxMax = center + extent;
+    vec2 minNdc = vec2(1e30), maxNdc = vec2(-1e30);
+    float nearest = 1e30;
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 point = vec3((corner & 1) != 0 ? boxMax.x : boxMin.x, (corner & 2) != 0 ? boxMax.y : boxMin.y, (corner & 4) != 0 ? boxMax.z : boxMin.z);
+        precise vec4 clip = (pyramidViewProjection[0] * point.x + pyramidViewProjection[1] * point.y)
+            + (pyramidViewProjection[2] * point.z + pyramidViewProjection[3]);
+        if (clip.z < -clip.w)
+            return false; // Crosses the near plane, too close to reject
+        precise vec3 ndc = clip.xyz / clip.w;
+        minNdc = min(minNdc, ndc.xy);
+        maxNdc = max(maxNdc, ndc.xy);
+        precise float depth = ndc.z * 0.5 + 0.5;
+        nearest = min(nearest, depth);
+    }
+
+    // Parts outside the pyramid's view were never in its depth
+    if (minNdc.x < -1.0 || minNdc.y < -1.0 || maxNdc.x > 1.0 || maxNdc.y > 1.0)
+        return false;
+
+    precise vec2 minUv = minNdc * 0.5 + 0.5;
+    precise vec2 maxUv = maxNdc * 0.5 + 0.5;
+    int levels = int(counts.w);
+    // Level sizes are derived from level 0, as the CPU reference derives them
+    ivec2 baseSize = textureSize(depthPyramid, 0);
+    int level = 0;
+    ivec2 first, last;
+    for (;;) {
+        ivec2 size = max(baseSize >> level, ivec2(1));
+        precise vec2 firstTexel = minUv * vec2(size);
+        precise vec2 lastTexel = maxUv * vec2(size);
+        first = min(ivec2(firstTexel), size - 1);
+        last = min(ivec2(lastTexel), size - 1);
+        if ((last.x - first.x <= 1 && last.y - first.y <= 1) || level == levels - 1)
+            break;
+        level++;
+    }
+
+    float farthest = 0.0;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++)
+            farthest = max(farthest, texelFetch(depthPyramid, ivec2(x, y), level).r);
+    }
+    return nearest > farthest;
+}
+
+// PropLod::projectedScreenSize
+float screenSize(vec4 sphere, mat4 model) {
+    precise mat4 modelView;
+    for (int c = 0; c < 4; c++)
+        modelView[c] = ((view[0] * model[c][0] + view[1] * model[c][1]) + view[2] * model[c][2]) + view[3] * model[c][3];
+    precise vec4 viewCenter = (modelView[0] * sphere.x + modelView[1] * sphere.y) + (modelView[2] * sphere.z + modelView[3]);
+    precise float scale0 = sqrt((model[0].x * model[0].x + model[0].y * model[0].y) + model[0].z * model[0].z);
+    precise float scale1 = sqrt((model[1].x * model[1].x + model[1].y * model[1].y) + model[1].z * model[1].z);
+    precise float scale2 = sqrt((model[2].x * model[2].x + model[2].y * model[2].y) + model[2].z * model[2].z);
+    precise float radius = sphere.w * max(scale0, max(scale1, scale2));
+    precise float distance = sqrt((viewCenter.x * viewCenter.x + viewCenter.y * viewCenter.y) + viewCenter.z * viewCenter.z);
+    if (distance <= radius)
+        return 1.0; // Camera inside the bounds
+    precise float size = radius * projectionScale.x / distance;
+    return size;
+}
+
+// PropLod::selectLod without the crossfade; -1 when culled
+int selectLevel(float size, int levelCount) {
+    int level = 0;
+    while (level < levelCount - 1 && level < 3 && size < lodScreenSizes[level])
+        level++;
+    float threshold = level < levelCount - 1 ? lodScreenSizes[level] : lodScreenSizes.w;
+    return size < threshold ? -1 : level;
+}
+
+void main() {
+    uint instance = gl_GlobalInvocationID.x;
+    if (instance >= counts.x)
+        return;
+
+    vec3 center = bounds[instance * 2u].xyz;
+    vec3 extent = bounds[instance * 2u + 1u].xyz;
+    if (outsideFrustum(center, extent)) {
+        results[instance] = kOutsideFrustum;
+        return;
+    }
+    if ((counts.z & 2u) != 0u && occluded(center, extent)) {
+        results[instance] = kOccluded;
+        return;
+    }
+    results[instance] = kVisible;
+
+    // Each mesh appends the instance to the command of its LOD
+    mat4 model = transforms[instance];
+    for (uint mesh = 0u; mesh < counts.y; mesh++) {
+        int level = 0;
+        if ((counts.z & 1u) != 0u) {
+            level = selectLevel(screenSize(meshBounds[mesh], model), int(meshRanges[mesh].y));
+            if (level < 0)
+                continue;
+        }
+        uint command = meshRanges[mesh].x + uint(level);
+        uint slot = atomicAdd(commands[command].instanceCount, 1u);
+        visibleInstances[commands[command].baseInstance + slot] = instance;
+    }
+}
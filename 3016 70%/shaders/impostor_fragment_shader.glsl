@@ -0,0 +1,25 @@
+#version 460 core
+
+out vec4 FragColor;
+
+in vec2 LocalUV;
+in vec2 Frame;
+
+uniform sampler2D atlas;
+uniform float framesPerSide;
+
+vec4 sampleFrame(vec2 frame) {
+    frame = clamp(frame, vec2(0.0), vec2(framesPerSide - 1.0));
+    return texture(atlas, (frame + LocalUV) / framesPerSide);
+}
+
+void main() {
+    // Blend the four baked views closest to the current view direction
+    vec2 base = floor(Frame);
+    vec2 t = Frame - base;
+    vec4 color = mix(mix(sampleFrame(base), sampleFrame(base + vec2(1.0, 0.0)), t.x),
+                     mix(sampleFrame(base + vec2(0.0, 1.0)), sampleFrame(base + vec2(1.0, 1.0)), t.x), t.y);
+    if (color.a < 0.5)
+        discard;
+    FragColor = vec4(color.rgb / color.a, 1.0);
+}
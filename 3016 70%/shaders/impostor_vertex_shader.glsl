@@ -0,0 +1,26 @@
+#version 460 core
+
+layout(location = 0) in vec2 aCorner;
+layout(location = 1) in vec3 aCenter;
+layout(location = 2) in vec3 aRight;
+layout(location = 3) in vec3 aUp;
+layout(location = 4) in vec2 aFrame;
+
+out vec2 LocalUV;
+out vec2 Frame;
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+void main() {
+    vec3 worldPos = aCenter + aRight * aCorner.x + aUp * aCorner.y;
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
+    LocalUV = aCorner * 0.5 + 0.5;
+    Frame = aFrame;
+}
@@ -1,6 +1,22 @@
-#version 330 core
+#version 460 core
 out vec4 FragColor;
 
+in vec3 FragPos;
+in vec3 Normal;
+
+uniform vec2 lodFade; // x: dither threshold, y: 1 keeps cells below it, 0 keeps cells at or above it
+
+vec3 clusteredLighting(vec3 worldPos, vec3 normal);
+
+const float bayer4x4[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+
 void main() {
-    FragColor = vec4(0.0, 1.0, 0.0, 1.0); // Solid green color
+    // Dithered LOD crossfade
+    ivec2 cell = ivec2(gl_FragCoord.xy) & 3;
+    float dither = (bayer4x4[cell.y * 4 + cell.x] + 0.5) / 16.0;
+    if ((dither < lodFade.x) != (lodFade.y > 0.5))
+        discard;
+
+    vec3 green = vec3(0.0, 1.0, 0.0);
+    FragColor = vec4(green * (1.0 + clusteredLighting(FragPos, Normal)), 1.0);
 }
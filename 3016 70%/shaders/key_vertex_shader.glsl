@@ -1,14 +1,26 @@
-#version 330 core
+#version 460 core
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec2 aTexCoord;
+layout(location = 1) in vec3 aNormal;
 
-out vec2 TexCoord;
+out vec3 FragPos;
+out vec3 Normal;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+invariant gl_Position;
 
 void main() {
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    TexCoord = aTexCoord;
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * model * vec4(aPos, 1.0); // Matches the depth pre-pass expression
+    FragPos = worldPos.xyz;
+    Normal = mat3(model) * aNormal;
 }
@@ -0,0 +1,56 @@
+#version 460 core
+
+// Programmable vertex pulling: vertices come from the pool's storage buffer
+// by gl_VertexID, which already includes the command's base vertex, so one
+// vertex array serves every mesh. The outputs cover both the terrain and the
+// prop fragment shaders.
+
+// Instance index, advancing from the command's base instance. An attribute
+// rather than gl_BaseInstance, which llvmpipe does not have.
+layout(location = 0) in uint aInstance;
+
+struct PulledVertex {
+    vec4 positionU;
+    vec4 normalV;
+    vec4 color;
+};
+
+struct PulledInstance {
+    mat4 model;
+    mat4 normalMatrix;
+};
+
+layout(std430, binding = 8) readonly buffer PulledVertices {
+    PulledVertex vertices[];
+};
+
+layout(std430, binding = 9) readonly buffer PulledInstances {
+    PulledInstance instances[];
+};
+
+out vec3 ourColor;
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+invariant gl_Position;
+
+void main() {
+    PulledVertex vertex = vertices[gl_VertexID];
+    mat4 model = instances[aInstance].model;
+    vec4 worldPos = model * vec4(vertex.positionU.xyz, 1.0);
+    gl_Position = viewProjection * worldPos;
+    FragPos = worldPos.xyz;
+    Normal = mat3(instances[aInstance].normalMatrix) * vertex.normalV.xyz;
+    ourColor = vertex.color.rgb;
+    TexCoord = vec2(vertex.positionU.w, vertex.normalV.w);
+}
@@ -0,0 +1,10 @@
+#version 460 core
+
+layout(location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 lightViewProjection; // Cascade being rendered
+
+void main() {
+    gl_Position = lightViewProjection * model * vec4(aPos, 1.0);
+}
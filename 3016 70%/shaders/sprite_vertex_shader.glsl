@@ -0,0 +1,17 @@
+#version 460 core
+
+layout(location = 0) in vec2 aPos;      // Pixels from the top-left corner
+layout(location = 1) in vec2 aTexCoord;
+layout(location = 2) in vec4 aColor;
+
+out vec2 TexCoord;
+out vec4 Color;
+
+uniform vec2 viewportSize;
+
+void main() {
+    vec2 ndc = aPos / viewportSize * 2.0 - 1.0;
+    gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    TexCoord = aTexCoord;
+    Color = aColor;
+}
@@ -0,0 +1,38 @@
+#version 460 core
+
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec2 aTexCoord;
+layout(location = 2) in vec3 aNormal;
+
+// Visible instance index written by the GPU cull. The attribute advances per
+// instance from the command's base instance, which works without
+// ARB_shader_draw_parameters (llvmpipe has no gl_BaseInstance).
+layout(location = 3) in uint aInstance;
+
+out vec2 TexCoord;
+out vec3 FragPos;
+out vec3 Normal;
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+layout(std430, binding = 3) readonly buffer InstanceTransforms {
+    mat4 transforms[];
+};
+
+invariant gl_Position;
+
+void main() {
+    mat4 model = transforms[aInstance];
+    vec4 worldPos = model * vec4(aPos, 1.0);
+    gl_Position = viewProjection * worldPos;
+    TexCoord = aTexCoord;
+    FragPos = worldPos.xyz;
+    Normal = mat3(model) * aNormal;
+}
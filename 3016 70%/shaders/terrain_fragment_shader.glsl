@@ -7,30 +7,72 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
 uniform sampler2D texture1;
+uniform sampler2DArrayShadow shadowMap;
+
+layout(std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+layout(std140, binding = 1) uniform ShadowData {
+    mat4 lightViewProjection[4];
+    vec4 cascadeEnds;      // View-space distance where each cascade ends
+    vec4 cascadeTexelSize; // World size of one shadow texel per cascade
+    vec4 shadowLight;      // xyz towards the light, w is 1 when shadows are on
+};
+
+vec3 clusteredLighting(vec3 worldPos, vec3 normal);
+
+// Fraction of the directional light reaching the fragment
+float shadowFactor(vec3 norm) {
+    float depth = -(view * vec4(FragPos, 1.0)).z;
+    if (shadowLight.w < 0.5 || depth > cascadeEnds[3])
+        return 1.0;
+
+    int cascade = 0;
+    while (cascade < 3 && depth > cascadeEnds[cascade])
+        cascade++;
+
+    // Offset along the normal by a texel or so to keep slopes free of acne
+    vec3 offsetPos = FragPos + norm * cascadeTexelSize[cascade] * 1.5;
+    vec4 lightClip = lightViewProjection[cascade] * vec4(offsetPos, 1.0);
+    vec3 coord = lightClip.xyz * 0.5 + 0.5;
+
+    // 3x3 taps, each a bilinear 2x2 comparison
+    float texel = 1.0 / float(textureSize(shadowMap, 0).x);
+    float lit = 0.0;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++)
+            lit += texture(shadowMap, vec4(coord.xy + vec2(x, y) * texel, float(cascade), coord.z));
+    }
+    return lit / 9.0;
+}
 
 void main() {
     // Ambient
     float ambientStrength = 0.1;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.rgb;
     
     // Diffuse 
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.rgb;
     
     // Specular
     float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;  
+    vec3 specular = specularStrength * spec * lightColor.rgb;  
     
-    vec3 result = (ambient + diffuse + specular) * ourColor;
+    float shadow = shadowFactor(norm);
+    vec3 result = (ambient + shadow * (diffuse + specular) + clusteredLighting(FragPos, norm)) * ourColor;
     vec4 textureColor = texture(texture1, TexCoord);
     FragColor = vec4(result, 1.0) * textureColor;
 }
@@ -0,0 +1,33 @@
+#version 460 core
+
+out vec4 FragColor;
+
+uniform sampler2D scene;
+uniform vec2 uvScale;    // Rendered part of the scene texture
+uniform vec2 texelSize;  // One scene texel in texture coordinates
+uniform vec2 outputSize;
+uniform float sharpness; // 0 is plain bilinear
+
+void main() {
+    // Keep the filter footprint inside the rendered part
+    vec2 lower = 0.5 * texelSize;
+    vec2 upper = uvScale - 0.5 * texelSize;
+    vec2 uv = clamp(gl_FragCoord.xy / outputSize * uvScale, lower, upper);
+    vec3 center = texture(scene, uv).rgb;
+    if (sharpness <= 0.0) {
+        FragColor = vec4(center, 1.0);
+        return;
+    }
+
+    // Unsharp mask against the four neighbours one scene texel away,
+    // clamped to their range so edges do not ring
+    vec3 north = texture(scene, min(uv + vec2(0.0, texelSize.y), upper)).rgb;
+    vec3 south = texture(scene, max(uv - vec2(0.0, texelSize.y), lower)).rgb;
+    vec3 east = texture(scene, min(uv + vec2(texelSize.x, 0.0), upper)).rgb;
+    vec3 west = texture(scene, max(uv - vec2(texelSize.x, 0.0), lower)).rgb;
+
+    vec3 lowest = min(center, min(min(north, south), min(east, west)));
+    vec3 highest = max(center, max(max(north, south), max(east, west)));
+    vec3 sharpened = center + sharpness * (4.0 * center - north - south - east - west);
+    FragColor = vec4(clamp(sharpened, lowest, highest), 1.0);
+}
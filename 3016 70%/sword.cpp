@@ -1,4 +1,12 @@
-#include "Sword.h"
+#include "sword.h"
+#include "MeshOptimizer.h"
+#include "PropLod.h"
+#include "RenderStats.h"
+#include "GLStateCache.h"
+#include "FrameUniforms.h"
+#include "AssetMemory.h"
+#include "VirtualFileSystem.h"
+#include "AssetIOSystem.h"
 #include <random>
 #include <filesystem>
 #include <glew.h>
@@ -12,19 +20,118 @@
 #include <unordered_set>
 
 Sword::Sword(const std::string& modelPath1, const std::string& modelPath2) {
-    loadSwordModel(modelPath1, importer1, swordScene1, textureID1);
-    loadSwordModel(modelPath2, importer2, swordScene2, textureID2);
+    loadSwordModel(modelPath1, textureID1, swordMeshes1);
+    loadSwordModel(modelPath2, textureID2, swordMeshes2);
+
+    // Whole-model bounds for impostor selection and baking
+    swordBounds1 = glm::vec4(0.0f);
+    for (const auto& mesh : swordMeshes1)
+        swordBounds1 = PropLod::mergeBoundingSpheres(swordBounds1, mesh.bounds);
+    swordBounds2 = glm::vec4(0.0f);
+    for (const auto& mesh : swordMeshes2)
+        swordBounds2 = PropLod::mergeBoundingSpheres(swordBounds2, mesh.bounds);
+
+    // Whole-model boxes for frustum culling
+    swordAabb1 = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (size_t i = 0; i < swordMeshes1.size(); i++)
+        swordAabb1 = i == 0 ? swordMeshes1[i].aabb : FrustumCuller::merge(swordAabb1, swordMeshes1[i].aabb);
+    swordAabb2 = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    for (size_t i = 0; i < swordMeshes2.size(); i++)
+        swordAabb2 = i == 0 ? swordMeshes2[i].aabb : FrustumCuller::merge(swordAabb2, swordMeshes2[i].aabb);
 }
 
-void Sword::loadSwordModel(const std::string& filePath, Assimp::Importer& importer, const aiScene*& scene, GLuint& textureID) {
-    scene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_FlipUVs);
+void Sword::loadSwordModel(const std::string& filePath, GLuint& textureID, std::vector<SwordMesh>& meshes) {
+    // The importer only lives for the load; the scene is freed once the meshes are on the GPU
+    Assimp::Importer importer;
+    const aiScene* scene = AssetIO::readScene(importer, filePath, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenBoundingBoxes);
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
         std::cerr << "Error loading model: " << importer.GetErrorString() << std::endl;
     } else {
         std::cout << "Successfully loaded model: " << filePath << std::endl;
-        std::string texturePath = std::filesystem::current_path().string() + "/models/Swords/texture/Texture_MAp_sword.png";
+        std::string texturePath = "models/Swords/texture/Texture_MAp_sword.png";
         textureID = loadTexture(texturePath);
+
+        for (unsigned int i = 0; i < scene->mNumMeshes; i++) {
+            meshes.push_back(uploadMesh(scene->mMeshes[i], filePath + " [" + scene->mMeshes[i]->mName.C_Str() + "]"));
+        }
     }
+    importer.FreeScene();
+}
+
+SwordMesh Sword::uploadMesh(const aiMesh* mesh, const std::string& name) {
+    MeshData data;
+    data.stride = 8;
+
+    // Add positions, UVs, and normals to the vertex array
+    for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
+        aiVector3D pos = mesh->mVertices[j];
+        aiVector3D uv = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j] : aiVector3D(0.0f, 0.0f, 0.0f);  // Handle missing UVs
+        aiVector3D normal = mesh->mNormals[j];
+
+        data.vertices.push_back(pos.x);
+        data.vertices.push_back(pos.y);
+        data.vertices.push_back(pos.z);
+
+        data.vertices.push_back(uv.x);
+        data.vertices.push_back(uv.y);
+
+        data.vertices.push_back(normal.x);
+        data.vertices.push_back(normal.y);
+        data.vertices.push_back(normal.z);
+    }
+
+    // Add indices. Triangulation leaves point and line primitives as they
+    // are, and those would shift every later triangle in the index stream.
+    for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
+        const aiFace& face = mesh->mFaces[j];
+        if (face.mNumIndices != 3)
+            continue;
+        for (unsigned int k = 0; k < face.mNumIndices; k++) {
+            data.indices.push_back(face.mIndices[k]);
+        }
+    }
+
+    // Weld, reorder for the vertex cache and overdraw, then remap for fetch
+    MeshOptimizer::optimize(data, name);
+
+    SwordMesh result;
+    result.bounds = PropLod::computeBoundingSphere(data.vertices, data.stride);
+    result.aabb = { glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z),
+                    glm::vec3(mesh->mAABB.mMax.x, mesh->mAABB.mMax.y, mesh->mAABB.mMax.z) };
+    result.lods = MeshSimplifier::buildLodChain(data);
+
+    // Only the LOD ranges stay on the CPU, the vertex and index data live in the buffers
+    size_t vertexCount = data.vertices.size() / data.stride;
+    AssetMemory::track(MemorySubsystem::Swords, name, result.lods.capacity() * sizeof(LodLevel),
+        data.vertices.size() * sizeof(float) + data.indices.size() * sizeof(unsigned int) + vertexCount * 3 * sizeof(float));
+
+    glGenVertexArrays(1, &result.VAO);
+    glGenBuffers(1, &result.VBO);
+    glGenBuffers(1, &result.EBO);
+
+    GLState::bindVertexArray(result.VAO);
+    GLState::bindBuffer(GL_ARRAY_BUFFER, result.VBO);
+    glBufferData(GL_ARRAY_BUFFER, data.vertices.size() * sizeof(float), data.vertices.data(), GL_STATIC_DRAW);
+
+    GLState::bindBuffer(GL_ELEMENT_ARRAY_BUFFER, result.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indices.size() * sizeof(unsigned int), data.indices.data(), GL_STATIC_DRAW);
+
+    // Set up position attribute
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // Set up UV attribute
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    // Set up normal attribute
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+
+    GLState::bindVertexArray(0);
+
+    result.depthVAO = DepthPrepass::createVertexArray(data.vertices.data(), vertexCount, data.stride * sizeof(float), result.EBO, result.positionVBO);
+    return result;
 }
 
 
@@ -35,9 +142,8 @@ struct pair_hash {
     }
 };
 
-void Sword::scatterSwords(int numSwords, int gridSize, float scale, float scaleFactor, float offset, FastNoiseLite& noise, std::vector<glm::mat4>& swordTransforms1, std::vector<glm::mat4>& swordTransforms2) {
-    std::random_device rd;
-    std::mt19937 gen(rd());
+void Sword::scatterSwords(int numSwords, int gridSize, float scale, float scaleFactor, float offset, FastNoiseLite& noise, std::vector<glm::mat4>& swordTransforms1, std::vector<glm::mat4>& swordTransforms2, unsigned int seed) {
+    std::mt19937 gen(seed);
     std::uniform_int_distribution<> xDist(0, gridSize);
     std::uniform_int_distribution<> zDist(0, gridSize);
     std::uniform_real_distribution<float> angleDist(-10.0f, 10.0f); // Random tilt angle between -10 and 10 degrees
@@ -91,170 +197,231 @@ void Sword::scatterSwords(int numSwords, int gridSize, float scale, float scaleF
 }
 
 
-void Sword::renderSwords(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, GLuint shaderProgram) {
-    GLuint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLuint textureLoc = glGetUniformLocation(shaderProgram, "texture1");
-
-    // Render first sword model
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textureID1);
-    glUniform1i(textureLoc, 0);  // Set the texture uniform to use texture unit 0
-
-    for (const auto& transform : swordTransforms1) {
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(transform));
-
-        for (unsigned int i = 0; i < swordScene1->mNumMeshes; i++) {
-            aiMesh* mesh = swordScene1->mMeshes[i];
-
-            // Generate buffers for mesh data
-            std::vector<float> vertices;
-            std::vector<unsigned int> indices;
-
-            // Add positions, UVs, and normals to the vertex array
-            for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
-                aiVector3D pos = mesh->mVertices[j];
-                aiVector3D uv = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j] : aiVector3D(0.0f, 0.0f, 0.0f);  // Handle missing UVs
-
-                // Add position
-                vertices.push_back(pos.x);
-                vertices.push_back(pos.y);
-                vertices.push_back(pos.z);
+void Sword::cullSwords(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, const ViewCull& viewCull, std::vector<uint32_t>& visible1, std::vector<uint32_t>& visible2) {
+    cullInstances(swordTransforms1, swordAabb1, instanceBounds1, viewCull, visible1);
+    cullInstances(swordTransforms2, swordAabb2, instanceBounds2, viewCull, visible2);
+}
 
-                // Add UV coordinates
-                vertices.push_back(uv.x);
-                vertices.push_back(uv.y);
+void Sword::queueSwords(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, const std::vector<uint32_t>& visible1, const std::vector<uint32_t>& visible2, ShaderProgram& shader, const glm::mat4& view, const glm::mat4& projection, RenderQueue& queue) {
+    glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+    shader.setInt("texture1", 0);  // Set the texture uniform to use texture unit 0
 
-                // Add normal
-                aiVector3D normal = mesh->mNormals[j];
-                vertices.push_back(normal.x);
-                vertices.push_back(normal.y);
-                vertices.push_back(normal.z);
-            }
+    // Queue first sword model
+    const std::vector<glm::mat4>& near1 = splitImpostors(gatherInstances(swordTransforms1, visible1), swordBounds1, impostor1, cameraPos);
+    queueModel(swordMeshes1, near1, textureID1, shader, view, projection, queue);
 
-            // Add indices
-            for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
-                aiFace face = mesh->mFaces[j];
-                for (unsigned int k = 0; k < face.mNumIndices; k++) {
-                    indices.push_back(face.mIndices[k]);
-                }
-            }
+    // Queue second sword model
+    const std::vector<glm::mat4>& near2 = splitImpostors(gatherInstances(swordTransforms2, visible2), swordBounds2, impostor2, cameraPos);
+    queueModel(swordMeshes2, near2, textureID2, shader, view, projection, queue);
+}
 
-            GLuint VAO, VBO, EBO;
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
-            glGenBuffers(1, &EBO);
+void Sword::cullSwordsGpu(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, ShaderProgram& cullShader, const glm::mat4& view, const glm::mat4& projection, const DepthPyramid& pyramid) {
+    if (gpuBatch1.instanceCount() != swordTransforms1.size())
+        createGpuBatch(swordMeshes1, swordTransforms1, swordAabb1, gpuBatch1);
+    if (gpuBatch2.instanceCount() != swordTransforms2.size())
+        createGpuBatch(swordMeshes2, swordTransforms2, swordAabb2, gpuBatch2);
+
+    gpuCullTimer.begin();
+    gpuBatch1.cull(cullShader, view, projection, pyramid);
+    gpuBatch2.cull(cullShader, view, projection, pyramid);
+    gpuCullTimer.end();
+    RenderStats::frame().gpuCullMs += gpuCullTimer.lastMs();
+}
 
-            glBindVertexArray(VAO);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+void Sword::queueSwordsGpu(ShaderProgram& shader, const glm::vec3& cameraPos, RenderQueue& queue) {
+    queueGpuModel(swordMeshes1, gpuBatch1, textureID1, shader, cameraPos, queue);
+    queueGpuModel(swordMeshes2, gpuBatch2, textureID2, shader, cameraPos, queue);
+}
 
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+// The world boxes are built here rather than shared with cullInstances,
+// which the simulation thread may be running at the same time
+void Sword::createGpuBatch(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, const Aabb& aabb, GpuCullBatch& batch) {
+    AabbSoA bounds;
+    for (const auto& transform : transforms)
+        bounds.add(FrustumCuller::transform(aabb, transform));
+    std::vector<GpuCullMesh> cullMeshes;
+    for (const auto& mesh : meshes)
+        cullMeshes.push_back({ mesh.lods, mesh.bounds });
+    if (!batch.create(transforms, bounds, cullMeshes))
+        return;
+    for (const auto& mesh : meshes)
+        batch.attach(mesh.VAO);
+}
 
-            // Set up position attribute
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
+// Items without a depth vertex array stay out of the pre-pass, since the
+// instance counts are only known on the GPU
+void Sword::queueGpuModel(const std::vector<SwordMesh>& meshes, const GpuCullBatch& batch, GLuint texture, ShaderProgram& shader, const glm::vec3& cameraPos, RenderQueue& queue) {
+    if (!batch.created())
+        return;
+    for (size_t m = 0; m < meshes.size(); m++) {
+        DrawItem item = { RenderPass::Opaque, &shader, texture, meshes[m].VAO, 0, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+        item.draw = [&batch, m]() { batch.draw(static_cast<int>(m)); };
+        queue.add(item, cameraPos);
+    }
+}
 
-            // Set up UV attribute
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-            glEnableVertexAttribArray(1);
+void Sword::releaseGpuCulling() {
+    for (const auto* meshes : { &swordMeshes1, &swordMeshes2 }) {
+        for (const auto& mesh : *meshes)
+            glDisableVertexArrayAttrib(mesh.VAO, kCullInstanceAttribute);
+    }
+    gpuBatch1.release();
+    gpuBatch2.release();
+    gpuCullTimer.release();
+}
 
-            // Set up normal attribute
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-            glEnableVertexAttribArray(2);
+// The meshes are read back from their buffers, so runs that never pull
+// keep no second copy of them
+void Sword::addToPool(VertexPool& pool) {
+    for (auto* meshes : { &swordMeshes1, &swordMeshes2 }) {
+        for (auto& mesh : *meshes) {
+            std::vector<PulledVertex> vertices = VertexPulling::fromInterleaved(VertexPulling::readBuffer<float>(mesh.VBO));
+            mesh.pulled = pool.add(vertices, VertexPulling::readBuffer<unsigned int>(mesh.EBO), MemorySubsystem::Swords, "sword mesh");
+        }
+    }
+}
 
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+void Sword::queueSwordsPulled(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, const std::vector<uint32_t>& visible1, const std::vector<uint32_t>& visible2, ShaderProgram& shader, const glm::mat4& view, const glm::mat4& projection, VertexPool& pool, RenderQueue& queue) {
+    glm::vec3 cameraPos = glm::vec3(glm::inverse(view)[3]);
+    pulledDraws.clear();
+    addPulledModel(swordMeshes1, splitImpostors(gatherInstances(swordTransforms1, visible1), swordBounds1, impostor1, cameraPos), view, projection);
+    addPulledModel(swordMeshes2, splitImpostors(gatherInstances(swordTransforms2, visible2), swordBounds2, impostor2, cameraPos), view, projection);
+    if (pulledDraws.empty())
+        return;
+
+    // Both models load the same texture file, so one binding serves them both
+    DrawItem item = { RenderPass::Opaque, &shader, textureID1, pool.vertexArray(), 0, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+    item.draw = [this, &pool]() { pulledDraws.draw(pool); };
+    queue.add(item, cameraPos);
+}
 
-            glBindVertexArray(0);
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-            glDeleteVertexArrays(1, &VAO);
+void Sword::addPulledModel(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, const glm::mat4& view, const glm::mat4& projection) {
+    bool lodEnabled = PropLod::settings().enabled;
+    for (const auto& mesh : meshes) {
+        for (const auto& transform : transforms) {
+            int level = 0;
+            if (lodEnabled) {
+                float screenSize = PropLod::projectedScreenSize(mesh.bounds, transform, view, projection);
+                level = PropLod::selectLod(screenSize, static_cast<int>(mesh.lods.size())).level;
+                if (level < 0) {
+                    RenderStats::frame().lodCulled++;
+                    continue;
+                }
+            }
+            const LodLevel& lod = mesh.lods[level];
+            RenderStats::frame().propInstances++;
+            pulledDraws.add(mesh.pulled, lod.indexOffset, lod.indexCount, transform, glm::mat3(transform));
         }
     }
+}
 
-    // Render second sword model
-    glBindTexture(GL_TEXTURE_2D, textureID2);
-    glUniform1i(textureLoc, 0);  // Set the texture uniform to use texture unit 0
+// Fills the indices of the instances whose world box passes the view culling.
+// The boxes are built once, since scattered swords never move.
+void Sword::cullInstances(const std::vector<glm::mat4>& transforms, const Aabb& aabb, AabbSoA& instanceBounds, const ViewCull& viewCull, std::vector<uint32_t>& visible) {
+    if (instanceBounds.size() != transforms.size()) {
+        instanceBounds.clear();
+        for (const auto& transform : transforms)
+            instanceBounds.add(FrustumCuller::transform(aabb, transform));
+    }
+    Visibility::cull(viewCull, instanceBounds, visible);
+}
 
-    for (const auto& transform : swordTransforms2) {
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(transform));
+const std::vector<glm::mat4>& Sword::gatherInstances(const std::vector<glm::mat4>& transforms, const std::vector<uint32_t>& visible) {
+    visibleTransforms.clear();
+    for (auto index : visible)
+        visibleTransforms.push_back(transforms[index]);
+    return visibleTransforms;
+}
 
-        for (unsigned int i = 0; i < swordScene2->mNumMeshes; i++) {
-            aiMesh* mesh = swordScene2->mMeshes[i];
+// Queues instances beyond the impostor distance on the atlas and returns the rest
+const std::vector<glm::mat4>& Sword::splitImpostors(const std::vector<glm::mat4>& transforms, const glm::vec4& bounds, ImpostorAtlas& impostor, const glm::vec3& cameraPos) {
+    const ImpostorSettings& settings = Impostor::settings();
+    if (!settings.enabled || !impostor.isBaked())
+        return transforms;
+
+    nearTransforms.clear();
+    for (const auto& transform : transforms) {
+        glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(bounds), 1.0f));
+        if (glm::length(center - cameraPos) > settings.distance)
+            impostor.addInstance(transform, cameraPos);
+        else
+            nearTransforms.push_back(transform);
+    }
+    return nearTransforms;
+}
 
-            // Generate buffers for mesh data
-            std::vector<float> vertices;
-            std::vector<unsigned int> indices;
+void Sword::bakeImpostors(ShaderProgram& shader) {
+    shader.use();
+    shader.setMat4("model", glm::mat4(1.0f));
+    shader.setInt("texture1", 0);
+    shader.setVec2("lodFade", glm::vec2(0.0f));
+
+    auto bakeModel = [&](const std::vector<SwordMesh>& meshes, GLuint texture, ImpostorAtlas& impostor, const glm::vec4& bounds) {
+        if (meshes.empty())
+            return;
+        impostor.bake(bounds, [&](const glm::mat4& view, const glm::mat4& projection) {
+            // Bound here because bake() binds the atlas to unit 0 while creating it
+            GLState::bindTexture(0, GL_TEXTURE_2D, texture);
+            FrameUniforms::setCamera(view, projection, glm::vec3(glm::inverse(view)[3]));
+            FrameUniforms::upload();
+            for (const auto& mesh : meshes) {
+                GLState::bindVertexArray(mesh.VAO);
+                glDrawElements(GL_TRIANGLES, mesh.lods[0].indexCount, GL_UNSIGNED_INT, 0);
+            }
+            GLState::bindVertexArray(0);
+        });
+    };
 
-            // Add positions, UVs, and normals to the vertex array
-            for (unsigned int j = 0; j < mesh->mNumVertices; j++) {
-                aiVector3D pos = mesh->mVertices[j];
-                aiVector3D uv = mesh->mTextureCoords[0] ? mesh->mTextureCoords[0][j] : aiVector3D(0.0f, 0.0f, 0.0f);  // Handle missing UVs
+    bakeModel(swordMeshes1, textureID1, impostor1, swordBounds1);
+    bakeModel(swordMeshes2, textureID2, impostor2, swordBounds2);
+    AssetMemory::track(MemorySubsystem::Textures, "sword impostor atlases", 0, impostor1.gpuBytes() + impostor2.gpuBytes());
+}
 
-                // Add position
-                vertices.push_back(pos.x);
-                vertices.push_back(pos.y);
-                vertices.push_back(pos.z);
+void Sword::queueImpostors(ShaderProgram& impostorShader, RenderQueue& queue) {
+    impostor1.queue(impostorShader, queue);
+    impostor2.queue(impostorShader, queue);
+}
 
-                // Add UV coordinates
-                vertices.push_back(uv.x);
-                vertices.push_back(uv.y);
+void Sword::addShadowCasters(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, CascadedShadowMap& shadowMap) const {
+    addModelCasters(swordMeshes1, swordTransforms1, shadowMap);
+    addModelCasters(swordMeshes2, swordTransforms2, shadowMap);
+}
 
-                // Add normal
-                aiVector3D normal = mesh->mNormals[j];
-                vertices.push_back(normal.x);
-                vertices.push_back(normal.y);
-                vertices.push_back(normal.z);
-            }
+void Sword::addModelCasters(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, CascadedShadowMap& shadowMap) const {
+    for (const auto& mesh : meshes) {
+        for (const auto& transform : transforms)
+            shadowMap.addCaster({ mesh.depthVAO, mesh.lods[0].indexOffset, mesh.lods[0].indexCount, transform, FrustumCuller::transform(mesh.aabb, transform) });
+    }
+}
 
-            // Add indices
-            for (unsigned int j = 0; j < mesh->mNumFaces; j++) {
-                aiFace face = mesh->mFaces[j];
-                for (unsigned int k = 0; k < face.mNumIndices; k++) {
-                    indices.push_back(face.mIndices[k]);
+void Sword::queueModel(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, GLuint texture, ShaderProgram& shader, const glm::mat4& view, const glm::mat4& projection, RenderQueue& queue) {
+    bool lodEnabled = PropLod::settings().enabled;
+    for (const auto& mesh : meshes) {
+        DrawItem item = { RenderPass::Opaque, &shader, texture, mesh.VAO, mesh.depthVAO, glm::mat4(1.0f), glm::vec2(0.0f), 0, 0, {} };
+        for (const auto& transform : transforms) {
+            LodChoice choice = { 0, -1, 1.0f };
+            if (lodEnabled) {
+                float screenSize = PropLod::projectedScreenSize(mesh.bounds, transform, view, projection);
+                choice = PropLod::selectLod(screenSize, static_cast<int>(mesh.lods.size()));
+                if (choice.level < 0) {
+                    RenderStats::frame().lodCulled++;
+                    continue;
                 }
             }
-
-            GLuint VAO, VBO, EBO;
-            glGenVertexArrays(1, &VAO);
-            glGenBuffers(1, &VBO);
-            glGenBuffers(1, &EBO);
-
-            glBindVertexArray(VAO);
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-
-            // Set up position attribute
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-            glEnableVertexAttribArray(0);
-
-            // Set up UV attribute
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-            glEnableVertexAttribArray(1);
-
-            // Set up normal attribute
-            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
-            glEnableVertexAttribArray(2);
-
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-            glBindVertexArray(0);
-            glDeleteBuffers(1, &VBO);
-            glDeleteBuffers(1, &EBO);
-            glDeleteVertexArrays(1, &VAO);
+            item.model = transform;
+            PropLod::queueLod(choice, mesh.lods, item, glm::vec3(transform * glm::vec4(glm::vec3(mesh.bounds), 1.0f)), queue);
         }
     }
 }
+
 GLuint Sword::loadTexture(const std::string& texturePath) {
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    GLState::bindTexture(0, GL_TEXTURE_2D, textureID);
 
     int width, height, nrChannels;
-    unsigned char* data = stbi_load(texturePath.c_str(), &width, &height, &nrChannels, 0);
+    FileView file = Vfs::open(texturePath);
+    unsigned char* data = file.valid() ? stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &width, &height, &nrChannels, 0) : nullptr;
     if (data) {
         GLenum format = GL_RGB;
         if (nrChannels == 4)
@@ -262,6 +429,7 @@ GLuint Sword::loadTexture(const std::string& texturePath) {
 
         glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
         glGenerateMipmap(GL_TEXTURE_2D);
+        AssetMemory::track(MemorySubsystem::Textures, texturePath, 0, AssetMemory::textureBytes(width, height, nrChannels == 4 ? 4 : 3, true));
     } else {
         std::cerr << "Failed to load texture: " << texturePath << std::endl;
     }
@@ -5,27 +5,86 @@
 #include <vector>
 #include <string>
 #include <glm.hpp>
-#include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <FastNoiseLite.h>
 #include <glew.h>
+#include "MeshSimplifier.h"
+#include "Impostor.h"
+#include "ShaderProgram.h"
+#include "RenderQueue.h"
+#include "Visibility.h"
+#include "ShadowMap.h"
+#include "GpuCulling.h"
+#include "GpuTimer.h"
+#include "VertexPulling.h"
+
+struct SwordMesh {
+    GLuint VAO, VBO, EBO;
+    GLuint depthVAO, positionVBO; // Position-only stream for the depth pre-pass
+    std::vector<LodLevel> lods;
+    glm::vec4 bounds; // Object-space bounding sphere
+    Aabb aabb;        // Object-space box from the importer
+    PulledMesh pulled; // Range in the vertex pool, once added
+};
 
 class Sword {
 public:
     Sword(const std::string& modelPath1, const std::string& modelPath2);
-    void scatterSwords(int numSwords, int gridSize, float scale, float scaleFactor, float offset, FastNoiseLite& noise, std::vector<glm::mat4>& swordTransforms1, std::vector<glm::mat4>& swordTransforms2);
-    void renderSwords(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, GLuint shaderProgram);
+    void scatterSwords(int numSwords, int gridSize, float scale, float scaleFactor, float offset, FastNoiseLite& noise, std::vector<glm::mat4>& swordTransforms1, std::vector<glm::mat4>& swordTransforms2, unsigned int seed);
+
+    // Fills the indices of each model's instances that pass the view culling.
+    // Issues no GL calls, so it may run off the render thread.
+    void cullSwords(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, const ViewCull& viewCull, std::vector<uint32_t>& visible1, std::vector<uint32_t>& visible2);
+    void queueSwords(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, const std::vector<uint32_t>& visible1, const std::vector<uint32_t>& visible2, ShaderProgram& shader, const glm::mat4& view, const glm::mat4& projection, RenderQueue& queue);
+    // GPU-driven alternative to cullSwords and queueSwords: the compute shader
+    // culls every instance and fills indirect commands, one multi-draw per
+    // mesh. Render thread only. Impostors are not used on this path.
+    void cullSwordsGpu(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, ShaderProgram& cullShader, const glm::mat4& view, const glm::mat4& projection, const DepthPyramid& pyramid);
+    void queueSwordsGpu(ShaderProgram& shader, const glm::vec3& cameraPos, RenderQueue& queue);
+    void releaseGpuCulling();
+
+    // Vertex pulling alternative to queueSwords: every visible sword of both
+    // models, all meshes and LODs, goes out in one multi-draw from the pool.
+    // No LOD crossfade on this path.
+    void addToPool(VertexPool& pool);
+    void queueSwordsPulled(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, const std::vector<uint32_t>& visible1, const std::vector<uint32_t>& visible2, ShaderProgram& shader, const glm::mat4& view, const glm::mat4& projection, VertexPool& pool, RenderQueue& queue);
+    void bakeImpostors(ShaderProgram& shader);
+    void queueImpostors(ShaderProgram& impostorShader, RenderQueue& queue);
+
+    // Registers every sword at full detail as a static shadow caster
+    void addShadowCasters(const std::vector<glm::mat4>& swordTransforms1, const std::vector<glm::mat4>& swordTransforms2, CascadedShadowMap& shadowMap) const;
 
 private:
-    void loadSwordModel(const std::string& filePath, Assimp::Importer& importer, const aiScene*& scene, GLuint& textureID);
+    void loadSwordModel(const std::string& filePath, GLuint& textureID, std::vector<SwordMesh>& meshes);
+    SwordMesh uploadMesh(const aiMesh* mesh, const std::string& name);
+    void addModelCasters(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, CascadedShadowMap& shadowMap) const;
+    void queueModel(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, GLuint texture, ShaderProgram& shader, const glm::mat4& view, const glm::mat4& projection, RenderQueue& queue);
+    void cullInstances(const std::vector<glm::mat4>& transforms, const Aabb& aabb, AabbSoA& instanceBounds, const ViewCull& viewCull, std::vector<uint32_t>& visible);
+    void createGpuBatch(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, const Aabb& aabb, GpuCullBatch& batch);
+    void addPulledModel(const std::vector<SwordMesh>& meshes, const std::vector<glm::mat4>& transforms, const glm::mat4& view, const glm::mat4& projection);
+    void queueGpuModel(const std::vector<SwordMesh>& meshes, const GpuCullBatch& batch, GLuint texture, ShaderProgram& shader, const glm::vec3& cameraPos, RenderQueue& queue);
+    const std::vector<glm::mat4>& gatherInstances(const std::vector<glm::mat4>& transforms, const std::vector<uint32_t>& visible);
+    const std::vector<glm::mat4>& splitImpostors(const std::vector<glm::mat4>& transforms, const glm::vec4& bounds, ImpostorAtlas& impostor, const glm::vec3& cameraPos);
     GLuint loadTexture(const std::string& texturePath);
 
-    Assimp::Importer importer1;
-    Assimp::Importer importer2;
-    const aiScene* swordScene1;
-    const aiScene* swordScene2;
     GLuint textureID1;
     GLuint textureID2;
+    std::vector<SwordMesh> swordMeshes1;
+    std::vector<SwordMesh> swordMeshes2;
+    glm::vec4 swordBounds1;
+    glm::vec4 swordBounds2;
+    Aabb swordAabb1;
+    Aabb swordAabb2;
+    AabbSoA instanceBounds1; // World boxes of the scattered instances
+    AabbSoA instanceBounds2;
+    std::vector<glm::mat4> visibleTransforms;
+    ImpostorAtlas impostor1;
+    ImpostorAtlas impostor2;
+    std::vector<glm::mat4> nearTransforms;
+    GpuCullBatch gpuBatch1;
+    GpuCullBatch gpuBatch2;
+    GpuTimer gpuCullTimer;
+    PulledDrawList pulledDraws;
 };
 
 #endif // SWORD_H
@@ -1,5 +1,8 @@
-#include "Terrain.h"
+#include "terrain.h"
 #include "Vertex.h" // Include the Vertex header file
+#include "AssetMemory.h"
+#include <algorithm>
+#include <cfloat>
 
 Terrain::Terrain(int gridSize, float scale, FastNoiseLite& noise)
     : gridSize(gridSize), scale(scale), noise(noise) {}
@@ -20,30 +23,51 @@ glm::vec3 Terrain::getBiomeColor(float noiseValue) {
 }
 
 void Terrain::generateTerrain(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
-    this->vertices.clear(); // Clear any existing vertices
+    heights.clear(); // Clear any existing heights
     for (int z = 0; z <= gridSize; ++z) {
         for (int x = 0; x <= gridSize; ++x) {
             float noiseValue = noise.GetNoise((float)x, (float)z);
             float height = noiseValue * scale;
 
             vertices.push_back({ glm::vec3((float)x, height, (float)z), getBiomeColor(noiseValue), glm::vec3(0.0f, 1.0f, 0.0f) });
-            this->vertices.push_back(vertices.back()); // Store vertex for height lookup
+            heights.push_back(height); // Store height for height lookup
         }
     }
 
-    for (int z = 0; z < gridSize; ++z) {
-        for (int x = 0; x < gridSize; ++x) {
-            int topLeft = z * (gridSize + 1) + x;
-            int topRight = topLeft + 1;
-            int bottomLeft = (z + 1) * (gridSize + 1) + x;
-            int bottomRight = bottomLeft + 1;
-
-            indices.push_back(topLeft);
-            indices.push_back(bottomLeft);
-            indices.push_back(topRight);
-            indices.push_back(topRight);
-            indices.push_back(bottomLeft);
-            indices.push_back(bottomRight);
+    // Indices are laid out chunk by chunk so each chunk is one contiguous range
+    chunks.clear();
+    for (int chunkZ = 0; chunkZ < gridSize; chunkZ += kTerrainChunkSize) {
+        for (int chunkX = 0; chunkX < gridSize; chunkX += kTerrainChunkSize) {
+            TerrainChunk chunk;
+            chunk.indexOffset = static_cast<unsigned int>(indices.size());
+            chunk.bounds = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+
+            int endZ = std::min(chunkZ + kTerrainChunkSize, gridSize);
+            int endX = std::min(chunkX + kTerrainChunkSize, gridSize);
+            for (int z = chunkZ; z < endZ; ++z) {
+                for (int x = chunkX; x < endX; ++x) {
+                    int topLeft = z * (gridSize + 1) + x;
+                    int topRight = topLeft + 1;
+                    int bottomLeft = (z + 1) * (gridSize + 1) + x;
+                    int bottomRight = bottomLeft + 1;
+
+                    indices.push_back(topLeft);
+                    indices.push_back(bottomLeft);
+                    indices.push_back(topRight);
+                    indices.push_back(topRight);
+                    indices.push_back(bottomLeft);
+                    indices.push_back(bottomRight);
+                }
+            }
+            for (int z = chunkZ; z <= endZ; ++z) {
+                for (int x = chunkX; x <= endX; ++x) {
+                    chunk.bounds.min = glm::min(chunk.bounds.min, vertices[z * (gridSize + 1) + x].position);
+                    chunk.bounds.max = glm::max(chunk.bounds.max, vertices[z * (gridSize + 1) + x].position);
+                }
+            }
+
+            chunk.indexCount = static_cast<unsigned int>(indices.size()) - chunk.indexOffset;
+            chunks.push_back(chunk);
         }
     }
 
@@ -63,6 +87,8 @@ void Terrain::generateTerrain(std::vector<Vertex>& vertices, std::vector<unsigne
     for (auto& vertex : vertices) {
         vertex.normal = glm::normalize(vertex.normal);
     }
+
+    AssetMemory::track(MemorySubsystem::Terrain, "heightfield", heights.capacity() * sizeof(float), 0);
 }
 
 float Terrain::getHeightAt(float x, float z) const {
@@ -75,5 +101,17 @@ float Terrain::getHeightAt(float x, float z) const {
     }
 
     int index = iz * (gridSize + 1) + ix;
-    return vertices[index].position.y;
+    return heights[index];
+}
+
+const std::vector<TerrainChunk>& Terrain::getChunks() const {
+    return chunks;
+}
+
+int Terrain::getGridSize() const {
+    return gridSize;
+}
+
+const std::vector<float>& Terrain::getHeights() const {
+    return heights;
 }
@@ -6,19 +6,36 @@
 #include <FastNoiseLite.h>
 #include "Vertex.h"
 #include <glm.hpp>
+#include "FrustumCuller.h"
+
+// Quads per side of a terrain chunk
+const int kTerrainChunkSize = 16;
+
+// A square block of the grid drawn as one range of the terrain index buffer
+struct TerrainChunk {
+    unsigned int indexOffset;
+    unsigned int indexCount;
+    Aabb bounds;
+};
 
 class Terrain {
 public:
     Terrain(int gridSize, float scale, FastNoiseLite& noise);
     void generateTerrain(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
     float getHeightAt(float x, float z) const;
+    const std::vector<TerrainChunk>& getChunks() const;
+
+    // Heightfield of (gridSize + 1) x (gridSize + 1) samples, one world unit apart
+    int getGridSize() const;
+    const std::vector<float>& getHeights() const;
 
 private:
     int gridSize;
     float scale;
     FastNoiseLite& noise;
     glm::vec3 getBiomeColor(float noiseValue);
-    std::vector<Vertex> vertices; // Store vertices for height lookup
+    std::vector<float> heights; // Store heights for height lookup
+    std::vector<TerrainChunk> chunks;
 };
 
 #endif // TERRAIN_H